@@ -0,0 +1,35 @@
+#include <string>
+#include <vector>
+#include <QGuiApplication>
+
+#include "benchmarks.hh"
+
+// usage: lilyplayer-bench [song.bin...]
+int main(const int argc, const char* const * const argv)
+{
+  std::vector<std::string> song_files;
+  for (int i = 1; i < argc; ++i)
+  {
+    song_files.emplace_back(argv[i]);
+  }
+
+  if (song_files.empty())
+  {
+    song_files.emplace_back("../misc/fur_Elise.bin");
+  }
+
+  // reading and rendering music sheets requires a gui application, but no display
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+  {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  int dummy { 0 };
+  QGuiApplication app(dummy, nullptr);
+
+  run_spsc_ring_buffer_benchmarks();
+  run_log_benchmarks();
+  run_midi_stream_parser_benchmarks(song_files);
+  run_song_functions_benchmarks(song_files);
+  run_midi_latency_benchmarks();
+  return 0;
+}
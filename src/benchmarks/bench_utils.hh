@@ -0,0 +1,88 @@
+#ifndef BENCH_UTILS_HH
+#define BENCH_UTILS_HH
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Benchmarks print one JSON object per line on stdout, so that results can be
+// compared between releases with standard tools. Each line has a "name", and
+// the figures measured by this benchmark.
+class bench_report
+{
+  public:
+    explicit bench_report(const std::string& name)
+      : fields()
+    {
+      add("name", name);
+    }
+
+    bench_report& add(const std::string& key, const std::string& value)
+    {
+      fields.emplace_back(key, "\"" + value + "\"");
+      return *this;
+    }
+
+    bench_report& add(const std::string& key, const double value)
+    {
+      fields.emplace_back(key, std::to_string(value));
+      return *this;
+    }
+
+    bench_report& add(const std::string& key, const uint64_t value)
+    {
+      fields.emplace_back(key, std::to_string(value));
+      return *this;
+    }
+
+    void print(std::ostream& out = std::cout) const
+    {
+      out << "{";
+      for (auto i = decltype(fields.size()){0}; i < fields.size(); ++i)
+      {
+	out << ((i == 0) ? "" : ", ") << "\"" << fields[i].first << "\": " << fields[i].second;
+      }
+      out << "}" << std::endl;
+    }
+
+  private:
+    std::vector<std::pair<std::string, std::string>> fields;
+};
+
+// Runs func repeatedly for at least min_duration and reports the time per call.
+template <typename Func>
+void run_benchmark(const std::string& name, Func&& func,
+		   const std::chrono::milliseconds min_duration = std::chrono::milliseconds{500})
+{
+  using clock = std::chrono::steady_clock;
+
+  func(); // warm up
+
+  uint64_t nb_iterations = 0;
+  const auto start = clock::now();
+  auto now = start;
+  while (now - start < min_duration)
+  {
+    func();
+    ++nb_iterations;
+    now = clock::now();
+  }
+
+  const auto total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+  bench_report(name)
+    .add("iterations", nb_iterations)
+    .add("ns_per_iteration", static_cast<double>(total_ns) / static_cast<double>(nb_iterations))
+    .print();
+}
+
+// prevents the compiler from optimising away a value computed by a benchmark
+template <typename T>
+void do_not_optimize(const T& value)
+{
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif /* BENCH_UTILS_HH */
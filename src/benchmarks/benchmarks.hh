@@ -0,0 +1,25 @@
+#ifndef BENCHMARKS_HH
+#define BENCHMARKS_HH
+
+#include <string>
+#include <vector>
+
+// one function per benchmarked module, each printing its results as JSON lines.
+void run_spsc_ring_buffer_benchmarks();
+
+// cost of the messages left out on the hot paths, and of the queue of the
+// log writer thread
+void run_log_benchmarks();
+
+void run_midi_stream_parser_benchmarks(const std::vector<std::string>& song_files);
+
+// reading songs and the functions called while playing or displaying them, on
+// the given songs and on synthetic ones. Requires a QGuiApplication.
+void run_song_functions_benchmarks(const std::vector<std::string>& song_files);
+
+// latencies of the messages sent by the headless player, and of the keys
+// played through a lilyplayer instance running with an output port and no song
+// (skipped if there is none). It reports its input to display latency itself on exit.
+void run_midi_latency_benchmarks();
+
+#endif /* BENCHMARKS_HH */
@@ -0,0 +1,88 @@
+#include <thread>
+#include <vector>
+
+#include "bench_utils.hh"
+#include "benchmarks.hh"
+#include "../log.hh"
+#include "../mpsc_ring_buffer.hh"
+
+// what a hot path pays for a message that isn't written, e.g. a warning
+// logged for every event of a broken file
+static void bench_left_out_messages()
+{
+  static log_site debug_log (log_level::debug);
+  static log_site flooding_log (log_level::warning, 0);
+
+  uint64_t key = 0;
+  run_benchmark("log/left_out_by_level", [&] () {
+      log_line(debug_log) << "Warning: key " << ++key << " out of the keyboard";
+    });
+
+  run_benchmark("log/left_out_by_rate", [&] () {
+      log_line(flooding_log) << "Warning: key " << ++key << " out of the keyboard";
+    });
+  do_not_optimize(key);
+}
+
+// several producers and the consumer all running flat out
+static void bench_mpsc_throughput()
+{
+  constexpr const unsigned int nb_producers = 4;
+  constexpr const uint64_t nb_messages_per_producer = 2'500'000;
+  constexpr const uint64_t nb_messages = nb_producers * nb_messages_per_producer;
+  mpsc_ring_buffer<uint64_t> queue(1024);
+  std::atomic<uint64_t> nb_full {0};
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> producers;
+  for (unsigned int p = 0; p < nb_producers; ++p)
+  {
+    producers.emplace_back([&] () {
+	for (uint64_t i = 0; i < nb_messages_per_producer; )
+	{
+	  if (queue.push(i))
+	  {
+	    ++i;
+	  }
+	  else
+	  {
+	    nb_full.fetch_add(1, std::memory_order_relaxed);
+	    std::this_thread::yield();
+	  }
+	}
+      });
+  }
+
+  uint64_t nb_consumed = 0;
+  uint64_t checksum = 0;
+  while (nb_consumed < nb_messages)
+  {
+    const auto nb_new = queue.consume_all([&] (const uint64_t value) {
+	checksum += value;
+      });
+    if (nb_new == 0)
+    {
+      std::this_thread::yield();
+    }
+    nb_consumed += nb_new;
+  }
+  for (auto& producer : producers)
+  {
+    producer.join();
+  }
+  const auto duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  do_not_optimize(checksum);
+
+  bench_report("mpsc_ring_buffer/throughput")
+    .add("producers", uint64_t{nb_producers})
+    .add("messages", nb_messages)
+    .add("messages_per_second", static_cast<double>(nb_messages) / duration)
+    .add("push_on_full_queue", nb_full.load())
+    .print();
+}
+
+void run_log_benchmarks()
+{
+  bench_left_out_messages();
+  bench_mpsc_throughput();
+}
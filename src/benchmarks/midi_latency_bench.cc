@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <rtmidi/RtMidi.h>
+
+#include "bench_utils.hh"
+#include "benchmarks.hh"
+#include "../bin_file_reader.hh"
+#include "../headless_player.hh"
+#include "../latency_histogram.hh"
+#include "../utils.hh"
+
+using steady_clock = std::chrono::steady_clock;
+
+static constexpr const uint64_t NB_EVENTS = 2000;
+static constexpr const std::chrono::milliseconds EVENT_PERIOD {2};
+
+// Keeps all the cores but one busy, so that latencies are also measured on
+// a machine doing something else than playing music.
+class synthetic_load
+{
+  public:
+    synthetic_load()
+      : is_stopping(false)
+      , threads()
+    {
+      const auto nb_threads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+      for (auto i = decltype(nb_threads){0}; i < nb_threads; ++i)
+      {
+	threads.emplace_back([this] () {
+	    uint64_t nb_loops = 0;
+	    while (not is_stopping.load(std::memory_order_relaxed))
+	    {
+	      ++nb_loops;
+	      do_not_optimize(nb_loops);
+	    }
+	  });
+      }
+    }
+
+    ~synthetic_load()
+    {
+      is_stopping = true;
+      for (auto& thread : threads)
+      {
+	thread.join();
+      }
+    }
+
+    synthetic_load(const synthetic_load&) = delete;
+    synthetic_load& operator=(const synthetic_load&) = delete;
+
+  private:
+    std::atomic<bool> is_stopping;
+    std::vector<std::thread> threads;
+};
+
+static void add_latencies(bench_report& report, const latency_histogram& latencies)
+{
+  const auto to_us = [] (const std::chrono::nanoseconds latency) {
+    return std::chrono::duration<double, std::micro>(latency).count();
+  };
+
+  report.add("samples", latencies.size())
+    .add("p50_us", to_us(latencies.get_percentile(50)))
+    .add("p90_us", to_us(latencies.get_percentile(90)))
+    .add("p99_us", to_us(latencies.get_percentile(99)))
+    .add("max_us", to_us(latencies.get_max()));
+}
+
+// one key pressed or released every EVENT_PERIOD
+static bin_song_t get_metronome_song()
+{
+  bin_song_t res;
+  res.events.resize(NB_EVENTS);
+  for (auto i = decltype(NB_EVENTS){0}; i < NB_EVENTS; ++i)
+  {
+    auto& event = res.events[i];
+    event.time = i * static_cast<uint64_t>(std::chrono::nanoseconds(EVENT_PERIOD).count());
+    const auto pitch = static_cast<uint8_t>(60 + (i / 2) % 12);
+    if (i % 2 == 0)
+    {
+      event.keys_down.emplace_back(pitch, 0 /* staff_num */);
+    }
+    else
+    {
+      event.keys_up.emplace_back(pitch);
+    }
+  }
+
+  res.nb_events = res.events.size();
+  return res;
+}
+
+// how late the headless player sends each message compared to when it is due.
+static void run_scheduled_to_output_benchmark(const std::string& name, const bool is_loaded)
+{
+  const auto load = is_loaded ? std::make_unique<synthetic_load>() : nullptr;
+
+  latency_histogram latencies;
+  auto first_message_time = steady_clock::time_point{};
+  uint64_t nb_messages = 0;
+  play_headless(get_metronome_song(), midi_transform(), [&] (const uint8_t*, std::size_t) noexcept {
+      const auto now = steady_clock::now();
+      if (nb_messages == 0)
+      {
+	first_message_time = now;
+      }
+
+      // the keys released at the end of the song are not scheduled
+      if (nb_messages < NB_EVENTS)
+      {
+	latencies.add(now - (first_message_time + EVENT_PERIOD * nb_messages));
+      }
+      ++nb_messages;
+    });
+
+  bench_report report (name);
+  add_latencies(report, latencies);
+  report.print();
+}
+
+// returns the number of ports if none has this client name
+static unsigned int find_port(RtMidi& midi, const char* const client_name)
+{
+  const auto nb_ports = midi.getPortCount();
+  for (auto i = decltype(nb_ports){0}; i < nb_ports; ++i)
+  {
+    if (midi.getPortName(i).find(client_name) != std::string::npos)
+    {
+      return i;
+    }
+  }
+
+  return nb_ports;
+}
+
+struct loopback_state
+{
+    std::atomic<int> last_pitch;
+    std::atomic<int64_t> received_at; // steady clock time in ns
+};
+
+static void on_loopback_message(double /* timestamp */, std::vector<unsigned char>* message, void* param)
+{
+  auto state = static_cast<loopback_state*>(param);
+  if ((message->size() == 3) and (((*message)[0] & 0xF0) == 0x90) and ((*message)[2] != 0))
+  {
+    state->received_at = std::chrono::duration_cast<std::chrono::nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    state->last_pitch = (*message)[1];
+  }
+}
+
+// Plays keys on the virtual input of a running lilyplayer and times how long
+// they take to come out of its virtual output.
+static void run_input_to_midi_thru_benchmark(const std::string& name, const bool is_loaded)
+{
+  RtMidiOut to_player (RtMidi::LINUX_ALSA, "lilyplayer-bench");
+  RtMidiIn from_player (RtMidi::LINUX_ALSA, "lilyplayer-bench");
+  const auto input_port = find_port(to_player, LILYPLAYER_VIRTUAL_MIDI_INPUT);
+  const auto output_port = find_port(from_player, LILYPLAYER_VIRTUAL_MIDI_OUTPUT);
+  if ((input_port == to_player.getPortCount()) or (output_port == from_player.getPortCount()))
+  {
+    bench_report(name).add("status", "skipped, no running lilyplayer").print();
+    return;
+  }
+
+  loopback_state state { {-1}, {0} };
+  from_player.setCallback(&on_loopback_message, &state);
+  from_player.openPort(output_port);
+  to_player.openPort(input_port);
+
+  const auto load = is_loaded ? std::make_unique<synthetic_load>() : nullptr;
+
+  constexpr const unsigned int nb_keys = 500;
+  latency_histogram latencies;
+  uint64_t nb_lost = 0;
+  for (auto i = decltype(nb_keys){0}; i < nb_keys; ++i)
+  {
+    const auto pitch = static_cast<uint8_t>(21 + i % 88);
+    state.last_pitch = -1;
+    const auto sent_at = steady_clock::now();
+    const unsigned char key_down[] = { 0x90, pitch, 100 };
+    to_player.sendMessage(key_down, sizeof(key_down));
+
+    while ((state.last_pitch != pitch) and (steady_clock::now() - sent_at < std::chrono::milliseconds(100)))
+    {
+      std::this_thread::sleep_for(std::chrono::microseconds(20));
+    }
+
+    if (state.last_pitch == pitch)
+    {
+      latencies.add(std::chrono::nanoseconds(state.received_at) - sent_at.time_since_epoch());
+    }
+    else
+    {
+      ++nb_lost;
+    }
+
+    const unsigned char key_up[] = { 0x80, pitch, 0 };
+    to_player.sendMessage(key_up, sizeof(key_up));
+    std::this_thread::sleep_for(EVENT_PERIOD);
+  }
+
+  bench_report report (name);
+  add_latencies(report, latencies);
+  report.add("lost", nb_lost).print();
+}
+
+void run_midi_latency_benchmarks()
+{
+  run_scheduled_to_output_benchmark("scheduled_to_output/idle", false);
+  run_scheduled_to_output_benchmark("scheduled_to_output/loaded", true);
+  run_input_to_midi_thru_benchmark("input_to_midi_thru/idle", false);
+  run_input_to_midi_thru_benchmark("input_to_midi_thru/loaded", true);
+}
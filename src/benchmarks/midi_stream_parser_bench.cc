@@ -0,0 +1,93 @@
+#include "bench_utils.hh"
+#include "benchmarks.hh"
+#include "../bin_file_reader.hh"
+#include "../midi_stream_parser.hh"
+#include "../utils.hh"
+
+// Turns the song into what a digital piano playing it would send on the wire:
+// running status, note on with a velocity of 0 for releases, a sustain pedal
+// pressed and released on every bar change, and active sensing bytes.
+static std::vector<uint8_t> get_keyboard_dump(const bin_song_t& song)
+{
+  std::vector<uint8_t> res;
+  uint8_t running_status = 0;
+  const auto add_message = [&] (const uint8_t status, const uint8_t data1, const uint8_t data2) {
+    if (status != running_status)
+    {
+      res.push_back(status);
+      running_status = status;
+    }
+    res.push_back(data1);
+    res.push_back(data2);
+  };
+
+  for (const auto& event : song.events)
+  {
+    for (const auto& key : event.keys_up)
+    {
+      add_message(0x90, key.pitch, 0);
+    }
+
+    for (const auto& key : event.keys_down)
+    {
+      add_message(0x90, key.pitch, 100);
+    }
+
+    if (event.has_bar_number_change())
+    {
+      add_message(0xB0, 64, 0);
+      for (uint8_t value = 0; value < 127; value = static_cast<uint8_t>(value + 8))
+      {
+	add_message(0xB0, 64, value);
+      }
+    }
+
+    res.push_back(0xFE); // active sensing
+  }
+
+  return res;
+}
+
+void run_midi_stream_parser_benchmarks(const std::vector<std::string>& song_files)
+{
+  for (const auto& song_file : song_files)
+  {
+    const auto dump = get_keyboard_dump(get_song(song_file, music_sheet_loading::skip));
+    const auto dump_size = static_cast<double>(dump.size());
+
+    // in the gui, messages are parsed as they arrive, a few bytes at a time
+    for (const std::size_t chunk_size : { std::size_t{3}, std::size_t{64}, dump.size() })
+    {
+      uint64_t nb_events = 0;
+      const auto start = std::chrono::steady_clock::now();
+      constexpr const unsigned int nb_runs = 100;
+      for (unsigned int run = 0; run < nb_runs; ++run)
+      {
+	midi_stream_parser parser;
+	midi_event events[64];
+	for (std::size_t pos = 0; pos < dump.size(); )
+	{
+	  const auto parsed = parser.parse(dump.data() + pos, std::min(chunk_size, dump.size() - pos),
+					   events, sizeof(events) / sizeof(events[0]));
+	  pos += parsed.nb_bytes_read;
+	  nb_events += parsed.nb_events;
+	  do_not_optimize(events);
+	}
+      }
+      const auto duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      bench_report("midi_stream_parser/parse")
+	.add("song", song_file)
+	.add("chunk_size", uint64_t{chunk_size})
+	.add("bytes", uint64_t{dump.size()})
+	.add("events", nb_events / nb_runs)
+	.add("megabytes_per_second", dump_size * nb_runs / duration / 1e6)
+	.add("events_per_second", static_cast<double>(nb_events) / duration)
+	.print();
+    }
+
+    run_benchmark("midi_to_key_events/" + song_file, [&] () {
+	do_not_optimize(midi_to_key_events(dump));
+      });
+  }
+}
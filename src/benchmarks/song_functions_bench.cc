@@ -0,0 +1,200 @@
+#include <cstdio> // for std::remove
+#include <cstdlib> // for mkstemp
+#include <unistd.h> // for close
+
+#include "bench_utils.hh"
+#include "benchmarks.hh"
+#include "../bin_file_reader.hh"
+#include "../bin_file_writer.hh"
+#include "../keyboard.hh"
+#include "../measures_sequence_extractor.hh"
+#include "../midi_file_writer.hh"
+#include "../midi_transform.hh"
+#include "../page_raster_cache.hh"
+#include "../page_store.hh"
+#include "../song_player.hh"
+#include "../utils.hh"
+
+// width in pixels of a page on a full hd screen
+static constexpr const int PAGE_WIDTH = 1000;
+
+// A song with a chord of 4 keys pressed and released at each event, a new
+// measure every 8 events and a new page every 200 events.
+static bin_song_t get_synthetic_song(const std::size_t nb_events)
+{
+  bin_song_t res;
+  res.instr_names = { "Right hand", "Left hand" };
+  res.events.resize(nb_events);
+  for (auto i = decltype(nb_events){0}; i < nb_events; ++i)
+  {
+    auto& event = res.events[i];
+    event.time = i * 250'000'000;
+    for (uint8_t key = 0; key < 4; ++key)
+    {
+      const auto pitch = static_cast<uint8_t>(36 + (i * 7 + key * 5) % 60);
+      event.keys_down.emplace_back(pitch, static_cast<uint8_t>(key % 2));
+      if (i != 0)
+      {
+	// the chord of the previous event
+	event.keys_up.emplace_back(static_cast<uint8_t>(36 + ((i - 1) * 7 + key * 5) % 60));
+      }
+    }
+
+    if (i % 8 == 0)
+    {
+      event.add_bar_number_change(static_cast<uint16_t>(i / 8 + 1));
+    }
+
+    if (i % 200 == 0)
+    {
+      event.add_svg_file_change(static_cast<uint16_t>(i / 200));
+    }
+  }
+
+  res.nb_events = res.events.size();
+  return res;
+}
+
+// the functions working on the events only, i.e. everything done while playing.
+static void run_events_benchmarks(const std::string& song_name, const bin_song_t& song)
+{
+  run_benchmark("update_keyboard_state/" + song_name, [&] () {
+      keyboard_state keyboard {};
+      for (const auto& event : song.events)
+      {
+	update_keyboard_state(event.keys_down, event.keys_up, keyboard);
+      }
+      do_not_optimize(keyboard);
+    });
+
+  run_benchmark("find_last_measure/" + song_name, [&] () {
+      do_not_optimize(find_last_measure(song.events));
+    });
+
+  // as done on each page turn, at various places in the song
+  run_benchmark("find_music_sheet_pos/" + song_name, [&] () {
+      const auto nb_events = song.events.size();
+      for (auto pos = decltype(nb_events){0}; pos < nb_events; pos += std::max(nb_events / 16, std::size_t{1}))
+      {
+	do_not_optimize(find_music_sheet_pos(song.events, static_cast<unsigned int>(pos)));
+      }
+    });
+
+  const auto last_measure = find_last_measure(song.events);
+  run_benchmark("get_measures_sequence_pos/whole/" + song_name, [&] () {
+      do_not_optimize(get_measures_sequence_pos(song, 1, last_measure));
+    });
+
+  run_benchmark("get_measures_sequence_pos/middle/" + song_name, [&] () {
+      const auto first = static_cast<uint16_t>(std::max(last_measure / 3, 1));
+      do_not_optimize(get_measures_sequence_pos(song, first, static_cast<uint16_t>(std::max(2 * last_measure / 3, int{first}))));
+    });
+
+  // the messages sent for each event, as is and with all the transformations
+  midi_transform as_is;
+  run_benchmark("midi_transform/as_is/" + song_name, [&] () {
+      for (const auto& event : song.events)
+      {
+	do_not_optimize(as_is.apply(event.keys_down, event.keys_up).size());
+      }
+    });
+
+  midi_transform transformed;
+  transformed.set_transposition(-2);
+  transformed.set_velocity(0.8, velocity_curve::soft);
+  transformed.set_channel(1, 2);
+  transformed.set_octave_doubling(1);
+  transformed.set_muted(3, true);
+  run_benchmark("midi_transform/transformed/" + song_name, [&] () {
+      for (const auto& event : song.events)
+      {
+	do_not_optimize(transformed.apply(event.keys_down, event.keys_up).size());
+      }
+    });
+
+  // the whole song played on a virtual clock, as the player would play it
+  auto waiting_events = song.events;
+  to_waiting_times(waiting_events);
+  run_benchmark("simulate_playback/" + song_name, [&] () {
+      midi_transform transform;
+      do_not_optimize(simulate_playback(waiting_events, 0, static_cast<unsigned int>(waiting_events.size()), transform));
+    });
+}
+
+// what the window does to display a page: parse its svg, then rasterise it.
+static void run_music_sheet_benchmarks(const std::string& song_file)
+{
+  auto song = get_song(song_file);
+  if (song.svg_files.empty())
+  {
+    return;
+  }
+
+  page_store pages;
+  pages.set_pages(std::move(song.svg_files));
+  const auto compressed_pages = pages.get_compressed_pages();
+
+  // no parsed page is kept, so each call parses it again
+  pages.set_memory_budget(0);
+  run_benchmark("display_music_sheet/parse_page/" + song_file, [&] () {
+      do_not_optimize(pages.get_renderer(0).defaultSize());
+    });
+
+  run_benchmark("display_music_sheet/render_page/" + song_file, [&] () {
+      do_not_optimize(page_raster_cache::render_page(compressed_pages.front(), PAGE_WIDTH));
+    });
+}
+
+// writes the file in a temporary file and returns its name
+static std::string write_temporary_file(const std::vector<uint8_t>& content)
+{
+  char filename[] = "/tmp/lilyplayer-bench-XXXXXX";
+  const auto fd = mkstemp(filename);
+  if (fd < 0)
+  {
+    throw std::runtime_error("Error: failed to create a temporary file");
+  }
+  close(fd);
+
+  write_file(filename, content);
+  return filename;
+}
+
+void run_song_functions_benchmarks(const std::vector<std::string>& song_files)
+{
+  for (const auto& song_file : song_files)
+  {
+    // read_grouped_event is most of the time spent reading a song without its pages
+    run_benchmark("get_song/parse/" + song_file, [&] () {
+	do_not_optimize(get_song(song_file));
+      });
+
+    run_benchmark("get_song/skip_music_sheet/" + song_file, [&] () {
+	do_not_optimize(get_song(song_file, music_sheet_loading::skip));
+      });
+
+    run_events_benchmarks(song_file, get_song(song_file, music_sheet_loading::skip));
+    run_music_sheet_benchmarks(song_file);
+  }
+
+  for (const std::size_t nb_events : { std::size_t{1'000}, std::size_t{100'000} })
+  {
+    const auto song = get_synthetic_song(nb_events);
+    const auto song_name = "synthetic_" + std::to_string(nb_events);
+
+    const auto filename = write_temporary_file(get_bin_file(song));
+    run_benchmark("get_song/skip_music_sheet/" + song_name, [&] () {
+	do_not_optimize(get_song(filename, music_sheet_loading::skip));
+      });
+    std::remove(filename.c_str());
+
+    // the same song as a standard midi file with a track per staff
+    const auto midi_filename = write_temporary_file(get_standard_midi_file(song));
+    run_benchmark("get_song/standard_midi_file/" + song_name, [&] () {
+	do_not_optimize(get_song(midi_filename));
+      });
+    std::remove(midi_filename.c_str());
+
+    run_events_benchmarks(song_name, song);
+  }
+}
@@ -0,0 +1,128 @@
+#include <atomic>
+#include <thread>
+
+#include "bench_utils.hh"
+#include "benchmarks.hh"
+#include "../spsc_ring_buffer.hh"
+#include "../utils.hh"
+
+static input_midi_message get_note_on(const uint64_t i)
+{
+  input_midi_message res {};
+  res.timestamp = 0.001;
+  res.size = 3;
+  res.bytes[0] = 0x90;
+  res.bytes[1] = static_cast<uint8_t>(21 + (i % 88));
+  res.bytes[2] = 100;
+  return res;
+}
+
+// producer and consumer both running flat out
+static void bench_throughput()
+{
+  constexpr const uint64_t nb_messages = 10'000'000;
+  spsc_ring_buffer<input_midi_message> queue(INPUT_MIDI_QUEUE_CAPACITY);
+  uint64_t nb_full = 0;
+
+  const auto start = std::chrono::steady_clock::now();
+  std::thread producer([&] () {
+      for (uint64_t i = 0; i < nb_messages; )
+      {
+	if (queue.push(get_note_on(i)))
+	{
+	  ++i;
+	}
+	else
+	{
+	  ++nb_full;
+	}
+      }
+    });
+
+  uint64_t nb_consumed = 0;
+  uint64_t checksum = 0;
+  while (nb_consumed < nb_messages)
+  {
+    nb_consumed += queue.consume_all([&] (const input_midi_message& message) {
+	checksum += message.bytes[1];
+      });
+  }
+  producer.join();
+  const auto duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  do_not_optimize(checksum);
+
+  bench_report("spsc_ring_buffer/throughput")
+    .add("messages", nb_messages)
+    .add("messages_per_second", static_cast<double>(nb_messages) / duration)
+    .add("push_on_full_queue", nb_full)
+    .print();
+}
+
+// the gui thread drains the queue once per frame while a keyboard sends
+// messages at a fixed rate. Reports the drops for each rate.
+static void bench_frame_paced_drain()
+{
+  using clock = std::chrono::steady_clock;
+  constexpr const auto frame_duration = std::chrono::microseconds{16'667};
+  constexpr const auto burst_period = std::chrono::milliseconds{1};
+  constexpr const auto test_duration = std::chrono::seconds{1};
+
+  uint64_t max_rate_without_drops = 0;
+  for (const uint64_t messages_per_second : { uint64_t{1'000}, uint64_t{10'000}, uint64_t{100'000},
+					      uint64_t{200'000}, uint64_t{1'000'000} })
+  {
+    spsc_ring_buffer<input_midi_message> queue(INPUT_MIDI_QUEUE_CAPACITY);
+    std::atomic<bool> is_done {false};
+    uint64_t nb_dropped = 0;
+    uint64_t nb_sent = 0;
+
+    std::thread producer([&] () {
+	const auto messages_per_burst = messages_per_second / 1000;
+	const auto start = clock::now();
+	for (auto next_burst = start; next_burst - start < test_duration; next_burst += burst_period)
+	{
+	  std::this_thread::sleep_until(next_burst);
+	  for (uint64_t i = 0; i < messages_per_burst; ++i, ++nb_sent)
+	  {
+	    if (not queue.push(get_note_on(i)))
+	    {
+	      ++nb_dropped;
+	    }
+	  }
+	}
+	is_done = true;
+      });
+
+    uint64_t nb_consumed = 0;
+    for (auto next_frame = clock::now(); not is_done; next_frame += frame_duration)
+    {
+      std::this_thread::sleep_until(next_frame);
+      nb_consumed += queue.consume_all([] (const input_midi_message&) {});
+    }
+    producer.join();
+    nb_consumed += queue.consume_all([] (const input_midi_message&) {});
+
+    if (nb_dropped == 0)
+    {
+      max_rate_without_drops = messages_per_second;
+    }
+
+    bench_report("spsc_ring_buffer/frame_paced_drain")
+      .add("messages_per_second", messages_per_second)
+      .add("sent", nb_sent)
+      .add("consumed", nb_consumed)
+      .add("dropped", nb_dropped)
+      .print();
+  }
+
+  bench_report("spsc_ring_buffer/frame_paced_drain_summary")
+    .add("capacity", uint64_t{INPUT_MIDI_QUEUE_CAPACITY})
+    .add("max_messages_per_second_without_drops", max_rate_without_drops)
+    .print();
+}
+
+void run_spsc_ring_buffer_benchmarks()
+{
+  bench_throughput();
+  bench_frame_paced_drain();
+}
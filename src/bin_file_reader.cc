@@ -1,5 +1,4 @@
 #include <stdexcept>
-#include <fstream>
 #include <string>
 #include <algorithm>
 #include <cstring> // for std::memcmp
@@ -7,48 +6,43 @@
 #include <QSvgRenderer> // to ensure reading the svg files won't cause any problem
 
 #include "bin_file_reader.hh"
+#include "mapped_file.hh"
 #include "utils.hh"
+#include "trace_events.hh"
+#include "memory_footprint.hh"
+#include "midi_file_reader.hh"
 
 template <typename T>
-static T read_big_endian(std::fstream& file)
+static T read_big_endian(byte_reader& file)
 {
-  T res = 0;
-  for (unsigned int i = 0; i < sizeof(T); ++i)
-  {
-    uint8_t tmp;
-    file.read(static_cast<char*>(static_cast<void*>(&tmp)), sizeof(tmp));
-    res = static_cast<decltype(res)>( (res << 8) | tmp);
-  }
-  return res;
-};
+  return file.read_big_endian<T>();
+}
 
-static bool is_header_correct(std::fstream& file, const char expected[4])
+static bool is_header_correct(byte_reader& file, const char expected[4])
 {
-  char buffer[4];
-  file.read(buffer, sizeof(buffer));
-
-  return (static_cast<unsigned>(file.gcount()) == sizeof(buffer)) and
-    (std::memcmp(buffer, expected, sizeof(buffer)) == 0);
+  constexpr const std::size_t header_size = 4;
+  return (file.remaining() >= header_size) and
+    (std::memcmp(file.skip(header_size), expected, header_size) == 0);
 }
 
 static
-std::string read_string(std::fstream& file)
+std::string read_string(byte_reader& file)
 {
-  std::string res;
-
-  uint8_t c = read_big_endian<uint8_t>(file);
-  while (c != '\0')
+  const auto str_end = static_cast<const uint8_t*>(std::memchr(file.pos, '\0', file.remaining()));
+  if (str_end == nullptr)
   {
-    res.push_back(static_cast<char>(c)); // don't add '\0' by hand in a std::string
-    c = read_big_endian<uint8_t>(file);
+    throw std::invalid_argument("Error: invalid file (unexpected end of file)");
   }
 
-  return res;
+  // don't add '\0' by hand in a std::string
+  const auto str_begin = file.skip(static_cast<std::size_t>(str_end - file.pos) + 1);
+  return std::string{ static_cast<const char*>(static_cast<const void*>(str_begin)),
+		      static_cast<std::size_t>(str_end - str_begin) };
 }
 
 
 static
-music_sheet_event read_grouped_event(std::fstream& file)
+music_sheet_event read_grouped_event(byte_reader& file, const music_sheet_loading sheet_loading)
 {
   music_sheet_event res;
 
@@ -128,6 +122,17 @@ music_sheet_event read_grouped_event(std::fstream& file)
 
 	const auto width = right - left;
 	const auto height = bottom - top;
+	const auto cursor_box_coord = QRectF{ static_cast<qreal>(left) / 10000,
+					      static_cast<qreal>(top) / 10000,
+					      static_cast<qreal>(width) / 10000,
+					      static_cast<qreal>(height) / 10000 };
+
+	if (sheet_loading == music_sheet_loading::skip)
+	{
+	  // nobody will display the cursor, don't spend time building its svg
+	  res.add_cursor_change("", cursor_box_coord);
+	  break;
+	}
 
 	const auto to_dotted_str = [] (const auto num) {
 	  return std::to_string(num / 10000) + "." + std::to_string(num % 10000);
@@ -138,10 +143,7 @@ music_sheet_event read_grouped_event(std::fstream& file)
 	  + to_dotted_str(width) + "\" height=\"" + to_dotted_str(height)
 	  + "\" ry=\"0.0000\" fill=\"currentColor\" fill-opacity=\"0.4\"/></svg>";
 
-	res.add_cursor_change(str.c_str(), QRectF{ static_cast<qreal>(left) / 10000,
-						   static_cast<qreal>(top) / 10000,
-						   static_cast<qreal>(width) / 10000,
-						   static_cast<qreal>(height) / 10000 } );
+	res.add_cursor_change(str.c_str(), cursor_box_coord);
 	break;
       }
 
@@ -167,21 +169,29 @@ music_sheet_event read_grouped_event(std::fstream& file)
 				"cursor pos");
   }
 
-  res.midi_messages = get_midi_from_keys_events(res.keys_down, res.keys_up);
-
   return res;
 }
 
-bin_song_t get_song(const std::string& filename)
+void check_memory_budget(const std::size_t memory_usage, const std::size_t memory_budget)
 {
-  std::fstream file(filename, std::ios::binary | std::ios::in);
+  if (memory_usage > memory_budget)
+  {
+    throw memory_budget_exceeded("Error: the song needs more than the memory budget of " +
+				 std::to_string(memory_budget / (1024 * 1024)) + " MiB");
+  }
+}
 
-  if (not file.is_open())
+bin_song_t get_song(const std::string& filename, const music_sheet_loading sheet_loading, const std::size_t memory_budget)
+{
+  trace_span span ("get_song");
+  const mapped_file file_content(filename);
+  if (is_standard_midi_file(file_content.data(), file_content.size()))
   {
-    throw std::runtime_error(std::string{"Error: unable to open midi file ["}
-			     + filename + "]");
+    return get_song_from_standard_midi_file(file_content.data(), file_content.size(), memory_budget);
   }
 
+  byte_reader file(file_content.data(), file_content.size());
+
   // file must start by the magic number 'LPYP'
   const char file_header[4] = { 'L', 'P', 'Y', 'P' };
   if (not is_header_correct(file, file_header))
@@ -219,11 +229,26 @@ bin_song_t get_song(const std::string& filename)
     throw std::invalid_argument("Error: a song with nothing happening? That doesn't make sense");
   }
 
+  // a group of events takes at least 11 bytes (time, number of events and a key release).
+  // Don't trust the announced number of events blindly before reserving memory.
+  constexpr const std::size_t min_grouped_event_size = 11;
+  const auto nb_reserved_events = static_cast<std::size_t>(std::min(nb_group_of_events,
+								   uint64_t{file.remaining() / min_grouped_event_size}));
+  auto memory_usage = nb_reserved_events * sizeof(music_sheet_event);
+  check_memory_budget(memory_usage, memory_budget);
+  res.events.reserve(nb_reserved_events);
+
   // read all the music_sheet_event (aka group of events)
-  for (auto i = decltype(nb_group_of_events){0}; i < nb_group_of_events; ++i)
   {
-    auto grouped_event = read_grouped_event(file);
-    res.events.emplace_back( std::move(grouped_event) );
+    trace_span events_span ("get_song/read_events");
+    for (auto i = decltype(nb_group_of_events){0}; i < nb_group_of_events; ++i)
+    {
+      auto grouped_event = read_grouped_event(file, sheet_loading);
+      memory_usage += get_event_footprint(grouped_event);
+      check_memory_budget(memory_usage, memory_budget);
+      res.events.emplace_back( std::move(grouped_event) );
+    }
+    events_span.set_arg("nb_events", static_cast<int64_t>(res.events.size()));
   }
 
   // sanity check: the events must appear in chronological order
@@ -236,22 +261,35 @@ bin_song_t get_song(const std::string& filename)
 
   // read the svg files
   const auto nb_svg_files = read_big_endian<uint16_t>(file);
-  for (auto i = decltype(nb_svg_files){0}; i < nb_svg_files; ++i)
+  res.nb_pages = nb_svg_files;
   {
-    const auto file_size = read_big_endian<uint32_t>(file);
+    trace_span pages_span ("get_song/read_pages");
+    for (auto i = decltype(nb_svg_files){0}; i < nb_svg_files; ++i)
+    {
+      const auto file_size = read_big_endian<uint32_t>(file);
 
-    svg_data this_file;
-    this_file.data.resize( file_size );
+      const auto file_data = file.skip(file_size);
+      if (sheet_loading == music_sheet_loading::skip)
+      {
+	continue;
+      }
 
-    auto ptr = static_cast<void*>(this_file.data.data());
-    file.read( static_cast<char*>(ptr), static_cast<int>(file_size) );
+      memory_usage += file_size;
+      check_memory_budget(memory_usage, memory_budget);
 
-    res.svg_files.emplace_back( std::move(this_file) );
+      svg_data this_file;
+      this_file.data.assign(file_data, file_data + file_size);
+
+      res.svg_files.emplace_back( std::move(this_file) );
+    }
   }
 
   // sanity check: make sure parsing the svg_files won't cause any problem
-  for (auto i = decltype(nb_svg_files){0}; i < nb_svg_files; ++i)
+  const auto nb_loaded_svg_files = res.svg_files.size();
+  for (auto i = decltype(nb_loaded_svg_files){0}; i < nb_loaded_svg_files; ++i)
   {
+    trace_span parse_span ("get_song/parse_page");
+    parse_span.set_arg("page", static_cast<int64_t>(i));
     const QByteArray sheet (static_cast<const char*>(static_cast<const void*>(res.svg_files[i].data.data())),
 			    static_cast<int>(res.svg_files[i].data.size()));
 
@@ -260,7 +298,7 @@ bin_song_t get_song(const std::string& filename)
     if (not is_load_successfull)
     {
       throw std::runtime_error(std::string{"Error: Failed to read svg file "} +
-			       std::to_string(static_cast<long unsigned int>(i)));
+			       std::to_string(i));
     }
   }
 
@@ -285,15 +323,22 @@ bin_song_t get_song(const std::string& filename)
 
   // sanity check: file must have been entirely read by now (no more remaining
   // bytes)
-  file.peek(); // just to set the eof bit.
-  if (not file.eof())
+  if (file.remaining() != 0)
   {
     throw std::invalid_argument("Error: invalid file (extra bytes after end of data)");
   }
 
+  res.nb_events = res.events.size();
+
+  if (sheet_loading == music_sheet_loading::skip)
+  {
+    return res;
+  }
+
   // All cursor changes have been translated into an _almost_ svg file. They are missing
   // the first line at this point. Therefore, process go through all the events to add
   // the first line to all of them.
+  trace_span cursors_span ("get_song/cursor_boxes");
   std::string current_first_line;
   for (auto& elt : res.events)
   {
@@ -305,6 +350,9 @@ bin_song_t get_song(const std::string& filename)
 
     if (elt.has_cursor_pos_change())
     {
+      memory_usage += current_first_line.size();
+      check_memory_budget(memory_usage, memory_budget);
+
       const auto tmp = std::move(elt.new_cursor_box);
       elt.new_cursor_box = current_first_line.c_str();
       elt.new_cursor_box += tmp;
@@ -326,7 +374,5 @@ bin_song_t get_song(const std::string& filename)
     }
   }
 
-  res.nb_events = res.events.size();
-
   return res;
 }
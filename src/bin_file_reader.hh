@@ -2,7 +2,10 @@
 #define BIN_FILE_READER_HH
 
 #include <vector>
+#include <cstddef>
 #include <cstdint>
+#include <limits>
+#include <stdexcept>
 #include <string>
 #include <QByteArray>
 #include <QRectF>
@@ -22,7 +25,6 @@ struct music_sheet_event
       : time()
       , keys_down()
       , keys_up()
-      , midi_messages()
       , new_cursor_box()
       , cursor_box_coord()
       , sheet_events(static_cast<has_event>(0))
@@ -35,7 +37,6 @@ struct music_sheet_event
 		   // (in ns)
     std::vector<key_down> keys_down;
     std::vector<key_up>   keys_up;
-    std::vector<midi_message_t> midi_messages;
     QByteArray new_cursor_box;
     QRectF cursor_box_coord;
   private:
@@ -99,6 +100,7 @@ struct bin_song_t
       , nb_events(0)
       , instr_names()
       , svg_files ()
+      , nb_pages(0)
     {
     }
 
@@ -107,10 +109,34 @@ struct bin_song_t
                                        // calling events.size() at each loop
     std::vector<std::string> instr_names;
     std::vector<svg_data> svg_files;
+    uint16_t nb_pages; // number of pages in the file, even when svg_files are skipped
 };
 
 
 
-bin_song_t get_song(const std::string& filename);
+enum class music_sheet_loading : uint8_t
+{
+  parse, // read, check and keep the svg pages and the cursor boxes
+  skip,  // only keep the keyboard events. Pages and cursors are skipped over
+};
+
+constexpr const std::size_t NO_MEMORY_BUDGET = std::numeric_limits<std::size_t>::max();
+
+// thrown by get_song when the song needs more memory than its budget
+class memory_budget_exceeded final : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+// throws memory_budget_exceeded if memory_usage is over memory_budget
+void check_memory_budget(std::size_t memory_usage, std::size_t memory_budget);
+
+// Reads a lilyplayer file, or a standard midi file (see midi_file_reader.hh).
+// memory_budget bounds the memory taken by the song while it is being read,
+// in bytes. Reading stops as soon as it is exceeded.
+bin_song_t get_song(const std::string& filename,
+		    music_sheet_loading sheet_loading = music_sheet_loading::parse,
+		    std::size_t memory_budget = NO_MEMORY_BUDGET);
 
 #endif /* BIN_FILE_READER_HH */
@@ -0,0 +1,91 @@
+#include <fstream>
+#include <stdexcept>
+
+#include "bin_file_writer.hh"
+
+template <typename T>
+static void write_big_endian(std::vector<uint8_t>& out, const T value)
+{
+  for (auto i = sizeof(T); i > 0; --i)
+  {
+    out.push_back(static_cast<uint8_t>(value >> ((i - 1) * 8)));
+  }
+}
+
+// same event ids as the ones read by read_grouped_event
+enum event_type : uint8_t
+{
+  press_key      = 0,
+  release_key    = 1,
+  set_bar_number = 2,
+};
+
+std::vector<uint8_t> get_bin_file(const bin_song_t& song)
+{
+  if (song.instr_names.empty() or (song.instr_names.size() > 0xFF))
+  {
+    throw std::invalid_argument("Error: a song must have between 1 and 255 instruments");
+  }
+
+  if (song.events.empty())
+  {
+    throw std::invalid_argument("Error: a song with nothing happening can't be written");
+  }
+
+  std::vector<uint8_t> res { 'L', 'P', 'Y', 'P', 0 /* format version */ };
+
+  write_big_endian(res, static_cast<uint8_t>(song.instr_names.size()));
+  for (const auto& instr_name : song.instr_names)
+  {
+    res.insert(res.end(), instr_name.cbegin(), instr_name.cend());
+    res.push_back('\0');
+  }
+
+  write_big_endian(res, uint64_t{song.events.size()});
+  for (const auto& event : song.events)
+  {
+    const auto nb_events = event.keys_down.size() + event.keys_up.size() + (event.has_bar_number_change() ? 1 : 0);
+    if ((nb_events == 0) or (nb_events > 0xFF))
+    {
+      throw std::invalid_argument("Error: a group of events must have between 1 and 255 events");
+    }
+
+    write_big_endian(res, event.time);
+    write_big_endian(res, static_cast<uint8_t>(nb_events));
+
+    if (event.has_bar_number_change())
+    {
+      write_big_endian(res, uint8_t{event_type::set_bar_number});
+      write_big_endian(res, event.new_bar_number);
+    }
+
+    for (const auto& key : event.keys_up)
+    {
+      write_big_endian(res, uint8_t{event_type::release_key});
+      write_big_endian(res, key.pitch);
+    }
+
+    for (const auto& key : event.keys_down)
+    {
+      write_big_endian(res, uint8_t{event_type::press_key});
+      write_big_endian(res, key.pitch);
+      write_big_endian(res, key.staff_num);
+    }
+  }
+
+  write_big_endian(res, uint16_t{0}); // no music sheet pages
+  return res;
+}
+
+void write_file(const std::string& filename, const std::vector<uint8_t>& data)
+{
+  std::ofstream out(filename, std::ios::binary | std::ios::out | std::ios::trunc);
+  out.write(static_cast<const char*>(static_cast<const void*>(data.data())),
+	    static_cast<std::streamsize>(data.size()));
+  out.close();
+
+  if (not out)
+  {
+    throw std::runtime_error(std::string{"Error: failed to write file ["} + filename + "]");
+  }
+}
@@ -0,0 +1,19 @@
+#ifndef BIN_FILE_WRITER_HH
+#define BIN_FILE_WRITER_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bin_file_reader.hh"
+
+// Serialises the song in the format read by get_song: its instruments, keys
+// and bar numbers. The cursors and music sheet pages are not written, the
+// file only holds the event stream. Event times must be in ns since the
+// beginning of the song.
+std::vector<uint8_t> get_bin_file(const bin_song_t& song);
+
+// writes the data as is. Throws an exception on failure.
+void write_file(const std::string& filename, const std::vector<uint8_t>& data);
+
+#endif /* BIN_FILE_WRITER_HH */
@@ -0,0 +1,83 @@
+#include <algorithm>
+
+#include "chord_matcher.hh"
+
+chord_matcher::chord_matcher()
+  : staff(NO_STAFF)
+  , expected_keys()
+  , pressed_keys()
+  , is_waiting(false)
+  , nb_matched_chords(0)
+  , nb_slow_matches(0)
+  , total_latency(0)
+  , max_latency(0)
+{
+}
+
+void chord_matcher::set_staff(const unsigned int new_staff, const std::vector<music_sheet_event>& events)
+{
+  staff = new_staff;
+  set_song(events);
+}
+
+void chord_matcher::set_song(const std::vector<music_sheet_event>& events)
+{
+  expected_keys.clear();
+  pressed_keys.reset();
+  is_waiting = false;
+
+  if (not is_enabled())
+  {
+    return;
+  }
+
+  expected_keys.reserve(events.size());
+  for (const auto& event : events)
+  {
+    key_set keys;
+    for (const auto& key : event.keys_down)
+    {
+      if ((staff == ALL_STAFFS) or (key.staff_num == staff))
+      {
+	keys.set(key.pitch & 0x7F);
+      }
+    }
+    expected_keys.push_back(keys);
+  }
+}
+
+void chord_matcher::on_event_processed(const unsigned int event_pos)
+{
+  is_waiting = false;
+  if ((event_pos < expected_keys.size()) and expected_keys[event_pos].any())
+  {
+    pressed_keys.reset();
+  }
+}
+
+void chord_matcher::add_latency(const std::chrono::nanoseconds latency)
+{
+  ++nb_matched_chords;
+  total_latency += latency;
+  max_latency = std::max(max_latency, latency);
+  if (latency > std::chrono::milliseconds(1))
+  {
+    ++nb_slow_matches;
+  }
+}
+
+void chord_matcher::report(std::ostream& out)
+{
+  if (nb_matched_chords != 0)
+  {
+    out << "Practice: " << nb_matched_chords << " chords played, input to advance latency "
+	<< (std::chrono::duration<double, std::micro>(total_latency).count() / static_cast<double>(nb_matched_chords))
+	<< " us on average, " << std::chrono::duration<double, std::micro>(max_latency).count()
+	<< " us at most, " << nb_slow_matches << " above 1 ms\n";
+  }
+
+  nb_matched_chords = 0;
+  nb_slow_matches = 0;
+  total_latency = std::chrono::nanoseconds{0};
+  max_latency = std::chrono::nanoseconds{0};
+}
@@ -0,0 +1,66 @@
+#ifndef CHORD_MATCHER_HH
+#define CHORD_MATCHER_HH
+
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+#include "bin_file_reader.hh"
+
+// Practice mode: the song waits at each event until the player pressed the
+// keys it expects on a staff. The keys expected at each event are computed
+// once per song, so that matching a pressed key is a couple of bit operations.
+class chord_matcher
+{
+  public:
+    static constexpr const unsigned int NO_STAFF = std::numeric_limits<unsigned int>::max(); // practice mode disabled
+    static constexpr const unsigned int ALL_STAFFS = NO_STAFF - 1;
+
+    using key_set = std::bitset<128>; // one bit per midi pitch
+
+    chord_matcher();
+
+    // the keys expected on the staff at each event are recomputed on both.
+    void set_staff(unsigned int staff, const std::vector<music_sheet_event>& events);
+    void set_song(const std::vector<music_sheet_event>& events);
+
+    unsigned int get_staff() const { return staff; }
+    bool is_enabled() const { return staff != NO_STAFF; }
+
+    void press_key(const uint8_t pitch) { pressed_keys.set(pitch & 0x7F); }
+
+    // true if all the keys expected at this event have been pressed since the
+    // previous chord. Otherwise the song must wait for them.
+    bool is_matched(const unsigned int event_pos) const
+    {
+      return (event_pos >= expected_keys.size()) or (expected_keys[event_pos] & ~pressed_keys).none();
+    }
+
+    void wait_for_player() { is_waiting = true; }
+    bool is_waiting_for_player() const { return is_waiting; }
+
+    // the keys pressed until now are used up by this event if it expected some.
+    void on_event_processed(unsigned int event_pos);
+
+    // time between the reception of the key completing a chord and the song going on.
+    void add_latency(std::chrono::nanoseconds latency);
+
+    // prints the latencies since the last report, then resets them.
+    void report(std::ostream& out);
+
+  private:
+    unsigned int staff;
+    std::vector<key_set> expected_keys; // one per event
+    key_set pressed_keys;
+    bool is_waiting;
+
+    uint64_t nb_matched_chords;
+    uint64_t nb_slow_matches; // above one ms
+    std::chrono::nanoseconds total_latency;
+    std::chrono::nanoseconds max_latency;
+};
+
+#endif /* CHORD_MATCHER_HH */
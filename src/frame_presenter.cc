@@ -0,0 +1,113 @@
+#include "frame_presenter.hh"
+
+frame_presenter::frame_presenter()
+  : keyboard()
+  , is_keyboard_dirty(false)
+  , page(NO_CHANGE)
+  , cursor_event(NO_CHANGE)
+  , nb_changes(0)
+  , nb_frames(0)
+  , nb_page_changes(0)
+  , nb_pages_displayed(0)
+  , nb_cursor_changes(0)
+  , nb_cursors_displayed(0)
+{
+  keyboard.fill(0);
+}
+
+void frame_presenter::on_change()
+{
+  ++nb_changes;
+}
+
+void frame_presenter::update_keys(const std::vector<key_down>& keys_down,
+				  const std::vector<key_up>& keys_up)
+{
+  update_keyboard_state(keys_down, keys_up, keyboard);
+  is_keyboard_dirty = true;
+  on_change();
+}
+
+void frame_presenter::press_key(const uint8_t pitch, const uint8_t staff_num)
+{
+  ::press_key(keyboard, pitch, staff_num);
+  is_keyboard_dirty = true;
+  on_change();
+}
+
+void frame_presenter::release_key(const uint8_t pitch)
+{
+  ::release_key(keyboard, pitch);
+  is_keyboard_dirty = true;
+  on_change();
+}
+
+void frame_presenter::release_all_keys()
+{
+  keyboard.fill(0);
+  is_keyboard_dirty = true;
+  on_change();
+}
+
+void frame_presenter::set_page(const unsigned int new_page)
+{
+  page = new_page;
+  // a cursor set before belongs to the previous page.
+  cursor_event = NO_CHANGE;
+  ++nb_page_changes;
+  on_change();
+}
+
+void frame_presenter::set_cursor(const unsigned int event_pos)
+{
+  cursor_event = event_pos;
+  ++nb_cursor_changes;
+  on_change();
+}
+
+void frame_presenter::drop_music_sheet_changes()
+{
+  page = NO_CHANGE;
+  cursor_event = NO_CHANGE;
+}
+
+bool frame_presenter::has_pending_changes() const
+{
+  return is_keyboard_dirty or (page != NO_CHANGE) or (cursor_event != NO_CHANGE);
+}
+
+frame_presenter::frame frame_presenter::take_frame()
+{
+  const frame res { is_keyboard_dirty ? &keyboard : nullptr, page, cursor_event };
+
+  if (has_pending_changes())
+  {
+    ++nb_frames;
+  }
+
+  nb_pages_displayed += (page != NO_CHANGE) ? 1 : 0;
+  nb_cursors_displayed += (cursor_event != NO_CHANGE) ? 1 : 0;
+
+  is_keyboard_dirty = false;
+  page = NO_CHANGE;
+  cursor_event = NO_CHANGE;
+  return res;
+}
+
+void frame_presenter::report(std::ostream& out)
+{
+  if (nb_changes != 0)
+  {
+    out << "Display: " << nb_changes << " changes presented in " << nb_frames << " frames ("
+	<< (nb_changes - nb_frames) << " redundant repaints avoided, "
+	<< (nb_page_changes - nb_pages_displayed) << " page loads and "
+	<< (nb_cursor_changes - nb_cursors_displayed) << " cursor loads skipped)\n";
+  }
+
+  nb_changes = 0;
+  nb_frames = 0;
+  nb_page_changes = 0;
+  nb_pages_displayed = 0;
+  nb_cursor_changes = 0;
+  nb_cursors_displayed = 0;
+}
@@ -0,0 +1,64 @@
+#ifndef FRAME_PRESENTER_HH
+#define FRAME_PRESENTER_HH
+
+#include <cstdint>
+#include <limits>
+#include <ostream>
+
+#include "keyboard.hh"
+
+// Accumulates the visual changes (keys, music sheet page and cursor) between
+// two display refreshes, so that only the latest state gets drawn once per
+// frame. Sending midi messages doesn't go through it and stays on time.
+class frame_presenter
+{
+  public:
+    static constexpr const int FRAME_PERIOD_MS = 16; // ~60 frames per second
+    static constexpr const unsigned int NO_CHANGE = std::numeric_limits<unsigned int>::max();
+
+    // changes to apply on screen
+    struct frame
+    {
+	const keyboard_state* keyboard; // nullptr if the keys didn't change
+	unsigned int page;              // NO_CHANGE or music sheet to display
+	unsigned int cursor_event;      // NO_CHANGE or position of the event holding the cursor
+    };
+
+    frame_presenter();
+
+    void update_keys(const std::vector<key_down>& keys_down,
+		     const std::vector<key_up>& keys_up);
+    void press_key(uint8_t pitch, uint8_t staff_num);
+    void release_key(uint8_t pitch);
+    void release_all_keys();
+    void set_page(unsigned int page);
+    void set_cursor(unsigned int event_pos);
+
+    // forget the page and cursor changes, for when the music sheet is displayed directly.
+    void drop_music_sheet_changes();
+
+    bool has_pending_changes() const __attribute__((pure));
+
+    // returns the pending changes and consider them as presented.
+    frame take_frame();
+
+    // prints how many repaints were avoided since the last report, then resets the counters.
+    void report(std::ostream& out);
+
+  private:
+    void on_change();
+
+    keyboard_state keyboard;
+    bool is_keyboard_dirty;
+    unsigned int page;
+    unsigned int cursor_event;
+
+    uint64_t nb_changes;        // each of them used to trigger a repaint
+    uint64_t nb_frames;
+    uint64_t nb_page_changes;
+    uint64_t nb_pages_displayed;
+    uint64_t nb_cursor_changes;
+    uint64_t nb_cursors_displayed;
+};
+
+#endif
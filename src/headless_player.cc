@@ -0,0 +1,107 @@
+#include <poll.h>
+#include <signal.h>
+#include <algorithm>
+#include <chrono>
+#include <rtmidi/RtMidi.h>
+
+#include "headless_player.hh"
+#include "trace_events.hh"
+#include "utils.hh"
+#include "signals_handler.hh"
+#include "song_scheduler.hh"
+#include "log.hh"
+
+static void on_midi_output_error(RtMidiError::Type type, const std::string &errorText, void* param __attribute__((unused)))
+{
+  // called on every failed message, e.g. while a device is unplugged
+  static log_site midi_error_log (log_level::error);
+  log_line(midi_error_log) << "Error occured for midi output:\n"
+			   << "  RtMidi considers this as a " << rt_error_type_as_str(type) << "\n"
+			   << "  it also says: " << errorText;
+}
+
+static void send_messages(const std::vector<short_midi_message>& messages,
+			  const std::function<void(const uint8_t* bytes, std::size_t size)>& send_message)
+{
+  for (const auto& message : messages)
+  {
+    send_message(message.bytes, sizeof(message.bytes));
+  }
+}
+
+void play_headless(bin_song_t song, midi_transform transform, const unsigned int output_port)
+{
+  RtMidiOut sound_player(RtMidi::LINUX_ALSA, LILYPLAYER_VIRTUAL_MIDI_OUTPUT);
+  sound_player.setErrorCallback(&on_midi_output_error, nullptr);
+  sound_player.openPort(output_port);
+
+  play_headless(std::move(song), std::move(transform), [&] (const uint8_t* const bytes, const std::size_t size) {
+      sound_player.sendMessage(bytes, size);
+    });
+
+  sound_player.closePort();
+}
+
+void play_headless(bin_song_t song, midi_transform transform,
+		   const std::function<void(const uint8_t* bytes, std::size_t size)>& send_message)
+{
+  // same waiting times as the ones used by the graphical interface
+  to_waiting_times(song.events);
+
+  steady_playback_clock clock;
+  song_scheduler scheduler (clock);
+  scheduler.set_song(song.events);
+  scheduler.resume();
+
+  while (not scheduler.is_over())
+  {
+    // wait for the next event, or a signal. While paused, only a signal can
+    // wake the player up.
+    struct timespec timeout {0, 0};
+    if (not scheduler.is_paused())
+    {
+      const auto time_to_wait = scheduler.get_time_to_next_due();
+      const auto seconds_to_wait = std::chrono::duration_cast<std::chrono::seconds>(time_to_wait);
+      timeout.tv_sec = seconds_to_wait.count();
+      timeout.tv_nsec = (time_to_wait - seconds_to_wait).count();
+    }
+
+    struct pollfd signal_fd { get_signal_fd(), POLLIN, 0 };
+    const auto nb_ready = ppoll(&signal_fd, 1, scheduler.is_paused() ? nullptr : &timeout, nullptr);
+
+    if ((nb_ready > 0) and ((signal_fd.revents & POLLIN) != 0))
+    {
+      const auto requests = read_signal_requests();
+      if (requests.exit)
+      {
+	break;
+      }
+
+      if (requests.pause)
+      {
+	scheduler.pause();
+	send_messages(transform.release_all(), send_message);
+      }
+
+      if (requests.resume)
+      {
+	// like in the graphical interface, the pending event is played
+	// as soon as the song is resumed.
+	scheduler.resume();
+      }
+    }
+
+    const auto event_pos = scheduler.take_due_event();
+    if (event_pos == song_scheduler::NO_EVENT)
+    {
+      continue;
+    }
+
+    trace_span span ("send_event");
+    span.set_arg("event", event_pos);
+    const auto& event = song.events[event_pos];
+    send_messages(transform.apply(event.keys_down, event.keys_up), send_message);
+  }
+
+  send_messages(transform.release_all(), send_message);
+}
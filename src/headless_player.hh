@@ -0,0 +1,21 @@
+#ifndef HEADLESS_PLAYER_HH
+#define HEADLESS_PLAYER_HH
+
+#include <functional>
+
+#include "bin_file_reader.hh"
+#include "midi_transform.hh"
+
+// Plays the song on the given midi output port without creating any window.
+// Returns once the song is over, or when an exit signal is received.
+// SIGTSTP pauses the song, SIGCONT resumes it. The keys of the song are
+// turned into midi messages by transform.
+void play_headless(bin_song_t song, midi_transform transform, unsigned int output_port);
+
+// same, but hands the midi messages over to send_message. Between two
+// events, and while paused, the calling thread sleeps until either the next
+// event or a signal.
+void play_headless(bin_song_t song, midi_transform transform,
+		   const std::function<void(const uint8_t* bytes, std::size_t size)>& send_message);
+
+#endif /* HEADLESS_PLAYER_HH */
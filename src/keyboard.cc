@@ -1,21 +1,9 @@
 #include <algorithm> // for min
-#include <iostream>
-#include <QGraphicsRectItem>
 
 #include "keyboard.hh"
+#include "trace_events.hh"
 
 
-
-void set_color(struct keys_rects& keyboard, enum note_kind note, const QColor& normal_key_color, const QColor& diese_key_color)
-{
-  if ((static_cast<uint8_t>(note) < static_cast<uint8_t>(note_kind::la_0)) or
-      (static_cast<uint8_t>(note) > static_cast<uint8_t>(note_kind::do_8)))
-  {
-    std::cerr << "Warning key " << static_cast<long unsigned int>(note)
-	      << " is not representable in a 88 key piano" << std::endl;
-    return;
-  }
-
 #define OCTAVE_COLOR(X)		\
   true,  /* do_##X */		\
   false, /* do_diese_##X */	\
@@ -30,40 +18,135 @@ void set_color(struct keys_rects& keyboard, enum note_kind note, const QColor& n
   false, /* la_diese_##X */	\
   true   /* si_##X */
 
-  static constexpr const bool is_normal_keys[static_cast<uint8_t>(note_kind::do_8) - static_cast<uint8_t>(note_kind::la_0) + 1] = {
-    true, // la_0
-    false, // la_diese_0
-    true, //si_0
-    OCTAVE_COLOR(1),
-    OCTAVE_COLOR(2),
-    OCTAVE_COLOR(3),
-    OCTAVE_COLOR(4),
-    OCTAVE_COLOR(5),
-    OCTAVE_COLOR(6),
-    OCTAVE_COLOR(7),
-    true // do_8
-  };
+static constexpr const bool is_normal_keys[static_cast<uint8_t>(note_kind::do_8) - static_cast<uint8_t>(note_kind::la_0) + 1] = {
+  true, // la_0
+  false, // la_diese_0
+  true, //si_0
+  OCTAVE_COLOR(1),
+  OCTAVE_COLOR(2),
+  OCTAVE_COLOR(3),
+  OCTAVE_COLOR(4),
+  OCTAVE_COLOR(5),
+  OCTAVE_COLOR(6),
+  OCTAVE_COLOR(7),
+  true // do_8
+};
 
 #undef OCTAVE_COLOR
 
-  const auto pos = static_cast<uint8_t>(note) - static_cast<uint8_t>(note_kind::la_0);
-  const auto is_normal_key = is_normal_keys[pos];
-  const auto &key_color = is_normal_key ? normal_key_color : diese_key_color;
-  keyboard.keys[pos]->setBrush(key_color);
+static const QColor white_key_colors[] = { Qt::blue, Qt::red,     Qt::green,  Qt::gray };
+static const QColor black_key_colors[] = { Qt::cyan, Qt::magenta, Qt::yellow, Qt::darkYellow };
+
+static constexpr const uint8_t nb_colors = sizeof(white_key_colors) / sizeof(white_key_colors[0]);
+
+static bool is_on_keyboard(enum note_kind note)
+{
+  return (static_cast<uint8_t>(note) >= static_cast<uint8_t>(note_kind::la_0)) and
+    (static_cast<uint8_t>(note) <= static_cast<uint8_t>(note_kind::do_8));
+}
+
+bool is_white_key(enum note_kind note)
+{
+  return is_on_keyboard(note) and is_normal_keys[static_cast<uint8_t>(note) - static_cast<uint8_t>(note_kind::la_0)];
+}
+
+// horizontal position of each key on the keyboard, indexed by note - la_0
+static constexpr const auto keys_x = [] () {
+  // horizontal position of each key relatively to the do of its octave
+  constexpr const qreal pos_in_octave[12] = {
+    qreal{0} * WHITE_KEY_WIDTH, // do
+    qreal{43} / qreal{3},       // do_diese
+    qreal{1} * WHITE_KEY_WIDTH, // re
+    qreal{125} / qreal{3},      // re_diese
+    qreal{2} * WHITE_KEY_WIDTH, // mi
+    qreal{3} * WHITE_KEY_WIDTH, // fa
+    qreal{329} / qreal{4},      // fa_diese
+    qreal{4} * WHITE_KEY_WIDTH, // sol
+    qreal{433} / qreal{4},      // sol_diese
+    qreal{5} * WHITE_KEY_WIDTH, // la
+    qreal{539} / qreal{4},      // la_diese
+    qreal{6} * WHITE_KEY_WIDTH, // si
+  };
+
+  std::array<qreal, NB_KEYS> res {};
+  res[note_kind::la_0 - note_kind::la_0] = qreal{0};
+  res[note_kind::la_diese_0 - note_kind::la_0] = qreal{33} / qreal{2};
+  res[note_kind::si_0 - note_kind::la_0] = WHITE_KEY_WIDTH;
+  for (unsigned int pos_from_do_1 = 0; pos_from_do_1 <= note_kind::do_8 - note_kind::do_1; ++pos_from_do_1)
+  {
+    res[note_kind::do_1 - note_kind::la_0 + pos_from_do_1] =
+      (qreal{2} * WHITE_KEY_WIDTH) + (qreal(pos_from_do_1 / 12) * OCTAVE_WIDTH) + pos_in_octave[pos_from_do_1 % 12];
+  }
+
+  return res;
+}();
+
+QRectF get_key_rect(enum note_kind note)
+{
+  const auto x = keys_x[note - note_kind::la_0];
+  return is_white_key(note) ? QRectF{x, 0, WHITE_KEY_WIDTH, WHITE_KEY_HEIGHT}
+			    : QRectF{x, 0, BLACK_KEY_WIDTH, BLACK_KEY_HEIGHT};
+}
+
+const QColor& get_key_color(enum note_kind note, const uint8_t key_state)
+{
+  static const QColor white = Qt::white;
+  static const QColor black = Qt::black;
+
+  const auto is_white = is_white_key(note);
+  if (key_state == 0)
+  {
+    return is_white ? white : black;
+  }
+
+  const auto color_pos = std::min(static_cast<uint8_t>(key_state - 1), static_cast<uint8_t>(nb_colors - 1));
+  return is_white ? white_key_colors[color_pos] : black_key_colors[color_pos];
 }
 
-void reset_color(struct keys_rects& keyboard, enum note_kind note)
+// half of the width of the keys outline, which is drawn on the border of their rect
+static constexpr const qreal half_pen_width {0.5};
+
+keyboard_item::keyboard_item()
+  : QGraphicsItem()
+  , state()
+{
+  state.fill(0);
+  // needed to get the exposed rect in paint
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+QRectF keyboard_item::boundingRect() const
 {
-  set_color(keyboard, note, Qt::white, Qt::black);
+  return QRectF{0, 0, KEYBOARD_WIDTH, WHITE_KEY_HEIGHT}.adjusted(-half_pen_width, -half_pen_width,
+								 half_pen_width, half_pen_width);
 }
 
-void reset_color(struct keys_rects& keyboard)
+void keyboard_item::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* /* widget */)
+{
+  trace_span span ("paint_keyboard");
+  paint_keyboard(*painter, state, option->exposedRect);
+}
+
+void keyboard_item::set_key_state(const uint8_t pitch, const uint8_t key_state)
+{
+  const auto note = static_cast<enum note_kind>(pitch);
+  if (not is_on_keyboard(note) or (state[pitch - note_kind::la_0] == key_state))
+  {
+    return;
+  }
+
+  state[pitch - note_kind::la_0] = key_state;
+  update(get_key_rect(note).adjusted(-half_pen_width, -half_pen_width,
+				     half_pen_width, half_pen_width));
+}
+
+void keyboard_item::set_state(const keyboard_state& new_state)
 {
   for (auto key = static_cast<uint8_t>(note_kind::la_0);
        key <= static_cast<uint8_t>(note_kind::do_8);
        ++key)
   {
-    reset_color(keyboard, static_cast<note_kind>(key));
+    set_key_state(key, new_state[key - note_kind::la_0]);
   }
 }
 
@@ -77,30 +160,57 @@ void reset_color(struct keys_rects& keyboard)
   #pragma GCC diagnostic ignored "-Wunsafe-loop-optimizations"
 #endif
 
-void update_keyboard(const std::vector<key_down>& keys_down,
-		     const std::vector<key_up>& keys_up,
-		     struct keys_rects& keyboard)
+void paint_keyboard(QPainter& painter, const keyboard_state& keyboard, const QRectF& area)
 {
-  static const QColor white_key_colors[] = { Qt::blue, Qt::red,     Qt::green,  Qt::gray };
-  static const QColor black_key_colors[] = { Qt::cyan, Qt::magenta, Qt::yellow, Qt::darkYellow };
+  painter.setPen(QPen{}); // same as the default one of QGraphicsRectItem
 
-  constexpr const uint8_t nb_colors = sizeof(white_key_colors) / sizeof(white_key_colors[0]);
+  // white keys first, as black keys are drawn on top of them.
+  for (const auto draw_white_keys : { true, false })
+  {
+    for (auto key = static_cast<uint8_t>(note_kind::la_0);
+	 key <= static_cast<uint8_t>(note_kind::do_8);
+	 ++key)
+    {
+      const auto note = static_cast<enum note_kind>(key);
+      // keys outside of the area are not repainted
+      if ((is_white_key(note) == draw_white_keys) and get_key_rect(note).intersects(area))
+      {
+	painter.setBrush(get_key_color(note, keyboard[key - note_kind::la_0]));
+	painter.drawRect(get_key_rect(note));
+      }
+    }
+  }
+}
 
-  /* for each key pressed */
-  for (const auto& key : keys_down)
+void press_key(keyboard_state& keyboard, const uint8_t pitch, const uint8_t staff_num)
+{
+  if (is_on_keyboard(static_cast<enum note_kind>(pitch)))
+  {
+    keyboard[pitch - note_kind::la_0] = static_cast<uint8_t>(std::min(staff_num, uint8_t{254}) + 1);
+  }
+}
+
+void release_key(keyboard_state& keyboard, const uint8_t pitch)
+{
+  if (is_on_keyboard(static_cast<enum note_kind>(pitch)))
   {
-    const auto color_pos = std::min(key.staff_num, static_cast<uint8_t>(nb_colors - 1));
-    const QColor& white_keys_color = white_key_colors[color_pos];
-    const QColor& black_keys_color = black_key_colors[color_pos];
+    keyboard[pitch - note_kind::la_0] = 0;
+  }
+}
 
-    set_color(keyboard, static_cast<enum note_kind>(key.pitch),
-	      white_keys_color, black_keys_color);
+void update_keyboard_state(const std::vector<key_down>& keys_down,
+			   const std::vector<key_up>& keys_up,
+			   keyboard_state& keyboard)
+{
+  // presses first, then releases.
+  for (const auto& key : keys_down)
+  {
+    press_key(keyboard, key.pitch, key.staff_num);
   }
 
-  /* for each key released */
   for (const auto& key : keys_up)
   {
-    reset_color(keyboard, static_cast<enum note_kind>(key.pitch));
+    release_key(keyboard, key.pitch);
   }
 }
 
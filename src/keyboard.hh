@@ -1,9 +1,11 @@
 #ifndef KEYBOARD_HH
 #define KEYBOARD_HH
 
+#include <array>
 #include <QColor>
-#include <QGraphicsScene>
-#include <QGraphicsRectItem>
+#include <QPainter>
+#include <QGraphicsItem>
+#include <QStyleOptionGraphicsItem>
 
 #include "utils.hh"
 
@@ -15,99 +17,48 @@ static constexpr qreal BLACK_KEY_WIDTH  {13.0};
 
 static constexpr qreal OCTAVE_WIDTH { qreal{7} * WHITE_KEY_WIDTH };
 
-struct keys_rects
-{
+static constexpr uint8_t NB_KEYS { note_kind::do_8 - note_kind::la_0 + 1 };
+static constexpr qreal KEYBOARD_WIDTH { qreal{52} * WHITE_KEY_WIDTH };
 
-#define OCTAVE(num_octave)			       \
-    do {                                               \
-  keys[note_kind::do_##num_octave - note_kind::la_0] = \
-    scene.addRect(x + (qreal{2} * WHITE_KEY_WIDTH) + (qreal{num_octave - 1} * OCTAVE_WIDTH),                                y, WHITE_KEY_WIDTH, WHITE_KEY_HEIGHT); \
-  keys[note_kind::do_##num_octave - note_kind::la_0]->setBrush(Qt::white); \
-  \
-  keys[note_kind::re_##num_octave - note_kind::la_0] = \
-    scene.addRect(x + (qreal{2} * WHITE_KEY_WIDTH) + (qreal{num_octave - 1} * OCTAVE_WIDTH) +             WHITE_KEY_WIDTH,  y, WHITE_KEY_WIDTH, WHITE_KEY_HEIGHT); \
-  keys[note_kind::re_##num_octave - note_kind::la_0]->setBrush(Qt::white); \
-  \
-  keys[note_kind::mi_##num_octave - note_kind::la_0] = \
-    scene.addRect(x + (qreal{2} * WHITE_KEY_WIDTH) + (qreal{num_octave - 1} * OCTAVE_WIDTH) + (qreal{2} * WHITE_KEY_WIDTH), y, WHITE_KEY_WIDTH, WHITE_KEY_HEIGHT); \
-  keys[note_kind::mi_##num_octave - note_kind::la_0]->setBrush(Qt::white); \
-  \
-  keys[note_kind::fa_##num_octave - note_kind::la_0] = \
-    scene.addRect(x + (qreal{2} * WHITE_KEY_WIDTH) + (qreal{num_octave - 1} * OCTAVE_WIDTH) + (qreal{3} * WHITE_KEY_WIDTH), y, WHITE_KEY_WIDTH, WHITE_KEY_HEIGHT); \
-  keys[note_kind::fa_##num_octave - note_kind::la_0]->setBrush(Qt::white); \
-  \
-  keys[note_kind::sol_##num_octave - note_kind::la_0] = \
-    scene.addRect(x + (qreal{2} * WHITE_KEY_WIDTH) + (qreal{num_octave - 1} * OCTAVE_WIDTH) + (qreal{4} * WHITE_KEY_WIDTH), y, WHITE_KEY_WIDTH, WHITE_KEY_HEIGHT); \
-  keys[note_kind::sol_##num_octave - note_kind::la_0]->setBrush(Qt::white); \
-  \
-  keys[note_kind::la_##num_octave - note_kind::la_0] = \
-    scene.addRect(x + (qreal{2} * WHITE_KEY_WIDTH) + (qreal{num_octave - 1} * OCTAVE_WIDTH) + (qreal{5} * WHITE_KEY_WIDTH), y, WHITE_KEY_WIDTH, WHITE_KEY_HEIGHT); \
-  keys[note_kind::la_##num_octave - note_kind::la_0]->setBrush(Qt::white); \
-  \
-  keys[note_kind::si_##num_octave - note_kind::la_0] = \
-    scene.addRect(x + (qreal{2} * WHITE_KEY_WIDTH) + (qreal{num_octave - 1} * OCTAVE_WIDTH) + (qreal{6} * WHITE_KEY_WIDTH), y, WHITE_KEY_WIDTH, WHITE_KEY_HEIGHT); \
-  keys[note_kind::si_##num_octave - note_kind::la_0]->setBrush(Qt::white); \
-  \
-  keys[note_kind::do_diese_##num_octave - note_kind::la_0] = \
-    scene.addRect(x + (qreal{2} * WHITE_KEY_WIDTH) + (qreal{num_octave - 1} * OCTAVE_WIDTH) + (qreal{43} / qreal{3}), y, BLACK_KEY_WIDTH, BLACK_KEY_HEIGHT); \
-  keys[note_kind::do_diese_##num_octave - note_kind::la_0]->setBrush(Qt::black); \
-  \
-  keys[note_kind::re_diese_##num_octave - note_kind::la_0] = \
-    scene.addRect(x + (qreal{2} * WHITE_KEY_WIDTH) + (qreal{num_octave - 1} * OCTAVE_WIDTH) + (qreal{125} / qreal{3}), y, BLACK_KEY_WIDTH, BLACK_KEY_HEIGHT); \
-  keys[note_kind::re_diese_##num_octave - note_kind::la_0]->setBrush(Qt::black); \
-  \
-  keys[note_kind::fa_diese_##num_octave - note_kind::la_0] = \
-    scene.addRect(x + (qreal{2} * WHITE_KEY_WIDTH) + (qreal{num_octave - 1} * OCTAVE_WIDTH) + (qreal{329} / qreal{4}), y, BLACK_KEY_WIDTH, BLACK_KEY_HEIGHT); \
-  keys[note_kind::fa_diese_##num_octave - note_kind::la_0]->setBrush(Qt::black); \
-  \
-  keys[note_kind::sol_diese_##num_octave - note_kind::la_0] = \
-    scene.addRect(x + (qreal{2} * WHITE_KEY_WIDTH) + (qreal{num_octave - 1} * OCTAVE_WIDTH) + (qreal{433} / qreal{4}), y, BLACK_KEY_WIDTH, BLACK_KEY_HEIGHT); \
-  keys[note_kind::sol_diese_##num_octave - note_kind::la_0]->setBrush(Qt::black); \
-  \
-  keys[note_kind::la_diese_##num_octave - note_kind::la_0] = \
-    scene.addRect(x + (qreal{2} * WHITE_KEY_WIDTH) + (qreal{num_octave - 1} * OCTAVE_WIDTH) + (qreal{539} / qreal{4}), y, BLACK_KEY_WIDTH, BLACK_KEY_HEIGHT); \
-  keys[note_kind::la_diese_##num_octave - note_kind::la_0]->setBrush(Qt::black); \
-  } while (0)
-
-    keys_rects(QGraphicsScene& scene, const qreal x = 0, const qreal y = 0)
-    {
-      keys[note_kind::la_0 - note_kind::la_0] =
-	scene.addRect(x, y, WHITE_KEY_WIDTH, WHITE_KEY_HEIGHT);
-      keys[note_kind::la_0 - note_kind::la_0]->setBrush(Qt::white);
-
-      keys[note_kind::si_0 - note_kind::la_0] =
-	scene.addRect(x + WHITE_KEY_WIDTH, y, WHITE_KEY_WIDTH, WHITE_KEY_HEIGHT);
-      keys[note_kind::si_0 - note_kind::la_0]->setBrush(Qt::white);
-
-      keys[note_kind::la_diese_0 - note_kind::la_0] =
-	scene.addRect(x + (qreal{33} / qreal{2}), y, BLACK_KEY_WIDTH, BLACK_KEY_HEIGHT);
-      keys[note_kind::la_diese_0 - note_kind::la_0]->setBrush(Qt::black);
-
-      OCTAVE(1);
-      OCTAVE(2);
-      OCTAVE(3);
-      OCTAVE(4);
-      OCTAVE(5);
-      OCTAVE(6);
-      OCTAVE(7);
-
-      keys[note_kind::do_8 - note_kind::la_0] =
-	scene.addRect(x + (qreal{2} * WHITE_KEY_WIDTH) + (qreal{7} * OCTAVE_WIDTH), y, WHITE_KEY_WIDTH, WHITE_KEY_HEIGHT); \
-      keys[note_kind::do_8 - note_kind::la_0]->setBrush(Qt::white);
-    }
-
-#undef OCTAVE
-
-    QGraphicsRectItem* keys[note_kind::do_8 - note_kind::la_0 + 1];
-};
+// State of each key of the keyboard, indexed by note - la_0: 0 means the key
+// is released, otherwise the key is pressed and the value is staff number + 1.
+using keyboard_state = std::array<uint8_t, NB_KEYS>;
+
+void update_keyboard_state(const std::vector<key_down>& keys_down,
+			   const std::vector<key_up>& keys_up,
+			   keyboard_state& keyboard);
+void press_key(keyboard_state& keyboard, uint8_t pitch, uint8_t staff_num);
+void release_key(keyboard_state& keyboard, uint8_t pitch);
+
+bool is_white_key(enum note_kind note) __attribute__((const));
+
+// position of the key on a keyboard drawn at (0, 0).
+QRectF get_key_rect(enum note_kind note) __attribute__((const));
 
+// colour of the key when released or pressed by the given staff.
+const QColor& get_key_color(enum note_kind note, uint8_t key_state) __attribute__((pure));
 
+// paints the keys intersecting area, as displayed on screen, for a keyboard at (0, 0)
+void paint_keyboard(QPainter& painter, const keyboard_state& keyboard,
+		    const QRectF& area = QRectF{0, 0, KEYBOARD_WIDTH, WHITE_KEY_HEIGHT});
 
-void reset_color(struct keys_rects& keyboard, enum note_kind note);
-void reset_color(struct keys_rects& keyboard); // reset all keys
-void set_color(struct keys_rects& keyboard, enum note_kind note, const QColor& normal_key_color, const QColor& diese_key_color);
-void update_keyboard(const std::vector<key_down>& keys_down,
-		     const std::vector<key_up>& keys_up,
-		     struct keys_rects& keyboard);
+// The whole keyboard as a single graphics item, painted from its keyboard_state.
+// Changing the state of a key only schedules the repaint of this key.
+class keyboard_item final : public QGraphicsItem
+{
+  public:
+    keyboard_item();
+
+    QRectF boundingRect() const override __attribute__((const));
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+    // key_state: 0 for released, staff number + 1 for pressed.
+    void set_key_state(uint8_t pitch, uint8_t key_state);
+    void set_state(const keyboard_state& new_state);
+    const keyboard_state& get_state() const { return state; }
+
+  private:
+    keyboard_state state;
+};
 
 #endif
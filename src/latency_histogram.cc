@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <cmath>
+
+#include "latency_histogram.hh"
+
+constexpr const std::chrono::nanoseconds latency_histogram::BUCKET_WIDTH;
+
+latency_histogram::latency_histogram()
+  : buckets()
+  , nb_samples(0)
+  , max_latency(0)
+{
+}
+
+void latency_histogram::add(const std::chrono::nanoseconds latency)
+{
+  const auto bucket = static_cast<std::size_t>(std::max(latency.count(), int64_t{0}) / BUCKET_WIDTH.count());
+  ++buckets[std::min(bucket, NB_BUCKETS)];
+  ++nb_samples;
+  max_latency = std::max(max_latency, latency);
+}
+
+void latency_histogram::clear()
+{
+  buckets.fill(0);
+  nb_samples = 0;
+  max_latency = std::chrono::nanoseconds{0};
+}
+
+std::chrono::nanoseconds latency_histogram::get_percentile(const double percentile) const
+{
+  if (nb_samples == 0)
+  {
+    return std::chrono::nanoseconds{0};
+  }
+
+  // number of samples at or below the percentile, at least one.
+  const auto rank = std::max(uint64_t{1}, static_cast<uint64_t>(std::ceil(percentile * static_cast<double>(nb_samples) / 100.0)));
+  uint64_t nb_seen = 0;
+  for (auto i = decltype(NB_BUCKETS){0}; i < NB_BUCKETS; ++i)
+  {
+    nb_seen += buckets[i];
+    if (nb_seen >= rank)
+    {
+      return std::min(BUCKET_WIDTH * static_cast<int64_t>(i + 1), max_latency);
+    }
+  }
+
+  return max_latency;
+}
+
+void print_latencies(const latency_histogram& latencies, std::ostream& out)
+{
+  const auto to_us = [] (const std::chrono::nanoseconds latency) {
+    return std::chrono::duration<double, std::micro>(latency).count();
+  };
+
+  out << latencies.size() << " samples, "
+      << "p50 " << to_us(latencies.get_percentile(50)) << " us, "
+      << "p90 " << to_us(latencies.get_percentile(90)) << " us, "
+      << "p99 " << to_us(latencies.get_percentile(99)) << " us, "
+      << "max " << to_us(latencies.get_max()) << " us";
+}
@@ -0,0 +1,39 @@
+#ifndef LATENCY_HISTOGRAM_HH
+#define LATENCY_HISTOGRAM_HH
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Distribution of latencies, in buckets of 10 us up to 20 ms. Adding a sample
+// takes constant time and no memory, so that it can be done while playing.
+class latency_histogram
+{
+  public:
+    latency_histogram();
+
+    void add(std::chrono::nanoseconds latency);
+    void clear();
+
+    uint64_t size() const { return nb_samples; }
+    std::chrono::nanoseconds get_max() const { return max_latency; }
+
+    // upper bound of the bucket holding the percentile (in [0, 100]). Zero if
+    // there is no sample. Latencies above 20 ms are reported as the max one.
+    std::chrono::nanoseconds get_percentile(double percentile) const __attribute__((pure));
+
+  private:
+    static constexpr const std::chrono::nanoseconds BUCKET_WIDTH = std::chrono::microseconds{10};
+    static constexpr const std::size_t NB_BUCKETS = 2000;
+
+    std::array<uint64_t, NB_BUCKETS + 1> buckets; // the last one for everything above
+    uint64_t nb_samples;
+    std::chrono::nanoseconds max_latency;
+};
+
+// prints "<nb> samples, p50 <x> us, p90 <y> us, p99 <z> us, max <w> us"
+void print_latencies(const latency_histogram& latencies, std::ostream& out);
+
+#endif /* LATENCY_HISTOGRAM_HH */
@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "log.hh"
+#include "mpsc_ring_buffer.hh"
+
+constexpr const std::size_t log_line::MAX_SIZE;
+
+// a line of the queue
+struct log_entry
+{
+    uint64_t nb_suppressed; // messages of the site left out before this one
+    uint16_t size;
+    bool is_truncated;
+    char text[log_line::MAX_SIZE];
+};
+
+struct log_state
+{
+    log_state()
+      : queue(QUEUE_CAPACITY)
+      , mutex()
+      , wake_up()
+      , writer()
+      , is_started()
+      , is_writer_sleeping(false)
+      , is_stopping(false)
+      , is_stopped(false)
+      , nb_dropped(0)
+    {
+    }
+
+    log_state(const log_state&) = delete;
+    log_state& operator=(const log_state&) = delete;
+
+    // a burst of messages from every thread at once
+    static constexpr const std::size_t QUEUE_CAPACITY = 512;
+
+    mpsc_ring_buffer<log_entry> queue;
+    std::mutex mutex; // only for the writer to sleep on
+    std::condition_variable wake_up;
+    std::thread writer;
+    std::once_flag is_started;
+    std::atomic<bool> is_writer_sleeping; // the producers only notify it then
+    std::atomic<bool> is_stopping;
+    std::atomic<bool> is_stopped; // at exit, messages are then written directly
+    std::atomic<uint64_t> nb_dropped;
+};
+
+constexpr const std::size_t log_state::QUEUE_CAPACITY;
+
+static std::atomic<log_level> min_level { log_level::info };
+
+static log_state& get_log_state()
+{
+  // never destroyed: the messages logged by the atexit handlers and the
+  // destructors of the other statics must still find it.
+  static auto& state = *new log_state;
+  return state;
+}
+
+static int64_t get_time_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void set_log_level(const log_level level)
+{
+  min_level.store(level, std::memory_order_relaxed);
+}
+
+log_level get_log_level()
+{
+  return min_level.load(std::memory_order_relaxed);
+}
+
+log_level get_log_level_by_name(const std::string& name)
+{
+  if (name == "debug")
+  {
+    return log_level::debug;
+  }
+  if (name == "info")
+  {
+    return log_level::info;
+  }
+  if (name == "warning")
+  {
+    return log_level::warning;
+  }
+  if (name == "error")
+  {
+    return log_level::error;
+  }
+
+  throw std::invalid_argument("Error: unknown log level " + name);
+}
+
+static void append_entry(std::string& out, const log_entry& entry)
+{
+  out.append(entry.text, entry.size);
+  if (entry.is_truncated)
+  {
+    out += "...";
+  }
+
+  if (entry.nb_suppressed != 0)
+  {
+    out += " (" + std::to_string(entry.nb_suppressed) + " similar messages were left out)";
+  }
+
+  out += "\n";
+}
+
+// writer side. Returns false if there was nothing to write.
+static bool write_queued_entries(log_state& state, std::string& batch)
+{
+  batch.clear();
+  state.queue.consume_all([&] (const log_entry& entry) {
+      append_entry(batch, entry);
+    });
+
+  const auto nb_dropped = state.nb_dropped.exchange(0, std::memory_order_relaxed);
+  if (nb_dropped != 0)
+  {
+    batch += "Warning: " + std::to_string(nb_dropped) + " log messages were dropped, too many were logged at once\n";
+  }
+
+  if (batch.empty())
+  {
+    return false;
+  }
+
+  // a single write for all the messages of the batch
+  std::cerr.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+  std::cerr.flush();
+  return true;
+}
+
+static void run_writer()
+{
+  auto& state = get_log_state();
+  std::string batch;
+  for (;;)
+  {
+    // read before writing, so that no message queued before stopping is lost
+    const auto is_stopping = state.is_stopping.load(std::memory_order_acquire);
+    if (write_queued_entries(state, batch))
+    {
+      continue;
+    }
+
+    if (is_stopping)
+    {
+      return;
+    }
+
+    // the flag is set before checking the queue, and a producer checks the
+    // flag after pushing: either the writer sees the message, or the
+    // producer sees the flag and notifies under the lock, once the writer
+    // is waiting. No wake up is lost, the writer can sleep until one comes.
+    std::unique_lock<std::mutex> lock (state.mutex);
+    state.is_writer_sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    state.wake_up.wait(lock, [&] () {
+	return state.is_stopping.load(std::memory_order_acquire) or (not state.queue.empty());
+      });
+    state.is_writer_sleeping.store(false, std::memory_order_relaxed);
+  }
+}
+
+// called at exit, once the writer has been started
+static void stop_writer()
+{
+  auto& state = get_log_state();
+  {
+    std::lock_guard<std::mutex> lock (state.mutex);
+    state.is_stopping.store(true, std::memory_order_release);
+  }
+  state.wake_up.notify_one();
+  if (state.writer.joinable())
+  {
+    state.writer.join();
+  }
+
+  // a message queued while the writer was exiting is written here
+  state.is_stopped.store(true, std::memory_order_release);
+  std::string batch;
+  write_queued_entries(state, batch);
+}
+
+static void start_writer()
+{
+  auto& state = get_log_state();
+
+  if (std::atexit(stop_writer) != 0)
+  {
+    state.is_stopped.store(true, std::memory_order_release);
+    return;
+  }
+
+  try
+  {
+    state.writer = std::thread(run_writer);
+  }
+  catch (std::exception&)
+  {
+    state.is_stopped.store(true, std::memory_order_release);
+  }
+}
+
+static void queue_entry(const log_entry& entry)
+{
+  auto& state = get_log_state();
+  std::call_once(state.is_started, start_writer);
+
+  if (state.is_stopped.load(std::memory_order_acquire))
+  {
+    // no writer anymore, there is no playback to stall either
+    std::string text;
+    append_entry(text, entry);
+    std::cerr << text;
+    return;
+  }
+
+  if (not state.queue.push(entry))
+  {
+    state.nb_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  // no lock nor system call while the writer is awake (see run_writer)
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (state.is_writer_sleeping.load(std::memory_order_relaxed))
+  {
+    std::lock_guard<std::mutex> lock (state.mutex);
+    state.wake_up.notify_one();
+  }
+}
+
+log_site::log_site(const log_level site_level, const unsigned int max_messages_per_second)
+  : level(site_level)
+  , max_per_second(max_messages_per_second)
+  , window_start(0)
+  , nb_in_window(0)
+  , nb_suppressed(0)
+{
+}
+
+bool log_site::try_acquire()
+{
+  // fixed windows of one second. Two threads starting a new window at the
+  // same time may let a few more messages through, which doesn't matter.
+  const auto now = get_time_ns();
+  auto start = window_start.load(std::memory_order_relaxed);
+  if ((now - start >= 1000000000) and window_start.compare_exchange_strong(start, now, std::memory_order_relaxed))
+  {
+    nb_in_window.store(0, std::memory_order_relaxed);
+  }
+
+  if (nb_in_window.fetch_add(1, std::memory_order_relaxed) < max_per_second)
+  {
+    return true;
+  }
+
+  nb_suppressed.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+static bool is_logged(log_site& site)
+{
+  return (site.level >= get_log_level()) and site.try_acquire();
+}
+
+log_line::fixed_buffer::fixed_buffer()
+  : std::streambuf()
+  , text()
+  , truncated(false)
+{
+  setp(text, text + MAX_SIZE);
+}
+
+log_line::fixed_buffer::int_type log_line::fixed_buffer::overflow(const int_type c __attribute__((unused)))
+{
+  // the stream stops formatting once this fails
+  truncated = true;
+  return traits_type::eof();
+}
+
+log_line::log_line(log_site& message_site)
+  : site(message_site)
+  , is_written(is_logged(message_site))
+  , buffer()
+  , stream()
+{
+  if (is_written)
+  {
+    buffer.emplace();
+    stream.emplace(&*buffer);
+  }
+}
+
+log_line::~log_line()
+{
+  if (not is_written)
+  {
+    return;
+  }
+
+  log_entry entry;
+  entry.nb_suppressed = site.take_nb_suppressed();
+  entry.size = static_cast<uint16_t>(buffer->size());
+  entry.is_truncated = buffer->is_truncated();
+  std::memcpy(entry.text, buffer->data(), buffer->size());
+  queue_entry(entry);
+}
+
+void log_text(log_site& site, const std::string& text)
+{
+  if (not is_logged(site))
+  {
+    return;
+  }
+
+  // one entry per line, the lines left out are counted with the last one
+  std::size_t begin = 0;
+  while (begin < text.size())
+  {
+    const auto end = std::min(text.find('\n', begin), text.size());
+    const auto size = std::min(end - begin, log_line::MAX_SIZE);
+    const auto is_last = (end + 1 >= text.size());
+
+    log_entry entry;
+    entry.nb_suppressed = is_last ? site.take_nb_suppressed() : 0;
+    entry.size = static_cast<uint16_t>(size);
+    entry.is_truncated = (size != end - begin);
+    std::memcpy(entry.text, text.data() + begin, size);
+    queue_entry(entry);
+
+    begin = end + 1;
+  }
+}
@@ -0,0 +1,123 @@
+#ifndef LOG_HH
+#define LOG_HH
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+// Messages for the user, written on stderr by a writer thread so that the
+// threads logging never wait on the terminal. A message is formatted on the
+// logging thread in a fixed size buffer, and queued in a lock-free queue:
+// logging never blocks nor allocates. If the queue is full, the message is
+// dropped and counted. The messages still queued are written at exit.
+//
+//   static log_site invalid_port_log (log_level::warning);
+//   log_line(invalid_port_log) << "Warning: invalid port " << port;
+
+enum class log_level : uint8_t
+{
+  debug,
+  info,
+  warning,
+  error,
+};
+
+// the messages below level are discarded when logged. info by default.
+void set_log_level(log_level level);
+log_level get_log_level();
+
+// throws an exception if name isn't one of debug, info, warning or error
+log_level get_log_level_by_name(const std::string& name);
+
+// A place in the code writing messages, usually a static variable next to
+// it. At most max_per_second messages of a site are written each second: a
+// flapping device or a broken file can't flood the terminal nor the queue.
+// The number of messages left out is written with the next one of the site.
+class log_site
+{
+  public:
+    explicit log_site(log_level level, unsigned int max_per_second = 5);
+
+    log_site(const log_site&) = delete;
+    log_site& operator=(const log_site&) = delete;
+
+    // whether a message can be written now, counts it if not. Lock-free.
+    bool try_acquire();
+
+    // the number of messages left out since the last call
+    uint64_t take_nb_suppressed()
+    {
+      return nb_suppressed.exchange(0, std::memory_order_relaxed);
+    }
+
+    const log_level level;
+
+  private:
+    const unsigned int max_per_second;
+    std::atomic<int64_t> window_start; // steady clock time in ns
+    std::atomic<unsigned int> nb_in_window;
+    std::atomic<uint64_t> nb_suppressed;
+};
+
+// Formats one message, queued when destroyed. Nothing is formatted, nor set
+// up, if the level or the rate of the site leaves the message out. Messages longer
+// than a line of the queue are truncated.
+class log_line
+{
+  public:
+    explicit log_line(log_site& site);
+    ~log_line();
+
+    log_line(const log_line&) = delete;
+    log_line& operator=(const log_line&) = delete;
+
+    template <typename T>
+    log_line& operator<<(const T& value)
+    {
+      if (is_written)
+      {
+	*stream << value;
+      }
+      return *this;
+    }
+
+    static constexpr const std::size_t MAX_SIZE = 500;
+
+  private:
+    // writes in a fixed size array rather than in an allocated string
+    class fixed_buffer : public std::streambuf
+    {
+      public:
+	fixed_buffer();
+
+	fixed_buffer(const fixed_buffer&) = delete;
+	fixed_buffer& operator=(const fixed_buffer&) = delete;
+
+	const char* data() const { return text; }
+	std::size_t size() const { return static_cast<std::size_t>(pptr() - pbase()); }
+	bool is_truncated() const { return truncated; }
+
+      protected:
+	int_type overflow(int_type c) override;
+
+      private:
+	char text[MAX_SIZE];
+	bool truncated;
+    };
+
+    log_site& site;
+    const bool is_written;
+
+    // only constructed if the message is written, a stream is costly to set up
+    std::optional<fixed_buffer> buffer;
+    std::optional<std::ostream> stream;
+};
+
+// logs text, which can hold several lines, as a single message of site.
+// Meant for reports written in an std::ostream, off the hot paths.
+void log_text(log_site& site, const std::string& text);
+
+#endif /* LOG_HH */
@@ -1,7 +1,21 @@
+#include <iostream>
 #include <ostream>
+#include <sstream>
+#include <vector>
 #include <QApplication>
 #include "signals_handler.hh"
 #include "mainwindow.hh"
+#include "headless_player.hh"
+#include "midi_file_writer.hh"
+#include "video_frames_renderer.hh"
+#include "midi_port_registry.hh"
+#include "trace_events.hh"
+#include "memory_footprint.hh"
+#include "midi_transform.hh"
+#include "log.hh"
+
+// the errors ending the program
+static log_site fatal_error_log (log_level::error);
 
 static const char* const stylesheet =
   #include "../qdarkstyle/style.qss"
@@ -9,13 +23,46 @@ static const char* const stylesheet =
 
 static void usage(const char* const prog_name, std::ostream& out_stream = std::cerr)
 {
-  out_stream << "Usage: " << prog_name << " [Options] [file]\n"
+  out_stream << "Usage: " << prog_name << " [Options] [file...]\n"
     "\n"
     "Options:\n"
     "  -h, --help			print this help\n"
     "  -l, --list			list the midi output ports available for use\n"
     "  -o, --output-port <NUM>	the output midi port to use\n"
-    "  -i, --input-port <NUM>	the input midi to use if no file is provided\n";
+    "  -i, --input-port <NUM>	the input midi to use if no file is provided\n"
+    "      --headless		play the file on the output port without any window\n"
+    "      --no-music-sheet		in headless mode, don't read the music sheet pages\n"
+    "      --export-midi <PATH>	convert the file, or all the .bin files in the directory\n"
+    "				PATH, into standard midi files written next to them\n"
+    "      --render-frames <DIR>	render the video of the file being played as PNG\n"
+    "				images in DIR\n"
+    "      --fps <NUM>		number of frames per second to render (default 30)\n"
+    "      --sheet-memory <MIB>	memory budget of each of the parsed and the rasterised\n"
+    "				music sheet pages caches (default 64)\n"
+    "      --library <DIR>		index the songs of DIR and show them\n"
+    "      --record <FILE>		record the keys played on the input into FILE, as a\n"
+    "				standard midi file if it ends by .mid\n"
+    "      --memory-budget <MIB>	memory a song may take once loaded. Bigger songs are\n"
+    "				played without their music sheet, or refused\n"
+    "      --memory-report <FILE>	print the memory taken by FILE once loaded\n"
+    "      --trace <FILE>		write the loading, playing and rendering steps in FILE\n"
+    "				as Chrome trace events when exiting\n"
+    "      --trace-events <NUM>	events kept for the gui thread and the other main\n"
+    "				threads, at 40 bytes each (default 262144, about\n"
+    "				20 minutes of playing)\n"
+    "      --transpose <NUM>		transpose the notes played by NUM semitones\n"
+    "      --velocity <PERCENT>	scale the velocity of the notes played (default 100)\n"
+    "      --velocity-curve <CURVE>	linear, soft (quiet notes louder) or hard (quiet\n"
+    "				notes quieter)\n"
+    "      --channel <NUM>		midi channel of the notes played, from 1 to 16\n"
+    "      --octave-doubling <DIR>	double each note an octave up or down\n"
+    "      --mute <STAFF>		don't play the notes of STAFF, counting from 1\n"
+    "      --solo <STAFF>		only play the notes of the solo staffs\n"
+    "      --log-level <LEVEL>	only print the messages of LEVEL and above: debug,\n"
+    "				info (default), warning or error\n"
+    "\n"
+    "The files are lilyplayer files or standard midi files. The files after the first\n"
+    "one are played one after the other once it is over.\n";
 }
 
 struct options
@@ -27,8 +74,23 @@ struct options
     bool was_output_port_set;
     unsigned int input_port;
     bool was_input_port_set;
+    bool headless;
+    bool skip_music_sheet;
+    bool export_midi;
+    std::string frames_dir;
+    unsigned int fps;
+    std::size_t sheet_memory_budget;
+    std::string library_dir;
+    std::string record_filename;
+    std::string trace_filename;
+    std::size_t trace_events;
+    std::size_t song_memory_budget;
+    bool memory_report;
+    midi_transform transform; // used by the window and the headless player
+    log_level min_log_level;
 
     std::string filename;
+    std::vector<std::string> playlist; // files to play after filename
 
     options()
       : has_error (false)
@@ -38,11 +100,54 @@ struct options
       , was_output_port_set(false)
       , input_port (0)
       , was_input_port_set (false)
+      , headless (false)
+      , skip_music_sheet (false)
+      , export_midi (false)
+      , frames_dir ("")
+      , fps (30)
+      , sheet_memory_budget (page_store::DEFAULT_MEMORY_BUDGET)
+      , library_dir ("")
+      , record_filename ("")
+      , trace_filename ("")
+      , trace_events (DEFAULT_TRACE_EVENTS)
+      , song_memory_budget (NO_MEMORY_BUDGET)
+      , memory_report (false)
+      , transform ()
+      , min_log_level (log_level::info)
       , filename ("")
+      , playlist ()
     {
     }
 };
 
+// returns 0 if the argument isn't a positive number of MiB
+static std::size_t get_mib(const char* const arg)
+{
+  try
+  {
+    const auto nb_mib = std::stoi(arg);
+    return (nb_mib <= 0) ? 0 : static_cast<std::size_t>(nb_mib) * 1024 * 1024;
+  }
+  catch (std::exception&)
+  {
+    return 0;
+  }
+}
+
+// returns false if the argument isn't a number in [min, max]
+static bool get_int(const char* const arg, const int min, const int max, int& value)
+{
+  try
+  {
+    value = std::stoi(arg);
+    return (value >= min) and (value <= max);
+  }
+  catch (std::exception&)
+  {
+    return false;
+  }
+}
+
 static
 struct options get_opts(const int argc, const char * const * const argv)
 {
@@ -95,10 +200,279 @@ struct options get_opts(const int argc, const char * const * const argv)
       continue;
     }
 
+    if (arg == "--headless")
+    {
+      res.headless = true;
+      continue;
+    }
+
+    if (arg == "--no-music-sheet")
+    {
+      res.skip_music_sheet = true;
+      continue;
+    }
+
+    if (arg == "--export-midi")
+    {
+      if ((i == argc - 1) or (res.filename != ""))
+      {
+	res.has_error = true;
+	return res;
+      }
+      else
+      {
+	++i;
+	res.filename = argv[i];
+	res.export_midi = true;
+      }
+      continue;
+    }
+
+    if (arg == "--render-frames")
+    {
+      if (i == argc - 1)
+      {
+	res.has_error = true;
+	return res;
+      }
+      else
+      {
+	++i;
+	res.frames_dir = argv[i];
+      }
+      continue;
+    }
+
+    if (arg == "--fps")
+    {
+      if (i == argc - 1)
+      {
+	res.has_error = true;
+	return res;
+      }
+      else
+      {
+	++i;
+	try
+	{
+	  const auto fps = std::stoi(argv[i]);
+	  if (fps <= 0)
+	  {
+	    res.has_error = true;
+	    return res;
+	  }
+	  res.fps = static_cast<unsigned int>(fps);
+	}
+	catch (std::exception&)
+	{
+	  res.has_error = true;
+	  return res;
+	}
+      }
+      continue;
+    }
+
+    if (arg == "--sheet-memory")
+    {
+      if (i == argc - 1)
+      {
+	res.has_error = true;
+	return res;
+      }
+      else
+      {
+	++i;
+	res.sheet_memory_budget = get_mib(argv[i]);
+	if (res.sheet_memory_budget == 0)
+	{
+	  res.has_error = true;
+	  return res;
+	}
+      }
+      continue;
+    }
+
+    if (arg == "--memory-budget")
+    {
+      if (i == argc - 1)
+      {
+	res.has_error = true;
+	return res;
+      }
+      else
+      {
+	++i;
+	res.song_memory_budget = get_mib(argv[i]);
+	if (res.song_memory_budget == 0)
+	{
+	  res.has_error = true;
+	  return res;
+	}
+      }
+      continue;
+    }
+
+    if (arg == "--memory-report")
+    {
+      if ((i == argc - 1) or (res.filename != ""))
+      {
+	res.has_error = true;
+	return res;
+      }
+      else
+      {
+	++i;
+	res.filename = argv[i];
+	res.memory_report = true;
+      }
+      continue;
+    }
+
+    if (arg == "--library")
+    {
+      if (i == argc - 1)
+      {
+	res.has_error = true;
+	return res;
+      }
+      else
+      {
+	++i;
+	res.library_dir = argv[i];
+      }
+      continue;
+    }
+
+    if (arg == "--record")
+    {
+      if (i == argc - 1)
+      {
+	res.has_error = true;
+	return res;
+      }
+      else
+      {
+	++i;
+	res.record_filename = argv[i];
+      }
+      continue;
+    }
+
+    if (arg == "--trace")
+    {
+      if (i == argc - 1)
+      {
+	res.has_error = true;
+	return res;
+      }
+      else
+      {
+	++i;
+	res.trace_filename = argv[i];
+      }
+      continue;
+    }
+
+    if (arg == "--trace-events")
+    {
+      int value = 0;
+      if ((i == argc - 1) or (not get_int(argv[i + 1], 1, 1 << 26, value)))
+      {
+	res.has_error = true;
+	return res;
+      }
+
+      ++i;
+      res.trace_events = static_cast<std::size_t>(value);
+      continue;
+    }
+
+    if ((arg == "--transpose") or (arg == "--velocity") or (arg == "--channel") or
+	(arg == "--mute") or (arg == "--solo"))
+    {
+      int value = 0;
+      const auto min = (arg == "--transpose") ? -127 : (arg == "--velocity") ? 0 : 1;
+      const auto max = (arg == "--transpose") ? 127 : (arg == "--velocity") ? 400 : (arg == "--channel") ? 16 : 255;
+      if ((i == argc - 1) or (not get_int(argv[i + 1], min, max, value)))
+      {
+	res.has_error = true;
+	return res;
+      }
+
+      ++i;
+      if (arg == "--transpose")
+      {
+	res.transform.set_transposition(value);
+      }
+      else if (arg == "--velocity")
+      {
+	res.transform.set_velocity(value / 100.0, res.transform.get_velocity_curve());
+      }
+      else if (arg == "--channel")
+      {
+	res.transform.set_channel(static_cast<uint8_t>(value - 1));
+      }
+      else if (arg == "--mute")
+      {
+	res.transform.set_muted(static_cast<uint8_t>(value - 1), true);
+      }
+      else
+      {
+	res.transform.set_solo(static_cast<uint8_t>(value - 1), true);
+      }
+      continue;
+    }
+
+    if (arg == "--log-level")
+    {
+      try
+      {
+	res.min_log_level = get_log_level_by_name((i == argc - 1) ? "" : argv[i + 1]);
+      }
+      catch (std::invalid_argument&)
+      {
+	res.has_error = true;
+	return res;
+      }
+
+      ++i;
+      continue;
+    }
+
+    if (arg == "--velocity-curve")
+    {
+      const std::string curve_name = (i == argc - 1) ? "" : argv[i + 1];
+      const auto curve = (curve_name == "soft") ? velocity_curve::soft :
+			 (curve_name == "hard") ? velocity_curve::hard :
+			 velocity_curve::linear;
+      if ((curve == velocity_curve::linear) and (curve_name != "linear"))
+      {
+	res.has_error = true;
+	return res;
+      }
+
+      ++i;
+      res.transform.set_velocity(res.transform.get_velocity_scale(), curve);
+      continue;
+    }
+
+    if (arg == "--octave-doubling")
+    {
+      const std::string direction = (i == argc - 1) ? "" : argv[i + 1];
+      if ((direction != "up") and (direction != "down"))
+      {
+	res.has_error = true;
+	return res;
+      }
+
+      ++i;
+      res.transform.set_octave_doubling((direction == "up") ? 1 : -1);
+      continue;
+    }
+
     if (res.filename != "")
     {
-      res.has_error = true;
-      return res;
+      res.playlist.emplace_back(argv[i]);
     }
     else
     {
@@ -106,9 +480,115 @@ struct options get_opts(const int argc, const char * const * const argv)
     }
   }
 
+  if (res.skip_music_sheet and (not res.headless))
+  {
+    res.has_error = true;
+  }
+
+  // only the window plays several files, shows the library and records
+  if (((not res.playlist.empty()) or (res.library_dir != "") or (res.record_filename != "")) and (res.headless or res.export_midi or (res.frames_dir != "") or res.memory_report))
+  {
+    res.has_error = true;
+  }
+
   return res;
 }
 
+// reading music sheet pages requires a gui application, but there is no
+// need for an actual display to do so.
+static void use_offscreen_platform()
+{
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+  {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+}
+
+static int run_headless(const struct options& opts)
+{
+  if ((opts.filename == "") or (not opts.was_output_port_set))
+  {
+    log_line(fatal_error_log) << "Error: headless mode requires a file and an output port";
+    return 2;
+  }
+
+  try
+  {
+    if (opts.skip_music_sheet)
+    {
+      play_headless(get_song(opts.filename, music_sheet_loading::skip, opts.song_memory_budget), opts.transform, opts.output_port);
+    }
+    else
+    {
+      use_offscreen_platform();
+      int dummy { 0 };
+      QGuiApplication a(dummy, nullptr);
+      play_headless(get_song_within_budget(opts.filename, opts.song_memory_budget), opts.transform, opts.output_port);
+    }
+  }
+  catch (std::exception& e)
+  {
+    log_line(fatal_error_log) << e.what();
+    return 1;
+  }
+
+  return 0;
+}
+
+static int run_frames_rendering(const struct options& opts)
+{
+  if (opts.filename == "")
+  {
+    log_line(fatal_error_log) << "Error: rendering frames requires a file";
+    return 2;
+  }
+
+  try
+  {
+    use_offscreen_platform();
+    int dummy { 0 };
+    QGuiApplication a(dummy, nullptr);
+    render_video_frames(get_song(opts.filename, music_sheet_loading::parse, opts.song_memory_budget), opts.fps, opts.frames_dir);
+  }
+  catch (std::exception& e)
+  {
+    log_line(fatal_error_log) << e.what();
+    return 1;
+  }
+
+  return 0;
+}
+
+static int run_memory_report(const struct options& opts)
+{
+  try
+  {
+    use_offscreen_platform();
+    int dummy { 0 };
+    QGuiApplication a(dummy, nullptr);
+
+    // the raw pages are only there while loading. Then the window keeps the
+    // events, and the pages compressed with the first ones parsed.
+    auto song = get_song_within_budget(opts.filename, opts.song_memory_budget);
+    memory_footprint footprint;
+    add_song_footprint(song, footprint);
+
+    page_store pages;
+    pages.set_memory_budget(opts.sheet_memory_budget);
+    pages.set_pages(std::move(song.svg_files));
+    add_pages_footprint(pages, footprint);
+
+    std::cout << opts.filename << "\n";
+    print_memory_footprint(footprint, std::cout);
+  }
+  catch (std::exception& e)
+  {
+    log_line(fatal_error_log) << e.what();
+    return 1;
+  }
+
+  return 0;
+}
 
 int main(const int argc, const char* const * const argv)
 {
@@ -116,6 +596,7 @@ int main(const int argc, const char* const * const argv)
 
   const auto opts = get_opts(argc, argv);
   const auto prog_name = argv[0];
+  set_log_level(opts.min_log_level);
 
   if (opts.has_error)
   {
@@ -129,16 +610,56 @@ int main(const int argc, const char* const * const argv)
     return 0;
   }
 
+  if (opts.trace_filename != "")
+  {
+    try
+    {
+      start_tracing(opts.trace_filename, opts.trace_events);
+      set_trace_thread_name("main");
+    }
+    catch (std::exception& e)
+    {
+      log_line(fatal_error_log) << e.what();
+      return 1;
+    }
+  }
+
   if (opts.list_ports)
   {
     list_midi_ports(std::cout);
     return 0;
   }
 
+  if (opts.export_midi)
+  {
+    std::ostringstream errors;
+    const auto nb_failures = export_to_standard_midi_files(opts.filename, errors);
+    log_text(fatal_error_log, errors.str());
+    return (nb_failures == 0) ? 0 : 1;
+  }
+
+  if (opts.memory_report)
+  {
+    return run_memory_report(opts);
+  }
+
+  if (opts.frames_dir != "")
+  {
+    return run_frames_rendering(opts);
+  }
+
+  if (opts.headless)
+  {
+    return run_headless(opts);
+  }
+
   int dummy { 0 };
   QApplication a(dummy, nullptr);
   a.setStyleSheet(stylesheet);
   MainWindow w;
+  w.set_sheet_memory_budget(opts.sheet_memory_budget);
+  w.set_song_memory_budget(opts.song_memory_budget);
+  w.set_midi_transform(opts.transform);
   w.show();
 
   if (opts.was_output_port_set)
@@ -156,5 +677,20 @@ int main(const int argc, const char* const * const argv)
     w.open_file( opts.filename );
   }
 
+  for (const auto& filename : opts.playlist)
+  {
+    w.add_to_playlist(filename);
+  }
+
+  if (opts.library_dir != "")
+  {
+    w.browse_library(opts.library_dir);
+  }
+
+  if (opts.record_filename != "")
+  {
+    w.start_recording(opts.record_filename);
+  }
+
   return a.exec();
 }
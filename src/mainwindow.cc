@@ -1,66 +1,70 @@
-#include <signal.h>
-#include <iostream>
+#include <chrono>
+#include <sstream>
+#include <QDialog>
+#include <QDockWidget>
+#include <QFontDatabase>
+#include <QLabel>
 #include <QFileDialog>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QVBoxLayout>
 #include <QMessageBox>
 #include <QKeyEvent>
+#include <QMenu>
+#include <QSocketNotifier>
 #include <QGraphicsSvgItem>
 #include <QGraphicsRectItem>
 #include "mainwindow.hh"
 #include "ui_mainwindow.hh"
 #include "measures_sequence_extractor.hh"
+#include "midi_port_registry.hh"
+#include "signals_handler.hh"
+#include "trace_events.hh"
+#include "log.hh"
 
-// Global variables to "share" state between the signal handler and
-// the main event loop.  Only these two pieces should be allowed to
-// use these global variables.  To avoid any other piece piece of code
-// from using it, the declaration is not written on a header file on
-// purpose.
-extern volatile sig_atomic_t pause_requested;
-extern volatile sig_atomic_t continue_requested;
-extern volatile sig_atomic_t exit_requested;
-extern volatile sig_atomic_t new_signal_received;
-
-static constexpr const char * const LILYPLAYER_VIRTUAL_MIDI_INPUT = "Lilyplayer listener";
-static constexpr const char * const LILYPLAYER_VIRTUAL_MIDI_OUTPUT = "Lilyplayer sound player";
+// steady clock time in ns, the same as input_midi_message::received_at
+static int64_t get_steady_time_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 void MainWindow::look_for_signals_change()
 {
-  if (not new_signal_received)
-  {
-    return;
-  }
+  const auto requests = read_signal_requests();
 
-  if (exit_requested)
+  if (requests.exit)
   {
     close();
   }
 
-  if (pause_requested)
+  if (requests.pause)
   {
-    pause_requested = 0;
     pause_music();
   }
 
-  if (continue_requested)
+  if (requests.resume)
   {
-    continue_requested = 0;
-    is_in_pause = false;
+    resume_music();
   }
-
-  new_signal_received = 0;
 }
 
 void MainWindow::keyPressEvent(QKeyEvent* event)
 {
   const auto pressed_key = event->key();
 
+  if ((pressed_key == Qt::Key_Plus) or (pressed_key == Qt::Key_Minus))
+  {
+    transform.set_transposition(transform.get_transposition() + ((pressed_key == Qt::Key_Plus) ? 1 : -1));
+  }
+
   if ((pressed_key == Qt::Key_Space) or
       (pressed_key == Qt::Key_P) or
       (pressed_key == Qt::Key_Pause))
   {
     // toggle play pause
-    if (is_in_pause)
+    if (scheduler.is_paused())
     {
-      is_in_pause = false;
+      resume_music();
     }
     else
     {
@@ -70,48 +74,73 @@ void MainWindow::keyPressEvent(QKeyEvent* event)
 }
 
 void MainWindow::process_keyboard_event(const std::vector<key_down>& keys_down,
-					const std::vector<key_up>& keys_up,
-					const std::vector<midi_message_t>& messages)
+					const std::vector<key_up>& keys_up)
 {
-  update_keyboard(keys_down, keys_up, this->keyboard);
-  this->update();
+  presenter.update_keys(keys_down, keys_up);
+  schedule_frame();
+
+  send_midi_messages(transform.apply(keys_down, keys_up));
+}
 
-  if (sound_player.isPortOpen())
+void MainWindow::send_midi_messages(const std::vector<short_midi_message>& messages)
+{
+  for (const auto& message : messages)
   {
-    for (auto message : messages)
-    {
-      sound_player.sendMessage(&message);
-    }
+    midi_output(message.bytes, sizeof(message.bytes));
   }
+  stats.add_midi_out(messages.size());
+  trace_instant("midi_send", "nb_messages", static_cast<int64_t>(messages.size()));
+}
+
+void MainWindow::set_midi_output(std::function<void(const uint8_t* bytes, std::size_t size)> output)
+{
+  midi_output = std::move(output);
+}
+
+void MainWindow::set_midi_transform(const midi_transform& new_transform)
+{
+  // the notes sounding were started by the previous one
+  send_midi_messages(transform.release_all());
+  transform = new_transform;
 }
 
 void MainWindow::display_music_sheet(const unsigned music_sheet_pos)
 {
+  trace_span span ("display_music_sheet");
+  span.set_arg("page", music_sheet_pos);
   // remove all the music sheets
   music_sheet_scene->clear();
 
-  const auto nb_svg = this->song.svg_files.size();
-  const auto nb_rendered = rendered_sheets.size();
-
-  if (nb_svg != nb_rendered)
-  {
-    throw std::runtime_error("Invalid state detected. The numbered of rendered file should match the number"
-			     " of svg files");
-  }
-
-  if (music_sheet_pos >= nb_rendered)
+  if (music_sheet_pos >= sheet_pages.size())
   {
     throw std::runtime_error("Invalid file format: it doesn't have enough music sheets.\n"
 			     "This should have been prevented from happening while reading the input file.");
   }
 
-  auto sheet = new QGraphicsSvgItem;
-  sheet->setSharedRenderer(rendered_sheets[music_sheet_pos].rendered);
-  sheet->setFlags(QGraphicsItem::ItemClipsToShape);
-  sheet->setCacheMode(QGraphicsItem::NoCache);
+  auto sheet = new cached_page_item(page_cache, sheet_pages, music_sheet_pos);
   sheet->setZValue(0);
   music_sheet_scene->addItem(sheet);
 
+  // render the page coming after the next page turn, so this turn is only a blit.
+  auto next_page = page_store::NO_PAGE;
+  const auto nb_events = song.events.size();
+  for (auto i = std::size_t{scheduler.has_song() ? scheduler.get_pos() : 0}; i < nb_events; ++i)
+  {
+    if (song.events[i].has_svg_file_change() and (song.events[i].new_svg_file != music_sheet_pos))
+    {
+      next_page = song.events[i].new_svg_file;
+      break;
+    }
+  }
+
+  // only these two pages are sure to stay in memory
+  sheet_pages.set_working_set(music_sheet_pos, next_page);
+  page_cache.set_working_set(music_sheet_pos, next_page);
+  if (next_page != page_store::NO_PAGE)
+  {
+    page_cache.prefetch(next_page);
+  }
+
   // if there was a rectangle displayed the clear function would have called the destructor
   svg_rect = new QGraphicsSvgItem;
   svg_rect->setFlags(QGraphicsItem::ItemClipsToShape);
@@ -120,87 +149,184 @@ void MainWindow::display_music_sheet(const unsigned music_sheet_pos)
   svg_rect->setSharedRenderer( cursor_rect );
   music_sheet_scene->addItem(svg_rect);
 
-  QByteArray svg_str_rectangle (rendered_sheets[music_sheet_pos].svg_first_line.c_str());
-  current_page_viewbox = rendered_sheets[music_sheet_pos].rendered->viewBoxF();
+  QByteArray svg_str_rectangle (sheet_pages.get_first_svg_line(music_sheet_pos).c_str());
+  current_page_viewbox = sheet_pages.get_viewbox(music_sheet_pos);
   svg_str_rectangle +=
     "<rect x=\"0.0000\" y=\"0.0000\" width=\"0.0000\" height=\"0.0000\""
     " ry=\"0.0000\" fill=\"currentColor\" fill-opacity=\"0.4\"/></svg>";
   cursor_rect->load(svg_str_rectangle);
 }
 
-void MainWindow::process_music_sheet_event(const music_sheet_event& event)
+void MainWindow::process_music_sheet_event(const unsigned int event_pos)
 {
+  const auto& event = song.events[event_pos];
+
   // process the keyboard event. Must have one.
-  this->process_keyboard_event(event.keys_down, event.keys_up, event.midi_messages);
+  this->process_keyboard_event(event.keys_down, event.keys_up);
 
   // is there a svg file change?
   if (event.has_svg_file_change())
   {
-    display_music_sheet(event.new_svg_file);
+    presenter.set_page(event.new_svg_file);
   }
 
   // is there a cursor pos change here?
   if (event.has_cursor_pos_change())
   {
-    cursor_rect->load(event.new_cursor_box);
+    presenter.set_cursor(event_pos);
+  }
+}
 
-    const auto scene_bounding_rect = svg_rect->sceneBoundingRect();
-    const auto scene_bounding_rect_height = scene_bounding_rect.height();
-    const auto half_cursor_box_height = event.cursor_box_coord.height() / 2;
-    const auto current_page_viewbox_height = current_page_viewbox.height();
+void MainWindow::display_cursor(const music_sheet_event& event)
+{
+  cursor_rect->load(event.new_cursor_box);
 
-    const auto to_scene_y = [&] (const auto y) {
-      return y * scene_bounding_rect_height / current_page_viewbox_height;
-    };
+  const auto scene_bounding_rect = svg_rect->sceneBoundingRect();
+  const auto scene_bounding_rect_height = scene_bounding_rect.height();
+  const auto current_page_viewbox_height = current_page_viewbox.height();
 
-    const auto rect_to_center = QRectF{scene_bounding_rect.left(),
-				       to_scene_y(std::max(event.cursor_box_coord.top() - half_cursor_box_height, 0.0)),
-				       scene_bounding_rect.width(),
-				       to_scene_y(3 * half_cursor_box_height)};
+  const auto to_scene_y = [&] (const auto y) {
+    return y * scene_bounding_rect_height / current_page_viewbox_height;
+  };
+
+  const auto view_area = get_cursor_view_area(current_page_viewbox, event.cursor_box_coord);
+  const auto rect_to_center = QRectF{scene_bounding_rect.left(),
+				     to_scene_y(view_area.top()),
+				     scene_bounding_rect.width(),
+				     to_scene_y(view_area.height())};
+
+  this->ui->music_sheet->setSceneRect(rect_to_center);
+}
 
-    this->ui->music_sheet->setSceneRect(rect_to_center);
+void MainWindow::schedule_frame()
+{
+  if (not frame_timer.isActive())
+  {
+    frame_timer.start(frame_presenter::FRAME_PERIOD_MS);
   }
 }
 
-void MainWindow::song_event_loop()
+void MainWindow::set_practice_staff(const unsigned int staff)
 {
-  if (is_in_pause or (song_pos == INVALID_SONG_POS))
+  practice.set_staff(staff, song.events);
+
+  // the song might have been waiting for the player
+  if ((not scheduler.is_paused()) and scheduler.has_song())
   {
-    QTimer::singleShot(100, this, SLOT(song_event_loop()));
-    return;
+    resume_music();
   }
+}
 
-  if (song_pos == stop_pos)
+void MainWindow::set_sheet_memory_budget(const std::size_t budget)
+{
+  sheet_memory_budget = budget;
+  sheet_pages.set_memory_budget(budget);
+  page_cache.set_memory_budget(budget);
+}
+
+void MainWindow::set_song_memory_budget(const std::size_t budget)
+{
+  song_memory_budget = budget;
+}
+
+void MainWindow::update_music_sheet()
+{
+  music_sheet_scene->update();
+}
+
+void MainWindow::update_stats_overlay()
+{
+  auto memory = song_footprint;
+  add_pages_footprint(sheet_pages, memory);
+  memory.rasterised_pages = page_cache.get_memory_usage();
+  std::ostringstream text;
+  stats.print(text, page_cache.take_sheet_rendering(), memory);
+  stats_label->setText(QString::fromStdString(text.str()));
+}
+
+void MainWindow::present_frame()
+{
+  trace_span span ("present_frame");
+  const auto frame = presenter.take_frame();
+
+  stats.add_frame();
+
+  // the page first, as displaying it resets the cursor
+  if ((frame.page != frame_presenter::NO_CHANGE) and (frame.page < sheet_pages.size()))
   {
-    stop_song();
-    QTimer::singleShot(100, this, SLOT(song_event_loop()));
-    return;
+    const auto start = get_steady_time_ns();
+    display_music_sheet(frame.page);
+    stats.add_page_turn_time(std::chrono::nanoseconds(get_steady_time_ns() - start));
   }
 
-  if (song_pos > song.nb_events)
+  // songs loaded without their music sheet have cursor changes, but no cursor to move.
+  if ((frame.cursor_event != frame_presenter::NO_CHANGE) and (frame.cursor_event < song.events.size()) and
+      (sheet_pages.size() != 0))
   {
-    throw std::runtime_error("Invalid song position found");
+    display_cursor(song.events[frame.cursor_event]);
+  }
+
+  if (frame.keyboard != nullptr)
+  {
+    keyboard->set_state(*frame.keyboard);
+
+    // the keyboard gets repainted right after this
+    if (oldest_undisplayed_input != 0)
+    {
+      const auto now = std::chrono::steady_clock::now().time_since_epoch();
+      input_display_latencies.add(now - std::chrono::nanoseconds(oldest_undisplayed_input));
+      oldest_undisplayed_input = 0;
+    }
   }
+}
+
+void MainWindow::play_song_event(const unsigned int event_pos, const std::chrono::nanoseconds lateness)
+{
+  const auto start = playback_time.now();
+  stats.add_event_lateness(lateness);
+  trace_instant("event_lateness", "us", std::chrono::duration_cast<std::chrono::microseconds>(lateness).count());
 
-  process_music_sheet_event( song.events[song_pos] );
+  process_music_sheet_event(event_pos);
+  practice.on_event_processed(event_pos);
 
-  const auto time_to_wait = static_cast<int>(song.events[song_pos].time);
-  song_pos++;
-  QTimer::singleShot(time_to_wait, this, SLOT(song_event_loop()));
-  return;
+  stats.add_event_processing_time(playback_time.now() - start);
+}
+
+void MainWindow::end_song()
+{
+  // go on with the playlist once the whole song has been played
+  if (scheduler.is_whole_song() and not next_songs.empty())
+  {
+    play_next_song();
+  }
+  else
+  {
+    stop_song();
+  }
 }
 
 void MainWindow::clear_music_scheet()
 {
   stop_song();
-
-  music_sheet_scene->clear();
-  const auto nb_rendered = rendered_sheets.size();
-  for (auto i = decltype(nb_rendered){0}; i < nb_rendered; ++i)
+  presenter.drop_music_sheet_changes();
+
+  static log_site song_report_log (log_level::info);
+  std::ostringstream report;
+  presenter.report(report);
+  page_cache.report(report);
+  practice.report(report);
+  if (input_display_latencies.size() != 0)
   {
-    delete rendered_sheets[i].rendered;
+    report << "Input to display latency: ";
+    print_latencies(input_display_latencies, report);
+    report << "\n";
+    input_display_latencies.clear();
   }
-  rendered_sheets.clear();
+  log_text(song_report_log, report.str());
+
+  music_sheet_scene->clear();
+  sheet_pages.clear();
+  page_cache.set_pages({});
 
   this->ui->start_measure->setMinimum(1);
   this->ui->start_measure->setValue(1);
@@ -211,34 +337,22 @@ void MainWindow::clear_music_scheet()
 
   // reinitialise the song field
   this->song = bin_song_t();
-  this->song_pos = INVALID_SONG_POS;
-  this->start_pos = INVALID_SONG_POS;
-  this->stop_pos = INVALID_SONG_POS;
+  scheduler.clear();
+  practice.set_song(song.events);
+  song_footprint = memory_footprint();
 
   this->update();
 }
 
-void MainWindow::pause_music()
+void MainWindow::resume_music()
 {
-  this->is_in_pause = true;
-  if (sound_player.isPortOpen())
-  {
-    // todo, compute the midi_messages vector at compile time
-    std::vector<key_up> keys;
-    constexpr const uint8_t nb_keys = static_cast<uint8_t>(note_kind::do_8) - static_cast<uint8_t>(note_kind::la_0) + 1;
-    keys.reserve(nb_keys);
-    for (auto key = static_cast<uint8_t>(note_kind::la_0); key <= static_cast<uint8_t>(note_kind::do_8); ++key)
-    {
-      keys.push_back(key_up{key});
-    }
-
-    const auto midi_messages = get_midi_from_keys_events(std::vector<key_down>(), keys);
-    for (auto message : midi_messages)
-    {
-      sound_player.sendMessage(&message);
-    }
+  player.resume();
+}
 
-  }
+void MainWindow::pause_music()
+{
+  player.pause();
+  send_midi_messages(transform.release_all());
 }
 
 void MainWindow::stop_song()
@@ -246,88 +360,92 @@ void MainWindow::stop_song()
   pause_music();
 
   // reset all keys to up on the keyboard (doesn't play key_released events).
-  reset_color(keyboard);
-  this->update();
+  presenter.release_all_keys();
+  schedule_frame();
 }
 
 void MainWindow::replay()
 {
   stop_song();
-  this->start_pos = 0;
-  this->stop_pos = static_cast<decltype(stop_pos)>(this->song.nb_events);
-  this->song_pos = this->start_pos;
-  is_in_pause = false;
+  scheduler.set_range(0, static_cast<unsigned int>(this->song.events.size()));
+  resume_music();
 }
 
-void MainWindow::open_file(const std::string& filename)
+void MainWindow::install_song(prepared_song&& prepared)
 {
-  try
-  {
-    clear_music_scheet();
-    this->song = get_song(filename);
-    this->start_pos = 0;
-    this->stop_pos = static_cast<decltype(stop_pos)>(this->song.nb_events);
-
-    const auto max_measure = find_last_measure(song.events);
-    this->ui->start_measure->setMinimum(1);
-    this->ui->start_measure->setValue(1);
-    this->ui->start_measure->setMaximum(max_measure);
-    this->ui->stop_measure->setMinimum(1);
-    this->ui->stop_measure->setMaximum(max_measure);
-    this->ui->stop_measure->setValue(max_measure);
-
-    // compute waiting time
-    for (unsigned i = 0; i + 1 < song.nb_events; ++i)
-    {
-      song.events[i].time = ((song.events[i + 1].time - song.events[i].time) / 1'000'000);
-    }
-    if (song.nb_events > 0)
-    {
-      song.events[ song.nb_events - 1].time = 3000; // to wait 3 seconds after last event
-    }
+  clear_music_scheet();
+  this->song = std::move(prepared.song);
+  scheduler.set_song(this->song.events);
+
+  const auto max_measure = prepared.last_measure;
+  this->ui->start_measure->setMinimum(1);
+  this->ui->start_measure->setValue(1);
+  this->ui->start_measure->setMaximum(max_measure);
+  this->ui->stop_measure->setMinimum(1);
+  this->ui->stop_measure->setMaximum(max_measure);
+  this->ui->stop_measure->setValue(max_measure);
 
-    this->song_pos = this->start_pos;
+  practice.set_song(song.events);
+  song_footprint = memory_footprint();
+  add_song_footprint(song, song_footprint);
+
+  // in practice mode, the player plays along the song on the input port.
+  if (not practice.is_enabled())
+  {
     sound_listener.closePort();
     this->selected_input_port.clear();
+  }
+
+  // the pages have already been checked and compressed.
+  sheet_pages = std::move(prepared.pages);
+  sheet_pages.set_memory_budget(sheet_memory_budget);
+  page_cache.set_pages(sheet_pages.get_compressed_pages());
+  if (not prepared.first_page.isNull())
+  {
+    page_cache.add_image(0, std::move(prepared.first_page));
+  }
+  // recordings have no music sheet
+  if (sheet_pages.size() != 0)
+  {
+    display_music_sheet(0);
+  }
+  resume_music();
+
+  // the next song of the playlist gets ready while this one plays
+  next_songs.preload_next(page_cache.get_last_width(), song_memory_budget);
+}
 
-    const auto nb_svg = song.svg_files.size();
-    if (rendered_sheets.size() != 0)
+void MainWindow::play_next_song()
+{
+  while (not next_songs.empty())
+  {
+    try
     {
-	throw std::runtime_error("Invalid state detected. There should be no rendered_sheets.");
+      install_song(next_songs.take_next(page_cache.get_last_width(), song_memory_budget));
+      return;
     }
-
-    // pre-render each svg files first, so when there will be a turn page event, it is already parsed.
-    for (unsigned int i = 0; i < nb_svg; ++i)
+    catch (std::exception& e)
     {
-      const auto& this_sheet = this->song.svg_files[i];
-      const char* const sheet_data = static_cast<const char*>(static_cast<const void*>(this_sheet.data.data()));
-      const auto sheet_size = this_sheet.data.size();
-      const QByteArray music_sheet (sheet_data, static_cast<int>(sheet_size));
-
-      auto current_renderer = new QSvgRenderer;
-      const auto is_load_successfull = current_renderer->load(music_sheet);
-      if (not is_load_successfull)
-      {
-	delete current_renderer;
-	throw std::runtime_error("Invalid file format: failed to parse a music sheet page.");
-      }
-
-      rendered_sheets.emplace_back(sheet_property{ current_renderer,
-						   get_first_svg_line(this_sheet.data) });
+      static log_site skipped_song_log (log_level::warning);
+      log_line(skipped_song_log) << "Warning: skipping a song of the playlist: " << e.what();
     }
+  }
 
-    display_music_sheet(0);
-    is_in_pause = false;
+  stop_song();
+}
+
+void MainWindow::open_file(const std::string& filename)
+{
+  trace_span span ("open_file");
+  try
+  {
+    install_song(prepare_song(filename, page_cache.get_last_width(), song_memory_budget));
   }
   catch (std::exception& e)
   {
-    // delete already rendered sheets
-    const auto nb_elts = rendered_sheets.size();
-    for (unsigned i = 0; i < nb_elts; ++i)
-    {
-      delete rendered_sheets[i].rendered;
-    }
-    rendered_sheets.clear();
+    // delete already parsed sheets
+    sheet_pages.clear();
+    page_cache.set_pages({});
 
     const auto err_msg = e.what();
     QMessageBox::critical(this, tr("Failed to open file."),
@@ -338,18 +456,36 @@ void MainWindow::open_file(const std::string& filename)
   }
 }
 
-void MainWindow::open_file()
+void MainWindow::add_to_playlist(const std::string& filename)
+{
+  next_songs.add(filename);
+
+  if (not scheduler.has_song())
+  {
+    // nothing is being played, no need to wait for the end of a song
+    play_next_song();
+  }
+  else
+  {
+    next_songs.preload_next(page_cache.get_last_width(), song_memory_budget);
+  }
+}
+
+static QStringList get_file_dialog_filters()
 {
-  const QStringList filters = [] () { QStringList tmp;
-				      tmp << "Binary files (*.bin)"
-				          << "Any files (*)";
-				      return tmp;
-				    }();
+  QStringList res;
+  res << "Binary files (*.bin)"
+      << "Standard midi files (*.mid *.midi)"
+      << "Any files (*)";
+  return res;
+}
 
+void MainWindow::open_file()
+{
   QFileDialog dialog;
   dialog.setFileMode(QFileDialog::ExistingFile);
   dialog.setViewMode(QFileDialog::List);
-  dialog.setNameFilters(filters);
+  dialog.setNameFilters(get_file_dialog_filters());
 
   const auto dialog_ret = dialog.exec();
   if (dialog_ret == QDialog::Accepted)
@@ -365,6 +501,238 @@ void MainWindow::open_file()
   }
 }
 
+void MainWindow::queue_files()
+{
+  QFileDialog dialog;
+  dialog.setFileMode(QFileDialog::ExistingFiles);
+  dialog.setViewMode(QFileDialog::List);
+  dialog.setNameFilters(get_file_dialog_filters());
+
+  const auto dialog_ret = dialog.exec();
+  if (dialog_ret == QDialog::Accepted)
+  {
+    for (const auto& file : dialog.selectedFiles())
+    {
+      add_to_playlist(file.toStdString());
+    }
+  }
+}
+
+void MainWindow::browse_library(const std::string& dir)
+{
+  const auto is_scanning = library_scan.valid() and
+    (library_scan.wait_for(std::chrono::seconds(0)) != std::future_status::ready);
+  if (is_scanning)
+  {
+    return;
+  }
+
+  library_dir = dir;
+  library_scan = std::async(std::launch::async, [this, dir] () {
+      static log_site scan_log (log_level::info);
+      static log_site scan_error_log (log_level::error);
+      try
+      {
+	std::ostringstream result;
+	print_scan_result(library.scan(dir), result);
+	log_text(scan_log, result.str());
+	library.save();
+      }
+      catch (std::exception& e)
+      {
+	log_line(scan_error_log) << e.what();
+      }
+
+      // read here rather than by show_library, as the future is only ready
+      // once this returns: show_library may run before.
+      std::vector<score_info> scores;
+      std::string error;
+      try
+      {
+	scores = library.get_scores(dir);
+      }
+      catch (std::exception& e)
+      {
+	error = e.what();
+      }
+
+      {
+	std::lock_guard<std::mutex> lock (scanned_scores_mutex);
+	scanned_scores = std::move(scores);
+	scan_error = std::move(error);
+      }
+      QMetaObject::invokeMethod(this, "show_library", Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::choose_library()
+{
+  const auto dir = QFileDialog::getExistingDirectory(this, tr("Select the library directory"),
+						     QString::fromStdString(library_dir));
+  if (not dir.isEmpty())
+  {
+    browse_library(dir.toStdString());
+  }
+}
+
+static QString format_duration(const uint64_t duration_ms)
+{
+  const auto nb_seconds = duration_ms / 1000;
+  return QString("%1:%2").arg(nb_seconds / 60, 2, 10, QChar('0')).arg(nb_seconds % 60, 2, 10, QChar('0'));
+}
+
+static QTableWidgetItem* make_number_item(const int value)
+{
+  // numbers as numbers, so that sorting the column sorts them by value
+  auto item = new QTableWidgetItem();
+  item->setData(Qt::DisplayRole, value);
+  return item;
+}
+
+void MainWindow::show_library()
+{
+  std::vector<score_info> scores;
+  std::string error;
+  {
+    std::lock_guard<std::mutex> lock (scanned_scores_mutex);
+    scores.swap(scanned_scores);
+    error.swap(scan_error);
+  }
+
+  if (not error.empty())
+  {
+    QMessageBox::critical(this, tr("Failed to open the library."),
+			  QString::fromStdString(error),
+			  QMessageBox::Ok,
+			  QMessageBox::Ok);
+    return;
+  }
+
+  auto dialog = new QDialog(this);
+  dialog->setAttribute(Qt::WA_DeleteOnClose);
+  dialog->setWindowTitle(QString::fromStdString(library_dir));
+
+  auto table = new QTableWidget(static_cast<int>(scores.size()), 5, dialog);
+  table->setHorizontalHeaderLabels(QStringList() << "Title" << "Instruments" << "Duration" << "Measures" << "Pages");
+  table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  table->setSelectionBehavior(QAbstractItemView::SelectRows);
+
+  for (auto row = decltype(scores.size()){0}; row < scores.size(); ++row)
+  {
+    const auto& score = scores[row];
+    const auto table_row = static_cast<int>(row);
+
+    QString instr_names;
+    for (const auto& instr_name : score.instr_names)
+    {
+      instr_names += (instr_names.isEmpty() ? "" : ", ") + QString::fromStdString(instr_name);
+    }
+
+    auto title = new QTableWidgetItem(QString::fromStdString(score.title));
+    title->setData(Qt::UserRole, QString::fromStdString(score.path));
+    table->setItem(table_row, 0, title);
+    table->setItem(table_row, 1, new QTableWidgetItem(instr_names));
+    table->setItem(table_row, 2, new QTableWidgetItem(format_duration(score.duration_ms)));
+    table->setItem(table_row, 3, make_number_item(score.nb_measures));
+    table->setItem(table_row, 4, make_number_item(score.nb_pages));
+  }
+
+  // only once filled, as sorting moves the rows being filled
+  table->setSortingEnabled(true);
+
+  const auto get_path = [table] (const int row) {
+    return table->item(row, 0)->data(Qt::UserRole).toString().toStdString();
+  };
+
+  connect(table, &QTableWidget::cellDoubleClicked, this, [this, get_path] (const int row, const int /* column */) {
+      open_file(get_path(row));
+    });
+
+  auto add_button = new QPushButton(tr("Add to the playlist"), dialog);
+  connect(add_button, &QPushButton::clicked, this, [this, table, get_path] () {
+      for (const auto& index : table->selectionModel()->selectedRows())
+      {
+	add_to_playlist(get_path(index.row()));
+      }
+    });
+
+  auto layout = new QVBoxLayout(dialog);
+  layout->addWidget(table);
+  layout->addWidget(add_button);
+
+  dialog->resize(800, 600);
+  dialog->show();
+}
+
+void MainWindow::start_recording(const std::string& filename)
+{
+  recording_filename = filename;
+  recorder.start();
+}
+
+void MainWindow::stop_recording(const std::string& filename)
+{
+  recorder.stop();
+  if (recorder.empty())
+  {
+    throw std::runtime_error("Nothing was recorded: no key was played on the input.");
+  }
+
+  save_recording(recorder.get_song(), filename);
+
+  const auto nb_dropped = recorder.get_nb_dropped();
+  if (nb_dropped != 0)
+  {
+    static log_site full_recording_log (log_level::warning);
+    log_line(full_recording_log) << "Warning: the recording was full after " << recorder.capacity()
+				 << " keys, the last " << nb_dropped << " keys played were not recorded";
+  }
+}
+
+void MainWindow::toggle_recording()
+{
+  if (not recorder.is_active())
+  {
+    start_recording("");
+    return;
+  }
+
+  if (recorder.empty())
+  {
+    recorder.stop();
+    QMessageBox::information(this, tr("Nothing recorded."),
+			     "No key was played on the input since the recording started.",
+			     QMessageBox::Ok,
+			     QMessageBox::Ok);
+    return;
+  }
+
+  auto filename = recording_filename;
+  if (filename == "")
+  {
+    filename = QFileDialog::getSaveFileName(this, tr("Save the recording"), QString(),
+					    "Lilyplayer files (*.bin);;Standard midi files (*.mid)").toStdString();
+  }
+
+  if (filename == "")
+  {
+    // cancelled, the keys played so far are kept in case it is saved later on.
+    return;
+  }
+
+  try
+  {
+    stop_recording(filename);
+  }
+  catch (std::exception& e)
+  {
+    QMessageBox::critical(this, tr("Failed to save the recording."),
+			  e.what(),
+			  QMessageBox::Ok,
+			  QMessageBox::Ok);
+  }
+}
+
 void MainWindow::sub_sequence_click()
 {
   stop_song();
@@ -377,21 +745,25 @@ void MainWindow::sub_sequence_click()
 
   if (sequences.empty())
   {
-    std::cerr << "Error, no sequence going from measure " << start_measure << " to measure " << stop_measure << " found\n";
+    static log_site no_sequence_log (log_level::error);
+    log_line(no_sequence_log) << "Error, no sequence going from measure " << start_measure << " to measure " << stop_measure << " found";
   }
   else
   {
     if (sequences.size() != 1)
     {
-      std::cerr << "several possibilities found. picking first one\n";
+      static log_site several_sequences_log (log_level::info);
+      log_line(several_sequences_log) << "several possibilities found. picking first one";
     }
 
-    this->start_pos = static_cast<decltype(song_pos)>(sequences[0].first);
-    this->stop_pos = static_cast<decltype(song_pos)>(sequences[0].second);
-    this->song_pos = this->start_pos;
-    const auto music_sheet_pos = find_music_sheet_pos(song.events, song_pos);
-    display_music_sheet(music_sheet_pos);
-    is_in_pause = false;
+    scheduler.set_range(static_cast<unsigned int>(sequences[0].first),
+			static_cast<unsigned int>(sequences[0].second));
+    presenter.drop_music_sheet_changes();
+    if (sheet_pages.size() != 0)
+    {
+      display_music_sheet(find_music_sheet_pos(song.events, scheduler.get_pos()));
+    }
+    resume_music();
   }
 
 }
@@ -402,7 +774,7 @@ void MainWindow::set_output_port(const unsigned int i)
   {
     sound_player.closePort();
     sound_player.openPort(i);
-    const auto port_name = sound_player.getPortName(i);
+    const auto port_name = get_midi_port_registry().get_output_ports().at(i);
     sound_player.openVirtualPort();
     this->selected_output_port = port_name;
     this->update_output_ports();
@@ -435,16 +807,12 @@ void MainWindow::output_port_change()
     if (button->isChecked())
     {
       this->selected_output_port = button->text().toStdString();
-      const auto nb_ports = sound_player.getPortCount();
-      for (unsigned int i = 0; i < nb_ports; ++i)
+      const auto port = get_midi_port_registry().find_output_port(selected_output_port);
+      if (port != midi_port_registry::NO_PORT)
       {
-	const auto port_name = sound_player.getPortName(i);
-	if (port_name == selected_output_port)
-	{
-	  sound_player.closePort();
-	  sound_player.openPort(i);
-	  sound_player.openVirtualPort();
-	}
+	sound_player.closePort();
+	sound_player.openPort(port);
+	sound_player.openVirtualPort();
       }
     }
   }
@@ -452,10 +820,11 @@ void MainWindow::output_port_change()
 
 void MainWindow::update_output_ports()
 {
-  const auto nb_ports = sound_player.getPortCount();
-  if (nb_ports == 0)
+  auto port_names = get_midi_port_registry().get_output_ports();
+  if (port_names.empty())
   {
-    std::cerr << "Sorry: can't populate menu, no output midi port found\n";
+    static log_site no_port_for_menu_log (log_level::warning);
+    log_line(no_port_for_menu_log) << "Sorry: can't populate menu, no output midi port found";
     return;
   }
 
@@ -471,7 +840,6 @@ void MainWindow::update_output_ports()
     action_group = new QActionGroup( menu_output_port );
   }
 
-  auto port_names = get_output_midi_ports_name(sound_player);
   port_names = filter_out(port_names, LILYPLAYER_VIRTUAL_MIDI_INPUT);
   if (selected_input_port != "")
   {
@@ -492,14 +860,63 @@ void MainWindow::update_output_ports()
   }
 }
 
-void MainWindow::handle_input_midi(const std::vector<unsigned char> message)
+void MainWindow::handle_input_midi()
 {
-  const auto key_events = midi_to_key_events(message);
-  const std::vector<midi_message_t> messages { { message } };
-  this->process_keyboard_event(key_events.keys_down, key_events.keys_up, messages);
+  // messages arriving from now on will need a new wake-up.
+  is_input_processing_scheduled = false;
+
+  auto last_key_press = int64_t{0};
+  const auto nb_processed = input_messages.consume_all([this, &last_key_press] (const input_midi_message& message) {
+      // a message holds at most one event per byte
+      midi_event events[sizeof(message.bytes)];
+      const auto parsed = input_parser.parse(message.bytes, message.size, events, sizeof(events) / sizeof(events[0]));
+      for (auto i = decltype(parsed.nb_events){0}; i < parsed.nb_events; ++i)
+      {
+	const auto is_key_event = (events[i].kind == midi_event_kind::note_on) or (events[i].kind == midi_event_kind::note_off);
+	if (is_key_event and (oldest_undisplayed_input == 0))
+	{
+	  oldest_undisplayed_input = message.received_at;
+	}
+
+	if (events[i].kind == midi_event_kind::note_on)
+	{
+	  presenter.press_key(events[i].data1, 0 /* staff_num */);
+	  practice.press_key(events[i].data1);
+	  last_key_press = message.received_at;
+	}
+	else if (events[i].kind == midi_event_kind::note_off)
+	{
+	  presenter.release_key(events[i].data1);
+	}
+      }
+
+      midi_output(message.bytes, message.size);
+      stats.add_midi_out(1);
+    });
+
+  if (nb_processed != 0)
+  {
+    stats.add_midi_in(nb_processed);
+    schedule_frame();
+  }
+
+  // the song was waiting for the player, it goes on as soon as the chord is complete.
+  if (practice.is_waiting_for_player() and (not scheduler.is_paused()) and practice.is_matched(scheduler.get_pos()))
+  {
+    scheduler.restart_from_now();
+    player.play_due_event();
+
+    // only if a key completed the chord: it may also have been matched
+    // before, e.g. when a sub-sequence starts on it.
+    if (last_key_press != 0)
+    {
+      const auto now = std::chrono::steady_clock::now().time_since_epoch();
+      practice.add_latency(now - std::chrono::nanoseconds(last_key_press));
+    }
+  }
 }
 
-void MainWindow::on_midi_input(double timestamp __attribute__((unused)), std::vector<unsigned char> *message, void* param)
+void MainWindow::on_midi_input(double timestamp, std::vector<unsigned char> *message, void* param)
 {
   if (message == nullptr)
   {
@@ -511,17 +928,44 @@ void MainWindow::on_midi_input(double timestamp __attribute__((unused)), std::ve
     throw std::invalid_argument("Error, invalid argument for input listener");
   }
 
+  // This runs on the RtMidi thread: only record the keys, and hand the
+  // message over to the gui thread.
   auto window = static_cast<class MainWindow*>(param);
-  window->handle_input_midi(*message);
+  const auto received_at = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  window->recorder.add(received_at, message->data(), message->size());
+
+  input_midi_message input {};
+  const auto is_message_storable = (message->size() <= sizeof(input.bytes));
+  if (is_message_storable)
+  {
+    input.timestamp = timestamp;
+    input.received_at = received_at;
+    input.size = static_cast<uint8_t>(message->size());
+    std::copy(message->cbegin(), message->cend(), input.bytes);
+  }
   message->clear();
+
+  if (is_message_storable and window->input_messages.push(input))
+  {
+    if (not window->is_input_processing_scheduled.exchange(true))
+    {
+      QMetaObject::invokeMethod(window, "handle_input_midi", Qt::QueuedConnection);
+    }
+  }
+  else
+  {
+    // either too long to be a key event (e.g. sysex) or the gui can't keep up.
+    window->nb_dropped_input_messages++;
+  }
 }
 
 void MainWindow::on_midi_error(RtMidiError::Type type, const std::string &errorText, const char* const direction)
 {
-  std::cerr << "Error occured for midi " << direction << ":\n"
-	    << "  RtMidi considers this as a " << rt_error_type_as_str(type) << "\n"
-	    << "  it also says: " << errorText << "\n"
-	    << std::endl;
+  // called from the midi threads, on every failed message while a device is unplugged
+  static log_site midi_error_log (log_level::error);
+  log_line(midi_error_log) << "Error occured for midi " << direction << ":\n"
+			   << "  RtMidi considers this as a " << rt_error_type_as_str(type) << "\n"
+			   << "  it also says: " << errorText;
 }
 
 void MainWindow::on_midi_input_error(RtMidiError::Type type, const std::string &errorText, void* param __attribute__((unused)))
@@ -536,7 +980,7 @@ void MainWindow::on_midi_output_error(RtMidiError::Type type, const std::string
 
 void MainWindow::set_input_port(unsigned int i)
 {
-  const auto port_name = sound_listener.getPortName(i);
+  const auto port_name = get_midi_port_registry().get_input_ports().at(i);
   this->selected_input_port = port_name;
   sound_listener.closePort();
   sound_listener.setCallback(&MainWindow::on_midi_input, this);
@@ -581,22 +1025,15 @@ void MainWindow::input_change()
 											return button->isChecked();
 											 });
 
-  this->clear_music_scheet();
+  // in practice mode, the input is the player playing along the song.
+  if (not practice.is_enabled())
+  {
+    this->clear_music_scheet();
+  }
   this->selected_input_port = clicked_button->text().toStdString();
 
-  const auto nb_ports_with_selected_input_name = [&] () {
-						   const auto nb_ports = sound_listener.getPortCount();
-						   unsigned int res = 0;
-						   for (unsigned int i = 0; i < nb_ports; ++i)
-						   {
-						     const auto port_name = sound_listener.getPortName(i);
-						     if (port_name == selected_input_port)
-						     {
-						       ++res;
-						     }
-						   }
-						   return res;
-						 }();
+  const auto& input_ports = get_midi_port_registry().get_input_ports();
+  const auto nb_ports_with_selected_input_name = std::count(input_ports.cbegin(), input_ports.cend(), selected_input_port);
 
   if (nb_ports_with_selected_input_name >= 2)
   {
@@ -616,18 +1053,7 @@ void MainWindow::input_change()
     return;
   }
 
-  const auto num_port_with_selected_input_name = [&] () {
-						   const auto nb_ports = sound_listener.getPortCount();
-						   for (unsigned int i = 0; i < nb_ports; ++i)
-						   {
-						     const auto port_name = sound_listener.getPortName(i);
-						     if (port_name == selected_input_port)
-						     {
-						       return i;
-						     }
-						   }
-						   throw std::runtime_error(std::string{"no midi input port with name ["} + selected_input_port + "] found");
-						 }();
+  const auto num_port_with_selected_input_name = get_midi_port_registry().find_input_port(selected_input_port);
 
 
   try
@@ -677,10 +1103,58 @@ void MainWindow::update_input_entries()
     connect(button, SIGNAL(triggered()), this, SLOT(open_file()));
   }
 
+  {
+    // the playlist entry, followed by the files waiting to be played
+    auto button = menu_input->addAction("add files to the playlist");
+    connect(button, SIGNAL(triggered()), this, SLOT(queue_files()));
+
+    for (const auto& filename : next_songs.get_files())
+    {
+      auto entry = menu_input->addAction(QString::fromStdString("  next: " + filename));
+      entry->setEnabled(false);
+    }
+
+    menu_input->addSeparator();
+  }
+
+  {
+    // practice mode: the song waits for the player to play the keys of a staff
+    practice_menu->clear();
+    const auto add_practice_entry = [this] (const QString& label, const unsigned int staff) {
+      auto button = practice_menu->addAction(label);
+      button->setCheckable(true);
+      button->setChecked(practice.get_staff() == staff);
+      connect(button, &QAction::triggered, this, [this, staff] () {
+	  set_practice_staff(staff);
+	});
+    };
+
+    add_practice_entry("off", chord_matcher::NO_STAFF);
+    add_practice_entry("wait for all the staffs", chord_matcher::ALL_STAFFS);
+    const auto nb_staffs = static_cast<unsigned int>(song.instr_names.size());
+    for (auto staff = decltype(nb_staffs){0}; staff < nb_staffs; ++staff)
+    {
+      add_practice_entry("wait for " + QString::fromStdString(song.instr_names[staff]), staff);
+    }
+
+    menu_input->addMenu(practice_menu);
+    menu_input->addSeparator();
+  }
+
+  {
+    auto button = menu_input->addAction(recorder.is_active() ? "stop recording" : "start recording");
+    connect(button, SIGNAL(triggered()), this, SLOT(toggle_recording()));
+  }
+
+  {
+    auto button = menu_input->addAction("browse library");
+    connect(button, SIGNAL(triggered()), this, SLOT(choose_library()));
+    menu_input->addSeparator();
+  }
+
   {
     // Add one entry per input midi port
-    auto port_names = get_input_midi_ports_name(sound_listener);
-    port_names = filter_out(port_names, LILYPLAYER_VIRTUAL_MIDI_OUTPUT);
+    auto port_names = filter_out(get_midi_port_registry().get_input_ports(), LILYPLAYER_VIRTUAL_MIDI_OUTPUT);
     if (selected_output_port != "")
     {
       port_names = filter_out(port_names, selected_output_port.c_str());
@@ -700,6 +1174,84 @@ void MainWindow::update_input_entries()
   }
 }
 
+void MainWindow::update_transform_menu()
+{
+  transform_menu->clear();
+
+  // changes apply to the next notes: the ones sounding are released as they were pressed
+  const auto add_entry = [this] (QMenu* const menu, const QString& label, const bool is_checked, std::function<void()> on_click) {
+    auto button = menu->addAction(label);
+    button->setCheckable(true);
+    button->setChecked(is_checked);
+    connect(button, &QAction::triggered, this, std::move(on_click));
+  };
+
+  {
+    const auto transposition = transform.get_transposition();
+    auto label = transform_menu->addAction(QString("transposition: %1 semitones (+ and - keys)").arg(transposition));
+    label->setEnabled(false);
+    add_entry(transform_menu, "transpose up a semitone", false, [this, transposition] () {
+	transform.set_transposition(transposition + 1);
+      });
+    add_entry(transform_menu, "transpose down a semitone", false, [this, transposition] () {
+	transform.set_transposition(transposition - 1);
+      });
+    add_entry(transform_menu, "no transposition", transposition == 0, [this] () {
+	transform.set_transposition(0);
+      });
+    transform_menu->addSeparator();
+  }
+
+  {
+    const auto doubling = transform.get_octave_doubling();
+    add_entry(transform_menu, "no octave doubling", doubling == 0, [this] () { transform.set_octave_doubling(0); });
+    add_entry(transform_menu, "double an octave up", doubling == 1, [this] () { transform.set_octave_doubling(1); });
+    add_entry(transform_menu, "double an octave down", doubling == -1, [this] () { transform.set_octave_doubling(-1); });
+    transform_menu->addSeparator();
+  }
+
+  {
+    const auto scale = transform.get_velocity_scale();
+    const auto curve = transform.get_velocity_curve();
+    auto label = transform_menu->addAction(QString("velocity: %1%").arg(static_cast<int>(scale * 100 + 0.5)));
+    label->setEnabled(false);
+    add_entry(transform_menu, "louder", false, [this, scale, curve] () { transform.set_velocity(scale + 0.1, curve); });
+    add_entry(transform_menu, "softer", false, [this, scale, curve] () { transform.set_velocity(std::max(scale - 0.1, 0.0), curve); });
+    add_entry(transform_menu, "linear velocity", curve == velocity_curve::linear, [this, scale] () {
+	transform.set_velocity(scale, velocity_curve::linear);
+      });
+    add_entry(transform_menu, "soft velocity curve", curve == velocity_curve::soft, [this, scale] () {
+	transform.set_velocity(scale, velocity_curve::soft);
+      });
+    add_entry(transform_menu, "hard velocity curve", curve == velocity_curve::hard, [this, scale] () {
+	transform.set_velocity(scale, velocity_curve::hard);
+      });
+    transform_menu->addSeparator();
+  }
+
+  // one submenu per staff of the song
+  const auto nb_staffs = std::min(song.instr_names.size(), std::size_t{256});
+  for (auto i = decltype(nb_staffs){0}; i < nb_staffs; ++i)
+  {
+    const auto staff_num = static_cast<uint8_t>(i);
+    auto staff_menu = transform_menu->addMenu(QString::fromStdString(song.instr_names[i]));
+    add_entry(staff_menu, "mute", transform.is_muted(staff_num), [this, staff_num] () {
+	transform.set_muted(staff_num, not transform.is_muted(staff_num));
+      });
+    add_entry(staff_menu, "solo", transform.is_solo(staff_num), [this, staff_num] () {
+	transform.set_solo(staff_num, not transform.is_solo(staff_num));
+      });
+    staff_menu->addSeparator();
+
+    for (uint8_t channel = 0; channel < 16; ++channel)
+    {
+      add_entry(staff_menu, QString("channel %1").arg(channel + 1), transform.get_channel(staff_num) == channel, [this, staff_num, channel] () {
+	  transform.set_channel(staff_num, channel);
+	});
+    }
+  }
+}
+
 
 #if !defined(__clang__)
   #pragma GCC diagnostic push
@@ -707,29 +1259,132 @@ void MainWindow::update_input_entries()
 #endif
 
 MainWindow::MainWindow(QWidget *parent) :
+  MainWindow(nullptr, nullptr, parent)
+{
+}
+
+MainWindow::MainWindow(const playback_clock& clock, playback_timer& timer, QWidget *parent) :
+  MainWindow(&clock, &timer, parent)
+{
+}
+
+MainWindow::MainWindow(const playback_clock* const clock, playback_timer* const timer, QWidget *parent) :
   QMainWindow(parent),
   ui(new Ui::MainWindow),
   keyboard_scene(new QGraphicsScene(this)),
-  keyboard(*keyboard_scene),
+  keyboard(new keyboard_item()),
   music_sheet_scene(new QGraphicsScene(this)),
-  rendered_sheets(),
+  sheet_pages(),
   current_page_viewbox(),
   cursor_rect(new QSvgRenderer(this)),
   svg_rect(nullptr),
-  signal_checker_timer(),
+  signal_notifier(new QSocketNotifier(get_signal_fd(), QSocketNotifier::Read, this)),
+  steady_time(),
+  qt_song_timer(),
+  playback_time((clock != nullptr) ? *clock : steady_time),
+  song_timer((timer != nullptr) ? *timer : qt_song_timer),
+  frame_timer(),
+  presenter(),
+  page_cache([this] () {
+      // called from the worker thread
+      QMetaObject::invokeMethod(this, "update_music_sheet", Qt::QueuedConnection);
+    }),
+  sheet_memory_budget(page_store::DEFAULT_MEMORY_BUDGET),
+  song_memory_budget(NO_MEMORY_BUDGET),
+  next_songs(),
   song(),
   sound_player(RtMidi::LINUX_ALSA, LILYPLAYER_VIRTUAL_MIDI_OUTPUT),
   sound_listener(RtMidi::LINUX_ALSA, LILYPLAYER_VIRTUAL_MIDI_INPUT),
-  is_in_pause(true)
+  midi_output([this] (const uint8_t* const bytes, const std::size_t size) {
+      if (sound_player.isPortOpen())
+      {
+	sound_player.sendMessage(bytes, size);
+      }
+    }),
+  transform(),
+  transform_menu(new QMenu("sound", this)),
+  scheduler(playback_time),
+  player(playback_time, scheduler, song_timer),
+  practice(),
+  practice_menu(new QMenu("practice", this)),
+  input_messages(INPUT_MIDI_QUEUE_CAPACITY),
+  is_input_processing_scheduled(false),
+  nb_dropped_input_messages(0),
+  input_parser(),
+  input_display_latencies(),
+  oldest_undisplayed_input(0),
+  recorder(),
+  recording_filename(),
+  stats(),
+  song_footprint(),
+  stats_dock(new QDockWidget("statistics", this)),
+  stats_label(new QLabel(stats_dock)),
+  stats_timer(),
+  library(get_default_library_index_path()),
+  library_dir(),
+  scanned_scores_mutex(),
+  scanned_scores(),
+  scan_error(),
+  library_scan()
 {
   ui->setupUi(this);
   ui->keyboard->setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform);
+  keyboard_scene->addItem(keyboard);
   ui->keyboard->setScene(keyboard_scene);
 
   ui->music_sheet->setScene(music_sheet_scene);
+  ui->music_sheet->setMinimumHeight(MUSIC_SHEET_VIEW_HEIGHT);
+
+  player.set_event_handler([this] (const unsigned int event_pos, const std::chrono::nanoseconds lateness) {
+      play_song_event(event_pos, lateness);
+    });
+  player.set_end_handler([this] () {
+      end_song();
+    });
+  player.set_ready_check([this] (const unsigned int event_pos) {
+      // in practice mode, the player must play the expected keys first.
+      if (practice.is_matched(event_pos))
+      {
+	return true;
+      }
+      practice.wait_for_player();
+      return false;
+    });
 
-  connect(&signal_checker_timer, SIGNAL(timeout()), this, SLOT(look_for_signals_change()));
-  signal_checker_timer.start(100 /* ms */);
+  frame_timer.setSingleShot(true);
+  frame_timer.setTimerType(Qt::PreciseTimer);
+  connect(&frame_timer, SIGNAL(timeout()), this, SLOT(present_frame()));
+
+  connect(signal_notifier, SIGNAL(activated(int)), this, SLOT(look_for_signals_change()));
+
+  {
+    // statistics overlay, hidden by default. The counters are always updated,
+    // only printing them stops while it is hidden.
+    stats_label->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    stats_label->setAlignment(Qt::AlignLeft | Qt::AlignTop);
+    stats_dock->setWidget(stats_label);
+    addDockWidget(Qt::RightDockWidgetArea, stats_dock);
+    stats_dock->hide();
+
+    auto toggle = stats_dock->toggleViewAction();
+    toggle->setText("show statistics");
+    toggle->setShortcut(Qt::Key_F12);
+    ui->menuFile->addAction(toggle);
+
+    connect(&stats_timer, SIGNAL(timeout()), this, SLOT(update_stats_overlay()));
+    connect(stats_dock, &QDockWidget::visibilityChanged, this, [this] (const bool is_visible) {
+	if (is_visible)
+	{
+	  stats.clear();
+	  page_cache.take_sheet_rendering();
+	  stats_timer.start(1000);
+	}
+	else
+	{
+	  stats_timer.stop();
+	}
+      });
+  }
 
   sound_listener.setErrorCallback(&MainWindow::on_midi_input_error, nullptr);
   sound_player.setErrorCallback(&MainWindow::on_midi_output_error, nullptr);
@@ -739,12 +1394,26 @@ MainWindow::MainWindow(QWidget *parent) :
   sound_player.openVirtualPort();
   sound_listener.openVirtualPort();
 
+  {
+    // keep the port lists up to date as devices are plugged and unplugged
+    const auto announces_fd = get_midi_port_registry().get_notification_fd();
+    if (announces_fd >= 0)
+    {
+      auto port_announces = new QSocketNotifier(announces_fd, QSocketNotifier::Read, this);
+      connect(port_announces, &QSocketNotifier::activated, [] () {
+	  get_midi_port_registry().process_notifications();
+	});
+    }
+  }
+
   {
     // automatically open an output midi port if possible
-    const auto nb_ports = sound_player.getPortCount();
+    const auto& port_names = get_midi_port_registry().get_output_ports();
+    const auto nb_ports = static_cast<unsigned int>(port_names.size());
     if (nb_ports == 0)
     {
-      std::cerr << "Sorry: no output midi port found\n";
+      static log_site no_port_log (log_level::warning);
+      log_line(no_port_log) << "Sorry: no output midi port found";
     }
     else
     {
@@ -752,14 +1421,14 @@ MainWindow::MainWindow(QWidget *parent) :
       // port number 0 is usually "Midi Through 14:0" which seems to be a dummy.
       // avoid choosing the listening port as otherwise it creates the "inifinite movement" issue
       unsigned int port_to_use = (nb_ports == 1) ? 0 : 1;
-      while ((port_to_use < nb_ports) and begins_by(sound_player.getPortName(port_to_use), LILYPLAYER_VIRTUAL_MIDI_INPUT))
+      while ((port_to_use < nb_ports) and begins_by(port_names[port_to_use], LILYPLAYER_VIRTUAL_MIDI_INPUT))
       {
 	++port_to_use;
       }
       if (port_to_use < nb_ports)
       {
 	sound_player.openPort( port_to_use );
-	this->selected_output_port = sound_player.getPortName( port_to_use );
+	this->selected_output_port = port_names[port_to_use];
       }
     }
   }
@@ -783,8 +1452,9 @@ MainWindow::MainWindow(QWidget *parent) :
   }
 
   {
-    qRegisterMetaType<std::vector<unsigned char>>("std::vector<unsigned char>");
-    connect(this, SIGNAL(midi_message_received(std::vector<unsigned char>)), this, SLOT(handle_input_midi(std::vector<unsigned char>)));
+    // transposition, octave doubling, velocity, and mute, solo and channel of each staff
+    ui->menuBar->addMenu(transform_menu);
+    connect(transform_menu, SIGNAL(aboutToShow()), this, SLOT(update_transform_menu()));
   }
 
   {
@@ -794,10 +1464,6 @@ MainWindow::MainWindow(QWidget *parent) :
   {
     connect(this->ui->replay, SIGNAL(clicked()), this, SLOT(replay()));
   }
-
-  {
-    song_event_loop();
-  }
 }
 
 #if !defined(__clang__)
@@ -806,6 +1472,19 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+  if (recorder.is_active() and (recording_filename != ""))
+  {
+    try
+    {
+      stop_recording(recording_filename);
+    }
+    catch (std::exception& e)
+    {
+      static log_site recording_error_log (log_level::error);
+      log_line(recording_error_log) << e.what();
+    }
+  }
+
   clear_music_scheet();
   delete ui;
   sound_listener.closePort();
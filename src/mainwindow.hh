@@ -12,12 +12,34 @@
 
 #include <limits>
 #include <atomic>
+#include <functional>
+#include <future>
+#include <mutex>
 
 #include <rtmidi/RtMidi.h>
 
 #include "utils.hh"
 #include "keyboard.hh"
+#include "music_sheet_layout.hh"
 #include "bin_file_reader.hh"
+#include "spsc_ring_buffer.hh"
+#include "midi_stream_parser.hh"
+#include "frame_presenter.hh"
+#include "page_raster_cache.hh"
+#include "page_store.hh"
+#include "playlist.hh"
+#include "score_library.hh"
+#include "chord_matcher.hh"
+#include "latency_histogram.hh"
+#include "midi_recorder.hh"
+#include "playback_stats.hh"
+#include "memory_footprint.hh"
+#include "playback_clock.hh"
+#include "song_scheduler.hh"
+#include "song_player.hh"
+#include "playback_timer.hh"
+#include "qt_playback_timer.hh"
+#include "midi_transform.hh"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Weffc++" // Qt is not effective-C++ friendy
@@ -30,6 +52,10 @@ namespace Ui {
 
 class QGraphicsSvgItem;
 class QGraphicsRectItem;
+class QSocketNotifier;
+class QMenu;
+class QDockWidget;
+class QLabel;
 
 class MainWindow : public QMainWindow
 {
@@ -37,74 +63,137 @@ class MainWindow : public QMainWindow
 
   public:
     explicit MainWindow(QWidget *parent = nullptr);
+    // songs are played at the times read from clock, waiting on timer in
+    // between, instead of the steady clock and a QTimer.
+    MainWindow(const playback_clock& clock, playback_timer& timer, QWidget *parent = nullptr);
     ~MainWindow() override;
     void open_file(const std::string& filename);
+    // plays the file once the songs before it in the playlist are over
+    void add_to_playlist(const std::string& filename);
+    // indexes the directory in the background, then shows its scores
+    void browse_library(const std::string& dir);
+    // records the keys played on the input. If filename isn't empty, the
+    // recording is saved there when it stops or the window closes.
+    void start_recording(const std::string& filename);
     void set_output_port(const unsigned int i);
     void set_input_port(const unsigned int i);
+    // memory budget of each of the parsed and the rasterised music sheet pages
+    void set_sheet_memory_budget(const std::size_t budget);
+    // memory a song may take once loaded. Songs above are loaded without
+    // their music sheet, or refused if even their events don't fit.
+    void set_song_memory_budget(const std::size_t budget);
+    // chord_matcher::NO_STAFF to play the song without waiting for the player
+    void set_practice_staff(const unsigned int staff);
+    // where the midi messages go. By default, to the output port if it is open.
+    void set_midi_output(std::function<void(const uint8_t* bytes, std::size_t size)> output);
+    // how the keys of the song are turned into midi messages
+    void set_midi_transform(const midi_transform& new_transform);
 
   private:
+    MainWindow(const playback_clock* clock, playback_timer* timer, QWidget *parent);
     void pause_music();
+    void resume_music();
     void stop_song();
     void close_input_port();
     void clear_music_scheet();
-    void process_music_sheet_event(const music_sheet_event& keys_event);
+    void install_song(prepared_song&& prepared);
+    void play_next_song(); // skips the ones failing to load
+    void stop_recording(const std::string& filename); // throws if it can't be saved
+    void process_music_sheet_event(const unsigned int event_pos);
     void display_music_sheet(const unsigned music_sheet_pos);
+    void display_cursor(const music_sheet_event& event);
+    void schedule_frame(); // presents the pending changes at the next display refresh
+    void play_song_event(const unsigned int event_pos, const std::chrono::nanoseconds lateness);
+    void end_song(); // goes on with the playlist, or stops
     void keyPressEvent(QKeyEvent * event) override;
-    static void on_midi_input(double timestamp __attribute__((unused)), std::vector<unsigned char> *message, void* param);
+    static void on_midi_input(double timestamp, std::vector<unsigned char> *message, void* param);
     static void on_midi_error(RtMidiError::Type type, const std::string &errorText, const char* const direction);
     static void on_midi_input_error(RtMidiError::Type type, const std::string &errorText, void* param __attribute__((unused)));
     static void on_midi_output_error(RtMidiError::Type type, const std::string &errorText, void* param __attribute__((unused)));
 
     void process_keyboard_event(const std::vector<key_down>& keys_down,
-				const std::vector<key_up>& keys_up,
-				const std::vector<midi_message_t>& messages);
-
-
-  signals:
-    void midi_message_received(std::vector<unsigned char> bytes);
+				const std::vector<key_up>& keys_up);
+    void send_midi_messages(const std::vector<short_midi_message>& messages);
 
   private slots:
-    void song_event_loop();
     void replay();
     void open_file(); // open the window dialog to select a file
-    void look_for_signals_change();
+    void queue_files(); // open the window dialog to add files to the playlist
+    void choose_library(); // open the window dialog to select the library directory
+    void show_library(); // called once the library has been scanned
+    void toggle_recording(); // asks where to save it when it stops
+    void look_for_signals_change(); // handles the pending signals
     void output_port_change();
     void update_output_ports();
     void update_input_entries();
+    void update_transform_menu();
     void input_change();
-    void handle_input_midi(const std::vector<unsigned char> bytes);
+    void handle_input_midi(); // processes all the messages in input_messages
     void sub_sequence_click();
+    void present_frame();
+    void update_music_sheet(); // repaints it once a page is rasterised
+    void update_stats_overlay(); // called every second while the overlay is shown
 
   private:
-    static constexpr const unsigned int INVALID_SONG_POS = std::numeric_limits<unsigned int>::max();
-
-  private:
-    struct sheet_property
-    {
-	QSvgRenderer* rendered;
-	std::string svg_first_line;
-    };
-
     Ui::MainWindow *ui;
     QGraphicsScene *keyboard_scene;
-    keys_rects keyboard;
+    keyboard_item* keyboard; // owned by keyboard_scene
     QGraphicsScene *music_sheet_scene;
-    std::vector<sheet_property> rendered_sheets;
+    page_store sheet_pages;
     QRectF current_page_viewbox;
     QSvgRenderer* cursor_rect;
     QGraphicsSvgItem* svg_rect;
-    QTimer signal_checker_timer;
+    QSocketNotifier* signal_notifier; // readable when a signal is pending
+    steady_playback_clock steady_time; // unless another clock is given
+    qt_playback_timer qt_song_timer; // unless another timer is given
+    const playback_clock& playback_time;
+    playback_timer& song_timer; // only running while a song is being played
+    QTimer frame_timer;
+    frame_presenter presenter;
+    page_raster_cache page_cache;
+    std::size_t sheet_memory_budget;
+    std::size_t song_memory_budget;
+    playlist next_songs;
     bin_song_t song;
     RtMidiOut sound_player;
     RtMidiIn  sound_listener;
+    std::function<void(const uint8_t* bytes, std::size_t size)> midi_output;
+    midi_transform transform;
+    QMenu* transform_menu; // owned by the window, and shown in the menu bar
     std::string selected_output_port = "";
     std::string selected_input_port = "";
 
-
-    unsigned int start_pos = INVALID_SONG_POS;
-    unsigned int stop_pos = INVALID_SONG_POS;
-    unsigned int song_pos = INVALID_SONG_POS;
-    std::atomic<bool> is_in_pause;
+    song_scheduler scheduler; // when to play the events of song
+    song_player player; // plays the events of scheduler on song_timer
+    chord_matcher practice;
+    QMenu* practice_menu; // owned by the window, and shown in the input menu
+
+    // messages received by the RtMidi thread, waiting to be processed by the
+    // gui thread. Only one wake-up is posted for all the messages arriving
+    // before the gui thread gets to process them.
+    spsc_ring_buffer<input_midi_message> input_messages;
+    std::atomic<bool> is_input_processing_scheduled;
+    std::atomic<uint64_t> nb_dropped_input_messages;
+    midi_stream_parser input_parser;
+    latency_histogram input_display_latencies;
+    int64_t oldest_undisplayed_input; // reception time in ns of the first key not displayed yet, 0 if none
+    midi_recorder recorder;
+    std::string recording_filename;
+
+    playback_stats stats;
+    memory_footprint song_footprint; // of the song only, the pages are counted when shown
+    QDockWidget* stats_dock; // owned by the window
+    QLabel* stats_label; // owned by stats_dock
+    QTimer stats_timer; // only running while the overlay is shown
+
+    score_library library;
+    std::string library_dir;
+
+    // the scores read by the last scan, handed over to show_library
+    std::mutex scanned_scores_mutex;
+    std::vector<score_info> scanned_scores;
+    std::string scan_error; // empty if the scores could be read
+    std::future<void> library_scan; // last, as it uses library
 };
 
 #pragma GCC diagnostic pop
@@ -0,0 +1,60 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring> // for std::strerror
+
+#include "mapped_file.hh"
+
+mapped_file::mapped_file(const std::string& filename)
+  : mapping(nullptr)
+  , mapping_size(0)
+{
+  const auto fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+  {
+    throw std::runtime_error(std::string{"Error: unable to open file ["} + filename + "] ("
+			     + std::strerror(errno) + ")");
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == -1)
+  {
+    const auto err = errno;
+    close(fd);
+    throw std::runtime_error(std::string{"Error: unable to read file ["} + filename + "] ("
+			     + std::strerror(err) + ")");
+  }
+
+  mapping_size = static_cast<std::size_t>(file_stat.st_size);
+  if (mapping_size == 0)
+  {
+    // mmap refuses empty mappings, an empty file is simply an empty buffer.
+    close(fd);
+    return;
+  }
+
+  mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  const auto err = errno;
+  close(fd);
+
+  if (mapping == MAP_FAILED)
+  {
+    mapping = nullptr;
+    mapping_size = 0;
+    throw std::runtime_error(std::string{"Error: unable to map file ["} + filename + "] in memory ("
+			     + std::strerror(err) + ")");
+  }
+
+  // the content is read sequentially from the beginning to the end.
+  madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+}
+
+mapped_file::~mapped_file()
+{
+  if (mapping != nullptr)
+  {
+    munmap(mapping, mapping_size);
+  }
+}
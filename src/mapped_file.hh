@@ -0,0 +1,78 @@
+#ifndef MAPPED_FILE_HH
+#define MAPPED_FILE_HH
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <stdexcept>
+
+// Read-only memory mapping of a whole file. Parts of the file that are
+// never accessed (e.g. skipped music sheet pages) are never read from the disk.
+class mapped_file
+{
+  public:
+    explicit mapped_file(const std::string& filename);
+    ~mapped_file();
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    const uint8_t* data() const
+    {
+      return static_cast<const uint8_t*>(mapping);
+    }
+
+    std::size_t size() const
+    {
+      return mapping_size;
+    }
+
+  private:
+    void* mapping;
+    std::size_t mapping_size;
+};
+
+// Sequential reader of big endian values from a memory buffer.
+struct byte_reader
+{
+    byte_reader(const uint8_t* const begin, const std::size_t size)
+      : pos(begin)
+      , end(begin + size)
+    {
+    }
+
+    std::size_t remaining() const
+    {
+      return static_cast<std::size_t>(end - pos);
+    }
+
+    // returns the position of the skipped bytes
+    const uint8_t* skip(const std::size_t nb_bytes)
+    {
+      if (remaining() < nb_bytes)
+      {
+	throw std::invalid_argument("Error: invalid file (unexpected end of file)");
+      }
+
+      const auto res = pos;
+      pos += nb_bytes;
+      return res;
+    }
+
+    template <typename T>
+    T read_big_endian()
+    {
+      const auto bytes = skip(sizeof(T));
+      T res = 0;
+      for (unsigned int i = 0; i < sizeof(T); ++i)
+      {
+	res = static_cast<T>( (res << 8) | bytes[i] );
+      }
+      return res;
+    }
+
+    const uint8_t* pos;
+    const uint8_t* end;
+};
+
+#endif /* MAPPED_FILE_HH */
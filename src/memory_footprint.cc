@@ -0,0 +1,78 @@
+#include <ostream>
+
+#include "memory_footprint.hh"
+#include "page_store.hh"
+#include "log.hh"
+
+std::size_t memory_footprint::total() const
+{
+  return events + key_vectors + cursor_boxes + raw_pages +
+    compressed_pages + parsed_pages + rasterised_pages;
+}
+
+static std::size_t get_key_vectors_footprint(const music_sheet_event& event)
+{
+  return event.keys_down.capacity() * sizeof(key_down) + event.keys_up.capacity() * sizeof(key_up);
+}
+
+static std::size_t get_cursor_box_footprint(const music_sheet_event& event)
+{
+  return static_cast<std::size_t>(event.new_cursor_box.capacity());
+}
+
+std::size_t get_event_footprint(const music_sheet_event& event)
+{
+  return get_key_vectors_footprint(event) + get_cursor_box_footprint(event);
+}
+
+void add_song_footprint(const bin_song_t& song, memory_footprint& footprint)
+{
+  footprint.events += song.events.capacity() * sizeof(music_sheet_event);
+  for (const auto& event : song.events)
+  {
+    footprint.key_vectors += get_key_vectors_footprint(event);
+    footprint.cursor_boxes += get_cursor_box_footprint(event);
+  }
+
+  for (const auto& page : song.svg_files)
+  {
+    footprint.raw_pages += page.data.capacity();
+  }
+}
+
+void add_pages_footprint(const page_store& pages, memory_footprint& footprint)
+{
+  footprint.compressed_pages += pages.get_compressed_size();
+  footprint.parsed_pages += pages.get_parsed_size();
+}
+
+void print_memory_footprint(const memory_footprint& footprint, std::ostream& out)
+{
+  const auto print = [&out] (const char* const name, const std::size_t nb_bytes) {
+    out << name << ": " << (static_cast<double>(nb_bytes) / (1024.0 * 1024.0)) << " MiB\n";
+  };
+
+  print("events", footprint.events);
+  print("key vectors", footprint.key_vectors);
+  print("cursor boxes", footprint.cursor_boxes);
+  print("raw pages", footprint.raw_pages);
+  print("compressed pages", footprint.compressed_pages);
+  print("parsed pages", footprint.parsed_pages);
+  print("rasterised pages", footprint.rasterised_pages);
+  print("total", footprint.total());
+}
+
+bin_song_t get_song_within_budget(const std::string& filename, const std::size_t memory_budget)
+{
+  try
+  {
+    return get_song(filename, music_sheet_loading::parse, memory_budget);
+  }
+  catch (memory_budget_exceeded&)
+  {
+    static log_site over_budget_log (log_level::warning);
+    log_line(over_budget_log) << "Warning: " << filename << " needs more than the memory budget, it is played without its music sheet";
+  }
+
+  return get_song(filename, music_sheet_loading::skip, memory_budget);
+}
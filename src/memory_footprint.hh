@@ -0,0 +1,51 @@
+#ifndef MEMORY_FOOTPRINT_HH
+#define MEMORY_FOOTPRINT_HH
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+#include "bin_file_reader.hh"
+
+class page_store;
+
+// Memory taken by a song and its music sheet, in bytes, per kind of data.
+struct memory_footprint
+{
+    memory_footprint()
+      : events(0)
+      , key_vectors(0)
+      , cursor_boxes(0)
+      , raw_pages(0)
+      , compressed_pages(0)
+      , parsed_pages(0)
+      , rasterised_pages(0)
+    {
+    }
+
+    std::size_t events; // the music_sheet_event themselves
+    std::size_t key_vectors; // keys_down and keys_up
+    std::size_t cursor_boxes; // svg of the cursor of each event
+    std::size_t raw_pages; // svg pages as read from the file
+    std::size_t compressed_pages;
+    std::size_t parsed_pages; // estimation of the svg renderers
+    std::size_t rasterised_pages;
+
+    std::size_t total() const __attribute__((pure));
+};
+
+// memory owned by the event, not counting sizeof(music_sheet_event)
+std::size_t get_event_footprint(const music_sheet_event& event) __attribute__((pure));
+
+void add_song_footprint(const bin_song_t& song, memory_footprint& footprint);
+void add_pages_footprint(const page_store& pages, memory_footprint& footprint);
+
+// one line per kind of data, in MiB
+void print_memory_footprint(const memory_footprint& footprint, std::ostream& out);
+
+// reads the song with its music sheet if it fits in the memory budget, or
+// only its keyboard events otherwise. Throws memory_budget_exceeded if even
+// these don't fit.
+bin_song_t get_song_within_budget(const std::string& filename, std::size_t memory_budget);
+
+#endif /* MEMORY_FOOTPRINT_HH */
@@ -0,0 +1,549 @@
+#include <algorithm>
+#include <cstring> // for std::memcmp
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "midi_file_reader.hh"
+#include "mapped_file.hh"
+#include "memory_footprint.hh"
+#include "trace_events.hh"
+#include "utils.hh"
+
+static constexpr const uint8_t DRUMS_CHANNEL = 9; // channel 10 when counting from 1
+static constexpr const uint64_t DEFAULT_US_PER_QUARTER_NOTE = 500'000; // 120 beats per minute
+static constexpr const uint8_t NO_STAFF = 0xFF;
+
+// a group of events holds at most 255 events, the first one may set the bar number.
+static constexpr const std::size_t MAX_KEYS_PER_EVENT = 254;
+
+bool is_standard_midi_file(const uint8_t* const data, const std::size_t size)
+{
+  const char header[4] = { 'M', 'T', 'h', 'd' };
+  return (size >= sizeof(header)) and (std::memcmp(data, header, sizeof(header)) == 0);
+}
+
+static uint32_t read_variable_length(byte_reader& data)
+{
+  uint32_t res = 0;
+  for (int i = 0; i < 4; ++i)
+  {
+    const auto byte = data.read_big_endian<uint8_t>();
+    res = (res << 7) | static_cast<uint32_t>(byte & 0x7F);
+    if ((byte & 0x80) == 0)
+    {
+      return res;
+    }
+  }
+
+  throw std::invalid_argument("Error: invalid midi file (variable length quantity longer than 4 bytes)");
+}
+
+enum class track_event_kind : uint8_t
+{
+  note_on,
+  note_off, // also produced by a note on with a velocity of 0
+  tempo,
+  time_signature,
+  end_of_track,
+};
+
+struct track_event
+{
+    uint64_t tick; // since the beginning of the song
+    track_event_kind kind;
+    uint8_t channel;
+    uint8_t data1; // pitch, or numerator of the time signature
+    uint8_t data2; // velocity, or denominator of the time signature as a power of 2
+    uint32_t tempo; // us per quarter note
+};
+
+// Reads the events of a track chunk one at a time, straight from the file.
+// The events which don't change what is played or when (controllers,
+// sysex, most meta events) are skipped over.
+struct track_decoder
+{
+    track_decoder(const uint8_t* const begin, const std::size_t size)
+      : data(begin, size)
+      , running_status(0)
+      , is_over(false)
+      , name(nullptr)
+      , name_size(0)
+      , event()
+    {
+    }
+
+    // false once the end of the track is reached
+    bool read_next();
+
+    byte_reader data;
+    uint8_t running_status; // 0 if none
+    bool is_over;
+    const uint8_t* name; // of the track, in the file
+    uint32_t name_size;
+    track_event event;
+};
+
+bool track_decoder::read_next()
+{
+  while ((not is_over) and (data.remaining() != 0))
+  {
+    event.tick += read_variable_length(data);
+
+    auto status = data.read_big_endian<uint8_t>();
+    if (status < 0x80)
+    {
+      // running status: this is the first data byte of the message
+      if (running_status == 0)
+      {
+	throw std::invalid_argument("Error: invalid midi file (data byte without status)");
+      }
+
+      --data.pos;
+      status = running_status;
+    }
+
+    if (status < 0xF0)
+    {
+      running_status = status;
+      event.channel = static_cast<uint8_t>(status & 0x0F);
+      switch (status & 0xF0)
+      {
+	case 0x80:
+	case 0x90:
+	{
+	  event.data1 = static_cast<uint8_t>(data.read_big_endian<uint8_t>() & 0x7F);
+	  event.data2 = static_cast<uint8_t>(data.read_big_endian<uint8_t>() & 0x7F);
+	  const auto is_pressed = ((status & 0xF0) == 0x90) and (event.data2 != 0);
+	  event.kind = is_pressed ? track_event_kind::note_on : track_event_kind::note_off;
+	  return true;
+	}
+
+	case 0xC0: // program change
+	case 0xD0: // channel pressure
+	  data.skip(1);
+	  break;
+
+	default:
+	  data.skip(2);
+	  break;
+      }
+      continue;
+    }
+
+    // sysex and meta events cancel the running status
+    running_status = 0;
+    if ((status == 0xF0) or (status == 0xF7))
+    {
+      data.skip(read_variable_length(data));
+      continue;
+    }
+
+    if (status != 0xFF)
+    {
+      throw std::invalid_argument("Error: invalid midi file (unknown event in a track)");
+    }
+
+    const auto type = data.read_big_endian<uint8_t>();
+    const auto size = read_variable_length(data);
+    const auto content = data.skip(size);
+    switch (type)
+    {
+      case 0x03: // track name
+	if (name_size == 0)
+	{
+	  name = content;
+	  name_size = size;
+	}
+	break;
+
+      case 0x2F:
+	event.kind = track_event_kind::end_of_track;
+	is_over = true;
+	return true;
+
+      case 0x51:
+	if (size >= 3)
+	{
+	  event.kind = track_event_kind::tempo;
+	  event.tempo = (uint32_t{content[0]} << 16) | (uint32_t{content[1]} << 8) | content[2];
+	  return true;
+	}
+	break;
+
+      case 0x58:
+	if (size >= 2)
+	{
+	  event.kind = track_event_kind::time_signature;
+	  event.data1 = content[0];
+	  event.data2 = content[1];
+	  return true;
+	}
+	break;
+
+      default:
+	break;
+    }
+  }
+
+  return false;
+}
+
+// Converts the ticks into ns since the beginning of the song. A tick lasts
+// tick_ns_num / tick_ns_den ns, which changes with the tempo unless the
+// ticks are frames subdivisions.
+struct tempo_map
+{
+    uint64_t get_time(const uint64_t tick) const
+    {
+      // divided first, as the product overflows for long delays: the
+      // numerator goes up to 1e11 ns for the SMPTE divisions. The remainder
+      // is below the denominator, at most 3.2e6, so its product fits.
+      const auto nb_ticks = tick - tick_of_change;
+      return time_of_change + (nb_ticks / tick_ns_den) * tick_ns_num + (nb_ticks % tick_ns_den) * tick_ns_num / tick_ns_den;
+    }
+
+    void set_tempo(const uint64_t tick, const uint32_t us_per_quarter_note)
+    {
+      if (is_smpte)
+      {
+	return;
+      }
+
+      time_of_change = get_time(tick);
+      tick_of_change = tick;
+      tick_ns_num = uint64_t{us_per_quarter_note} * 1000;
+    }
+
+    bool is_smpte;
+    uint64_t tick_of_change;
+    uint64_t time_of_change;
+    uint64_t tick_ns_num;
+    uint64_t tick_ns_den;
+};
+
+// The bar number of each tick, following the time signature changes.
+struct measure_map
+{
+    uint16_t get_bar_number(const uint64_t tick)
+    {
+      if (tick >= measure_start + measure_length)
+      {
+	const auto nb_measures = (tick - measure_start) / measure_length;
+	measure_start += nb_measures * measure_length;
+	bar_number = static_cast<uint16_t>(std::min(bar_number + nb_measures, uint64_t{0xFFFF}));
+      }
+
+      return bar_number;
+    }
+
+    // a time signature changing in the middle of a measure starts a new one
+    void set_measure_length(const uint64_t tick, const uint64_t length)
+    {
+      if (length == 0)
+      {
+	return;
+      }
+
+      if (tick != measure_start)
+      {
+	get_bar_number(tick);
+	if (tick != measure_start)
+	{
+	  measure_start = tick;
+	  bar_number = static_cast<uint16_t>(std::min(uint32_t{bar_number} + 1, uint32_t{0xFFFF}));
+	}
+      }
+      measure_length = length;
+    }
+
+    uint64_t measure_start; // tick
+    uint64_t measure_length; // in ticks
+    uint16_t bar_number;
+};
+
+// Groups the keys played at the same time into events. A key changes at
+// most once per event, so that the order of the changes at a same tick is
+// kept.
+class song_events_builder
+{
+  public:
+    explicit song_events_builder(const std::size_t budget)
+      : events()
+      , last_event_of_pitch()
+      , nb_presses()
+      , bar_number(0)
+      , memory_usage(0)
+      , memory_budget(budget)
+    {
+    }
+
+    void press_key(const uint64_t time, const uint16_t bar, const uint8_t pitch, const uint8_t staff_num,
+		   const uint8_t velocity)
+    {
+      // the key is pressed again before being released: release it first so that it is heard again
+      if (nb_presses[pitch] != 0)
+      {
+	get_event(time, bar, pitch).keys_up.emplace_back(pitch);
+      }
+
+      get_event(time, bar, pitch).keys_down.emplace_back(pitch, staff_num, velocity);
+      nb_presses[pitch] = static_cast<uint16_t>(std::min(uint32_t{nb_presses[pitch]} + 1, uint32_t{0xFFFF}));
+    }
+
+    // the key is only released once all its presses are
+    void release_key(const uint64_t time, const uint16_t bar, const uint8_t pitch)
+    {
+      if (nb_presses[pitch] == 0)
+      {
+	return;
+      }
+
+      --nb_presses[pitch];
+      if (nb_presses[pitch] == 0)
+      {
+	get_event(time, bar, pitch).keys_up.emplace_back(pitch);
+      }
+    }
+
+    // releases the keys still pressed at the end of the song
+    std::vector<music_sheet_event> finish(const uint64_t time, const uint16_t bar)
+    {
+      for (uint8_t pitch = 0; pitch < 128; ++pitch)
+      {
+	if (nb_presses[pitch] != 0)
+	{
+	  nb_presses[pitch] = 1;
+	  release_key(time, bar, pitch);
+	}
+      }
+
+      close_last_event();
+      return std::move(events);
+    }
+
+  private:
+    music_sheet_event& get_event(const uint64_t time, const uint16_t bar, const uint8_t pitch)
+    {
+      const auto is_new_event = events.empty() or (events.back().time != time) or
+	(last_event_of_pitch[pitch] == events.size()) or
+	(events.back().keys_down.size() + events.back().keys_up.size() >= MAX_KEYS_PER_EVENT);
+      if (is_new_event)
+      {
+	close_last_event();
+	events.emplace_back();
+	events.back().time = time;
+	if (bar != bar_number)
+	{
+	  events.back().add_bar_number_change(bar);
+	  bar_number = bar;
+	}
+      }
+
+      last_event_of_pitch[pitch] = events.size();
+      return events.back();
+    }
+
+    void close_last_event()
+    {
+      if (events.empty())
+      {
+	return;
+      }
+
+      memory_usage += sizeof(music_sheet_event) + get_event_footprint(events.back());
+      check_memory_budget(memory_usage, memory_budget);
+    }
+
+    std::vector<music_sheet_event> events;
+    std::size_t last_event_of_pitch[128]; // number of events when the key last changed, 0 if never
+    uint16_t nb_presses[128];
+    uint16_t bar_number; // of the last event
+    std::size_t memory_usage;
+    std::size_t memory_budget;
+};
+
+bin_song_t get_song_from_standard_midi_file(const uint8_t* const data, const std::size_t size, const std::size_t memory_budget)
+{
+  trace_span span ("get_song/standard_midi_file");
+  byte_reader file(data, size);
+
+  if (not is_standard_midi_file(data, size))
+  {
+    throw std::invalid_argument("Error: wrong file format (wrong header)");
+  }
+  file.skip(4);
+
+  const auto header_size = file.read_big_endian<uint32_t>();
+  if (header_size < 6)
+  {
+    throw std::invalid_argument("Error: invalid midi file (header too short)");
+  }
+
+  const auto format = file.read_big_endian<uint16_t>();
+  const auto nb_tracks = file.read_big_endian<uint16_t>();
+  const auto division = file.read_big_endian<uint16_t>();
+  file.skip(header_size - 6);
+
+  if (format > 1)
+  {
+    throw std::invalid_argument("Error: only the midi files of format 0 and 1 can be played");
+  }
+
+  // the tick duration either follows the tempo (ticks per quarter note),
+  // or is a fixed subdivision of a frame. Without time signature, the
+  // measures of the latter are those of a 4/4 at 120 beats per minute.
+  tempo_map tempo { false, 0, 0, DEFAULT_US_PER_QUARTER_NOTE * 1000, division };
+  measure_map measures { 0, uint64_t{division} * 4, 1 };
+  const auto is_smpte = (division & 0x8000) != 0;
+  if (is_smpte)
+  {
+    const auto frames_per_second = -static_cast<int8_t>(division >> 8);
+    const auto ticks_per_frame = uint64_t{static_cast<uint8_t>(division)};
+    // 29 means 29.97 frames per second
+    const auto hundredth_frames_per_second = (frames_per_second == 29) ? uint64_t{2997} : uint64_t{static_cast<uint8_t>(frames_per_second)} * 100;
+    const auto hundredth_ticks_per_second = hundredth_frames_per_second * ticks_per_frame;
+    tempo = tempo_map{ true, 0, 0, 100'000'000'000, hundredth_ticks_per_second };
+    measures = measure_map{ 0, hundredth_ticks_per_second * 2 / 100, 1 };
+  }
+
+  if ((tempo.tick_ns_den == 0) or (measures.measure_length == 0))
+  {
+    throw std::invalid_argument("Error: invalid midi file (null time division)");
+  }
+
+  // the track chunks are decoded in place. Other chunks are to be ignored.
+  std::vector<track_decoder> tracks;
+  tracks.reserve(nb_tracks);
+  while (file.remaining() != 0)
+  {
+    const auto chunk_type = file.skip(4);
+    const auto chunk_size = file.read_big_endian<uint32_t>();
+    const auto chunk = file.skip(chunk_size);
+    if (std::memcmp(chunk_type, "MTrk", 4) == 0)
+    {
+      tracks.emplace_back(chunk, chunk_size);
+    }
+  }
+
+  if ((tracks.size() != nb_tracks) or ((format == 0) and (nb_tracks != 1)))
+  {
+    throw std::invalid_argument("Error: invalid midi file (wrong number of tracks)");
+  }
+
+  // staffs are numbered in the order they start playing
+  std::vector<uint8_t> staff_of_source((format == 0) ? 16 : tracks.size(), NO_STAFF);
+  std::vector<std::size_t> source_of_staff;
+
+  // k-way merge of the tracks: the heap holds the tracks having an event,
+  // the earliest event first. Events at the same tick come in track order,
+  // so that the tempo track changes the tempo before the notes are played.
+  const auto is_later = [&tracks] (const std::size_t a, const std::size_t b) {
+    return (tracks[a].event.tick > tracks[b].event.tick) or
+      ((tracks[a].event.tick == tracks[b].event.tick) and (a > b));
+  };
+
+  std::vector<std::size_t> heap;
+  heap.reserve(tracks.size());
+  for (auto i = decltype(tracks.size()){0}; i < tracks.size(); ++i)
+  {
+    if (tracks[i].read_next())
+    {
+      heap.push_back(i);
+    }
+  }
+  std::make_heap(heap.begin(), heap.end(), is_later);
+
+  song_events_builder builder(memory_budget);
+  uint64_t last_tick = 0;
+  while (not heap.empty())
+  {
+    std::pop_heap(heap.begin(), heap.end(), is_later);
+    const auto track_pos = heap.back();
+    heap.pop_back();
+
+    const auto& event = tracks[track_pos].event;
+    last_tick = event.tick;
+    switch (event.kind)
+    {
+      case track_event_kind::note_on:
+      {
+	if (event.channel == DRUMS_CHANNEL)
+	{
+	  break;
+	}
+
+	const auto source = (format == 0) ? std::size_t{event.channel} : track_pos;
+	if (staff_of_source[source] == NO_STAFF)
+	{
+	  if (source_of_staff.size() == NO_STAFF)
+	  {
+	    throw std::invalid_argument("Error: too many instruments in the midi file");
+	  }
+
+	  staff_of_source[source] = static_cast<uint8_t>(source_of_staff.size());
+	  source_of_staff.push_back(source);
+	}
+
+	builder.press_key(tempo.get_time(event.tick), measures.get_bar_number(event.tick), event.data1, staff_of_source[source],
+			  event.data2);
+	break;
+      }
+
+      case track_event_kind::note_off:
+	if (event.channel != DRUMS_CHANNEL)
+	{
+	  builder.release_key(tempo.get_time(event.tick), measures.get_bar_number(event.tick), event.data1);
+	}
+	break;
+
+      case track_event_kind::tempo:
+	if (event.tempo != 0)
+	{
+	  tempo.set_tempo(event.tick, event.tempo);
+	}
+	break;
+
+      case track_event_kind::time_signature:
+	if ((not is_smpte) and (event.data2 < 16))
+	{
+	  measures.set_measure_length(event.tick, (uint64_t{event.data1} * 4 * division) >> event.data2);
+	}
+	break;
+
+      case track_event_kind::end_of_track:
+      default:
+	break;
+    }
+
+    if (tracks[track_pos].read_next())
+    {
+      heap.push_back(track_pos);
+      std::push_heap(heap.begin(), heap.end(), is_later);
+    }
+  }
+
+  bin_song_t res;
+  res.events = builder.finish(tempo.get_time(last_tick), measures.get_bar_number(last_tick));
+  if (res.events.empty())
+  {
+    throw std::invalid_argument("Error: the midi file doesn't play any note");
+  }
+  res.nb_events = res.events.size();
+
+  for (const auto source : source_of_staff)
+  {
+    const auto& track = tracks[(format == 0) ? 0 : source];
+    if ((format == 1) and (track.name_size != 0))
+    {
+      res.instr_names.emplace_back(static_cast<const char*>(static_cast<const void*>(track.name)), track.name_size);
+    }
+    else
+    {
+      res.instr_names.emplace_back(((format == 0) ? "Channel " : "Track ") + std::to_string(source + 1));
+    }
+  }
+
+  span.set_arg("nb_events", static_cast<int64_t>(res.events.size()));
+  return res;
+}
@@ -0,0 +1,21 @@
+#ifndef MIDI_FILE_READER_HH
+#define MIDI_FILE_READER_HH
+
+#include <cstddef>
+#include <cstdint>
+
+#include "bin_file_reader.hh"
+
+// whether the data starts like a standard midi file
+bool is_standard_midi_file(const uint8_t* data, std::size_t size) __attribute__((pure));
+
+// Converts a standard midi file (format 0 or 1) into a song without music
+// sheet. Each track playing notes becomes a staff (each channel for format
+// 0), the tempo changes are applied to the event times, and a bar number
+// change is added at the first event of each measure. The tracks are
+// decoded in a single pass, and merged in time order as they are read.
+// Drums (channel 10) are left out, as they can't be shown on a keyboard.
+// memory_budget is the same as get_song's.
+bin_song_t get_song_from_standard_midi_file(const uint8_t* data, std::size_t size, std::size_t memory_budget);
+
+#endif /* MIDI_FILE_READER_HH */
@@ -0,0 +1,220 @@
+#include <stdexcept>
+#include <algorithm>
+
+#include "midi_file_writer.hh"
+#include "bin_file_writer.hh"
+#include "parallel_for.hh"
+#include "utils.hh"
+
+// The timestamps are stored in ns, independently of the tempo of the piece.
+// Using a fixed tempo makes one tick a fixed duration (100us).
+static constexpr const uint16_t ticks_per_quarter_note = 5000;
+static constexpr const uint32_t us_per_quarter_note = 500'000; // 120 beats per minute
+static constexpr const uint64_t ns_per_tick = uint64_t{us_per_quarter_note} * 1000 / ticks_per_quarter_note;
+
+// biggest value representable in a variable length quantity
+static constexpr const uint32_t max_variable_length_value = 0x0FFFFFFF;
+
+template <typename T>
+static void write_big_endian(std::vector<uint8_t>& out, const T value)
+{
+  for (auto i = sizeof(T); i > 0; --i)
+  {
+    out.push_back(static_cast<uint8_t>(value >> ((i - 1) * 8)));
+  }
+}
+
+static void write_variable_length(std::vector<uint8_t>& out, const uint32_t value)
+{
+  if (value > max_variable_length_value)
+  {
+    throw std::runtime_error("Error: the song is too long to be stored in a midi file");
+  }
+
+  uint8_t buffer[4];
+  unsigned int nb_bytes = 0;
+  auto remaining = value;
+  do
+  {
+    buffer[nb_bytes] = static_cast<uint8_t>(remaining & 0x7F);
+    remaining >>= 7;
+    ++nb_bytes;
+  } while (remaining != 0);
+
+  while (nb_bytes > 1)
+  {
+    --nb_bytes;
+    out.push_back(static_cast<uint8_t>(buffer[nb_bytes] | 0x80));
+  }
+  out.push_back(buffer[0]);
+}
+
+struct smf_track
+{
+    smf_track()
+      : data()
+      , last_tick(0)
+    {
+    }
+
+    void add_delta_time(const uint64_t tick)
+    {
+      write_variable_length(data, static_cast<uint32_t>(std::min(tick - last_tick,
+								 uint64_t{max_variable_length_value} + 1)));
+      last_tick = tick;
+    }
+
+    void add_midi_event(const uint64_t tick, const uint8_t status, const uint8_t data1, const uint8_t data2)
+    {
+      add_delta_time(tick);
+      data.push_back(status);
+      data.push_back(data1);
+      data.push_back(data2);
+    }
+
+    void add_meta_event(const uint64_t tick, const uint8_t type, const std::string& content)
+    {
+      add_delta_time(tick);
+      data.push_back(0xFF);
+      data.push_back(type);
+      write_variable_length(data, static_cast<uint32_t>(std::min(content.size(),
+								 std::size_t{max_variable_length_value} + 1)));
+      data.insert(data.end(), content.cbegin(), content.cend());
+    }
+
+    std::vector<uint8_t> data;
+    uint64_t last_tick;
+};
+
+static void append_track(std::vector<uint8_t>& out, smf_track& track)
+{
+  track.add_meta_event(track.last_tick, 0x2F /* end of track */, "");
+
+  const uint8_t chunk_type[4] = { 'M', 'T', 'r', 'k' };
+  out.insert(out.end(), std::begin(chunk_type), std::end(chunk_type));
+  write_big_endian(out, static_cast<uint32_t>(track.data.size()));
+  out.insert(out.end(), track.data.cbegin(), track.data.cend());
+}
+
+std::vector<uint8_t> get_standard_midi_file(const bin_song_t& song)
+{
+  // one track per staff. Staff numbers are supposed to be indexes in
+  // instr_names, but don't drop notes if it happens not to be the case.
+  std::size_t nb_staffs = song.instr_names.size();
+  for (const auto& event : song.events)
+  {
+    for (const auto& key : event.keys_down)
+    {
+      nb_staffs = std::max(nb_staffs, std::size_t{key.staff_num} + 1);
+    }
+  }
+
+  if (nb_staffs + 1 > std::numeric_limits<uint16_t>::max())
+  {
+    throw std::runtime_error("Error: too many staffs to be stored in a midi file");
+  }
+
+  smf_track tempo_track;
+  {
+    tempo_track.add_delta_time(0);
+    tempo_track.data.push_back(0xFF);
+    tempo_track.data.push_back(0x51); // set tempo
+    tempo_track.data.push_back(0x03);
+    tempo_track.data.push_back(static_cast<uint8_t>(us_per_quarter_note >> 16));
+    tempo_track.data.push_back(static_cast<uint8_t>(us_per_quarter_note >> 8));
+    tempo_track.data.push_back(static_cast<uint8_t>(us_per_quarter_note));
+  }
+
+  std::vector<smf_track> tracks(nb_staffs);
+  for (auto i = decltype(nb_staffs){0}; i < song.instr_names.size(); ++i)
+  {
+    tracks[i].add_meta_event(0, 0x03 /* track name */, song.instr_names[i]);
+  }
+
+  // key release events don't tell which staff releases the key. Use the
+  // one which pressed it.
+  uint8_t staff_of_pitch[128] = {};
+
+  for (const auto& event : song.events)
+  {
+    const auto tick = (event.time + ns_per_tick / 2) / ns_per_tick;
+
+    // releases come first so that a key released and pressed again at
+    // the same time is played again.
+    for (const auto& key : event.keys_up)
+    {
+      const auto pitch = static_cast<uint8_t>(key.pitch & 0x7F);
+      tracks[staff_of_pitch[pitch]].add_midi_event(tick, 0x80, pitch, 0);
+    }
+
+    for (const auto& key : event.keys_down)
+    {
+      const auto pitch = static_cast<uint8_t>(key.pitch & 0x7F);
+      staff_of_pitch[pitch] = key.staff_num;
+      tracks[key.staff_num].add_midi_event(tick, 0x90, pitch, static_cast<uint8_t>(key.velocity & 0x7F));
+    }
+  }
+
+  std::vector<uint8_t> res;
+  const uint8_t header[] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6 };
+  res.insert(res.end(), std::begin(header), std::end(header));
+  write_big_endian(res, uint16_t{1}); // format 1: several tracks played simultaneously
+  write_big_endian(res, static_cast<uint16_t>(nb_staffs + 1));
+  write_big_endian(res, ticks_per_quarter_note);
+
+  append_track(res, tempo_track);
+  for (auto& track : tracks)
+  {
+    append_track(res, track);
+  }
+
+  return res;
+}
+
+static std::string get_midi_filename(const std::string& bin_filename)
+{
+  constexpr const char bin_extension[] = ".bin";
+  constexpr const std::size_t bin_extension_size = sizeof(bin_extension) - 1;
+  const auto basename = ends_by(bin_filename, bin_extension) ? bin_filename.substr(0, bin_filename.size() - bin_extension_size)
+							     : bin_filename;
+  return basename + ".mid";
+}
+
+static void export_to_standard_midi_file(const std::string& bin_filename)
+{
+  const auto song = get_song(bin_filename, music_sheet_loading::skip);
+  const auto midi_file = get_standard_midi_file(song);
+
+  write_file(get_midi_filename(bin_filename), midi_file);
+}
+
+unsigned int export_to_standard_midi_files(const std::string& path, std::ostream& err_stream)
+{
+  const auto filenames = find_files(path, ".bin");
+  const auto nb_files = filenames.size();
+
+  // each thread only writes its own slot, errors are reported afterwards in order.
+  std::vector<std::string> errors(nb_files);
+  parallel_for(nb_files, [&] (const std::size_t i) {
+      try
+      {
+	export_to_standard_midi_file(filenames[i]);
+      }
+      catch (std::exception& e)
+      {
+	errors[i] = e.what();
+      }
+    });
+
+  unsigned int nb_failures = 0;
+  for (auto i = decltype(nb_files){0}; i < nb_files; ++i)
+  {
+    if (not errors[i].empty())
+    {
+      err_stream << filenames[i] << ": " << errors[i] << "\n";
+      ++nb_failures;
+    }
+  }
+
+  return nb_failures;
+}
@@ -0,0 +1,23 @@
+#ifndef MIDI_FILE_WRITER_HH
+#define MIDI_FILE_WRITER_HH
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "bin_file_reader.hh"
+
+// Converts the song into a standard midi file (format 1). The first track
+// only holds the tempo, followed by one track per staff named after its
+// instrument. The event times of the song must still be in ns since the
+// beginning of the song (i.e. as returned by get_song).
+std::vector<uint8_t> get_standard_midi_file(const bin_song_t& song);
+
+// Exports the .bin file, or all the .bin files found in the directory and
+// its subdirectories, into standard midi files written next to them with
+// a .mid extension. Files are processed in parallel.
+// Returns the number of files that couldn't be exported.
+unsigned int export_to_standard_midi_files(const std::string& path, std::ostream& err_stream);
+
+#endif /* MIDI_FILE_WRITER_HH */
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <cerrno>
+#include <ostream>
+#include <poll.h>
+#include <alsa/asoundlib.h>
+
+#include "midi_port_registry.hh"
+#include "log.hh"
+
+template <typename T>
+static std::vector<std::string> get_midi_ports_name(T& midi)
+{
+  std::vector<std::string> res;
+
+  const auto nb_ports = midi.getPortCount();
+  res.reserve(nb_ports);
+
+  for (auto i = decltype(nb_ports){0}; i < nb_ports; ++i)
+  {
+    res.emplace_back(midi.getPortName(i));
+  }
+
+  return res;
+}
+
+static unsigned int find_port(const std::vector<std::string>& ports, const std::string& name)
+{
+  const auto it = std::find(ports.begin(), ports.end(), name);
+  return (it == ports.end()) ? midi_port_registry::NO_PORT : static_cast<unsigned int>(it - ports.begin());
+}
+
+// opens a sequencer client listening to the announces of the system. Returns
+// nullptr if the sequencer is not available.
+static snd_seq_t* open_announce_listener()
+{
+  snd_seq_t* seq = nullptr;
+  if (snd_seq_open(&seq, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK) < 0)
+  {
+    return nullptr;
+  }
+
+  snd_seq_set_client_name(seq, "lilyplayer port registry");
+  const auto port = snd_seq_create_simple_port(seq, "announces",
+					       SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_NO_EXPORT,
+					       SND_SEQ_PORT_TYPE_APPLICATION);
+  if ((port < 0) or
+      (snd_seq_connect_from(seq, port, SND_SEQ_CLIENT_SYSTEM, SND_SEQ_PORT_SYSTEM_ANNOUNCE) < 0))
+  {
+    snd_seq_close(seq);
+    return nullptr;
+  }
+
+  return seq;
+}
+
+static int get_poll_fd(snd_seq_t* const seq)
+{
+  struct pollfd fd {};
+  if ((seq == nullptr) or (snd_seq_poll_descriptors(seq, &fd, 1, POLLIN) != 1))
+  {
+    return -1;
+  }
+
+  return fd.fd;
+}
+
+midi_port_registry::midi_port_registry()
+  : output_lister(RtMidi::LINUX_ALSA, "lilyplayer port lister")
+  , input_lister(RtMidi::LINUX_ALSA, "lilyplayer port lister")
+  , sequencer(open_announce_listener())
+  , notification_fd(get_poll_fd(sequencer))
+  , is_outdated(true)
+  , output_ports()
+  , input_ports()
+{
+}
+
+midi_port_registry::~midi_port_registry()
+{
+  if (sequencer != nullptr)
+  {
+    snd_seq_close(sequencer);
+  }
+}
+
+void midi_port_registry::process_notifications()
+{
+  if (sequencer == nullptr)
+  {
+    return;
+  }
+
+  while (true)
+  {
+    snd_seq_event_t* event = nullptr;
+    const auto res = snd_seq_event_input(sequencer, &event);
+    if (res == -ENOSPC)
+    {
+      // the input queue overflowed, some announces were lost.
+      is_outdated = true;
+      continue;
+    }
+
+    if ((res < 0) or (event == nullptr))
+    {
+      // -EAGAIN: no more announces pending
+      return;
+    }
+
+    const auto type = event->type;
+    if ((type == SND_SEQ_EVENT_CLIENT_START) or (type == SND_SEQ_EVENT_CLIENT_EXIT) or
+	(type == SND_SEQ_EVENT_CLIENT_CHANGE) or (type == SND_SEQ_EVENT_PORT_START) or
+	(type == SND_SEQ_EVENT_PORT_EXIT) or (type == SND_SEQ_EVENT_PORT_CHANGE))
+    {
+      is_outdated = true;
+    }
+  }
+}
+
+void midi_port_registry::refresh_if_needed()
+{
+  process_notifications();
+
+  // without announces, there is no way to know if the lists are still valid.
+  if (is_outdated or (sequencer == nullptr))
+  {
+    output_ports = get_midi_ports_name(output_lister);
+    input_ports = get_midi_ports_name(input_lister);
+    is_outdated = false;
+  }
+}
+
+const std::vector<std::string>& midi_port_registry::get_output_ports()
+{
+  refresh_if_needed();
+  return output_ports;
+}
+
+const std::vector<std::string>& midi_port_registry::get_input_ports()
+{
+  refresh_if_needed();
+  return input_ports;
+}
+
+unsigned int midi_port_registry::find_output_port(const std::string& name)
+{
+  return find_port(get_output_ports(), name);
+}
+
+unsigned int midi_port_registry::find_input_port(const std::string& name)
+{
+  return find_port(get_input_ports(), name);
+}
+
+midi_port_registry& get_midi_port_registry()
+{
+  static midi_port_registry registry;
+  return registry;
+}
+
+static void list_midi_ports(std::ostream& out, const std::vector<std::string>& ports, const char* direction)
+{
+  const auto nb_ports = ports.size();
+  if (nb_ports == 0)
+  {
+    out << "Sorry: no " << direction << " midi port found\n";
+  }
+  else
+  {
+    if (nb_ports == 1)
+    {
+      out << "1 " << direction << " port found:\n";
+    }
+    else
+    {
+      out << nb_ports << " " << direction << " ports found:\n";
+    }
+
+    for (auto i = decltype(nb_ports){0}; i < nb_ports; ++i)
+    {
+      out << "  " << i << " -> " << ports[i] << "\n";
+    }
+  }
+}
+
+void list_midi_ports(std::ostream& out)
+{
+  auto& registry = get_midi_port_registry();
+  list_midi_ports(out, registry.get_output_ports(), "output");
+
+  out << "\n";
+
+  list_midi_ports(out, registry.get_input_ports(), "input");
+}
+
+static log_site invalid_port_log (log_level::warning);
+
+unsigned int get_port(const std::string& s)
+{
+  auto& registry = get_midi_port_registry();
+  const auto nb_outputs = registry.get_output_ports().size();
+
+  try
+  {
+    const auto res = std::stoi(s);
+    if ((res < 0) or (static_cast<std::size_t>(res) >= nb_outputs))
+    {
+      log_line(invalid_port_log) << "Warning: invalid port " << s;
+      return 0;
+    }
+    return static_cast<unsigned int>(res);
+  }
+  catch (std::invalid_argument&)
+  {
+    // argument is not a number, let's see if it matches the name of one of the output
+    const auto port = registry.find_output_port(s);
+    if (port != midi_port_registry::NO_PORT)
+    {
+      return port;
+    }
+
+    log_line(invalid_port_log) << "Warning: invalid port " << s;
+    return 0;
+  }
+}
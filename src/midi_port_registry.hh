@@ -0,0 +1,59 @@
+#ifndef MIDI_PORT_REGISTRY_HH
+#define MIDI_PORT_REGISTRY_HH
+
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <rtmidi/RtMidi.h>
+
+struct _snd_seq;
+
+// Names of the midi ports, in the numbering used by RtMidi. The lists are
+// only enumerated again once the ALSA sequencer announces that a client or a
+// port appeared, disappeared or changed, instead of each time they are read.
+class midi_port_registry
+{
+  public:
+    static constexpr const unsigned int NO_PORT = std::numeric_limits<unsigned int>::max();
+
+    midi_port_registry();
+    ~midi_port_registry();
+
+    midi_port_registry(const midi_port_registry&) = delete;
+    midi_port_registry& operator=(const midi_port_registry&) = delete;
+
+    const std::vector<std::string>& get_output_ports();
+    const std::vector<std::string>& get_input_ports();
+
+    // NO_PORT if there is no port with this name
+    unsigned int find_output_port(const std::string& name);
+    unsigned int find_input_port(const std::string& name);
+
+    // file descriptor becoming readable when announces are pending, -1 if
+    // announces are not available (the lists are then enumerated on each read).
+    int get_notification_fd() const { return notification_fd; }
+
+    // reads the pending announces without blocking
+    void process_notifications();
+
+  private:
+    void refresh_if_needed();
+
+    RtMidiOut output_lister;
+    RtMidiIn input_lister;
+    struct _snd_seq* sequencer;
+    int notification_fd;
+    bool is_outdated;
+    std::vector<std::string> output_ports;
+    std::vector<std::string> input_ports;
+};
+
+// the registry shared by the command line and the main window.
+midi_port_registry& get_midi_port_registry();
+
+void list_midi_ports(std::ostream& out);
+unsigned int get_port(const std::string& s); // output port from its number or name
+
+#endif
@@ -0,0 +1,139 @@
+#include <algorithm>
+
+#include "midi_recorder.hh"
+#include "bin_file_writer.hh"
+#include "midi_file_writer.hh"
+#include "utils.hh"
+
+constexpr const std::size_t midi_recorder::DEFAULT_CAPACITY;
+
+midi_recorder::midi_recorder(const std::size_t max_recorded_keys)
+  : max_keys(max_recorded_keys)
+  , keys()
+  , nb_keys(0)
+  , nb_dropped(0)
+  , is_recording(false)
+  , session(0)
+  , parser_session(0)
+  , parser()
+{
+}
+
+void midi_recorder::start()
+{
+  // before the first recording the RtMidi thread doesn't touch the keys, and
+  // after it the buffer never moves.
+  if (keys.empty())
+  {
+    keys.resize(max_keys);
+  }
+
+  nb_keys.store(0, std::memory_order_relaxed);
+  nb_dropped.store(0, std::memory_order_relaxed);
+  session.fetch_add(1, std::memory_order_release);
+  is_recording.store(true, std::memory_order_release);
+}
+
+void midi_recorder::add_key(const int64_t received_at, const uint8_t pitch, const uint8_t velocity, const bool is_pressed)
+{
+  auto pos = nb_keys.load(std::memory_order_relaxed);
+  if (pos >= max_keys)
+  {
+    nb_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  keys[pos] = recorded_key{ received_at, pitch, velocity, is_pressed };
+
+  // fails if a new recording started meanwhile, this key was for the previous one
+  nb_keys.compare_exchange_strong(pos, pos + 1, std::memory_order_release, std::memory_order_relaxed);
+}
+
+void midi_recorder::add(const int64_t received_at, const uint8_t* const bytes, const std::size_t size)
+{
+  if (not is_recording.load(std::memory_order_acquire))
+  {
+    return;
+  }
+
+  const auto current_session = session.load(std::memory_order_acquire);
+  if (current_session != parser_session)
+  {
+    parser.reset();
+    parser_session = current_session;
+  }
+
+  // long messages, e.g. sysex, are parsed in several rounds
+  midi_event events[16];
+  std::size_t pos = 0;
+  while (pos < size)
+  {
+    const auto parsed = parser.parse(bytes + pos, size - pos, events, sizeof(events) / sizeof(events[0]));
+    for (auto i = decltype(parsed.nb_events){0}; i < parsed.nb_events; ++i)
+    {
+      if ((events[i].kind == midi_event_kind::note_on) or (events[i].kind == midi_event_kind::note_off))
+      {
+	add_key(received_at, events[i].data1, events[i].data2, events[i].kind == midi_event_kind::note_on);
+      }
+    }
+
+    if (parsed.nb_bytes_read == 0)
+    {
+      break;
+    }
+    pos += parsed.nb_bytes_read;
+  }
+}
+
+bin_song_t midi_recorder::get_song() const
+{
+  bin_song_t res;
+  res.instr_names.emplace_back("Piano");
+
+  // keys received at the same time are grouped in one event. A group holds
+  // at most 255 events, the first one also sets the bar number.
+  constexpr const std::size_t max_keys_per_event = 254;
+  const auto nb_recorded = size();
+  for (auto i = decltype(nb_recorded){0}; i < nb_recorded; ++i)
+  {
+    const auto& key = keys[i];
+    const auto time = static_cast<uint64_t>(std::max(key.time - keys.front().time, int64_t{0}));
+    const auto is_new_event = res.events.empty() or (res.events.back().time != time) or
+      (res.events.back().keys_down.size() + res.events.back().keys_up.size() >= max_keys_per_event);
+    if (is_new_event)
+    {
+      res.events.emplace_back();
+      res.events.back().time = time;
+    }
+
+    if (key.is_pressed)
+    {
+      res.events.back().keys_down.emplace_back(key.pitch, 0 /* staff_num */, key.velocity);
+    }
+    else
+    {
+      res.events.back().keys_up.emplace_back(key.pitch);
+    }
+  }
+
+  // there are no measures in a recording, but the player needs one.
+  if (not res.events.empty())
+  {
+    res.events.front().add_bar_number_change(1);
+  }
+
+  res.nb_events = res.events.size();
+  return res;
+}
+
+void save_recording(const bin_song_t& song, const std::string& filename)
+{
+  if (ends_by(filename, ".mid"))
+  {
+    write_file(filename, get_standard_midi_file(song));
+  }
+  else
+  {
+    write_file(filename, get_bin_file(song));
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef MIDI_RECORDER_HH
+#define MIDI_RECORDER_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bin_file_reader.hh"
+#include "midi_stream_parser.hh"
+
+// Keys played on the midi input while recording. The messages are parsed
+// and the keys stored by the RtMidi thread itself, so that a busy gui thread
+// loses none. They go into a buffer allocated once, on the first recording,
+// and never reallocated: the keys played once it is full are counted and
+// left out. The gui thread starts and stops the recording, and reads it.
+class midi_recorder
+{
+  public:
+    // at 16 bytes per key, 8 MiB: more than 7 hours of fast playing at
+    // 20 keys pressed or released per second.
+    static constexpr const std::size_t DEFAULT_CAPACITY = 1 << 19;
+
+    explicit midi_recorder(std::size_t max_keys = DEFAULT_CAPACITY);
+
+    midi_recorder(const midi_recorder&) = delete;
+    midi_recorder& operator=(const midi_recorder&) = delete;
+
+    // gui thread. Drops the previous recording.
+    void start();
+    void stop() { is_recording.store(false, std::memory_order_release); }
+    bool is_active() const { return is_recording.load(std::memory_order_relaxed); }
+
+    // RtMidi thread. received_at is the steady clock time in ns. Only key
+    // events are kept. Never blocks nor allocates.
+    void add(int64_t received_at, const uint8_t* bytes, std::size_t size);
+
+    // gui thread, once stopped for an exact figure.
+    bool empty() const { return nb_keys.load(std::memory_order_acquire) == 0; }
+    std::size_t size() const { return nb_keys.load(std::memory_order_acquire); }
+    std::size_t capacity() const { return max_keys; }
+    uint64_t get_nb_dropped() const { return nb_dropped.load(std::memory_order_relaxed); }
+
+    // one instrument, event times in ns since the first recorded key.
+    bin_song_t get_song() const;
+
+  private:
+    struct recorded_key
+    {
+	int64_t time;
+	uint8_t pitch;
+	uint8_t velocity;
+	bool is_pressed;
+    };
+
+    void add_key(int64_t received_at, uint8_t pitch, uint8_t velocity, bool is_pressed);
+
+    const std::size_t max_keys;
+    std::vector<recorded_key> keys; // only ever resized by the first start
+    std::atomic<std::size_t> nb_keys; // the keys below are complete
+    std::atomic<uint64_t> nb_dropped;
+    std::atomic<bool> is_recording;
+
+    // bumped at each start, so that the RtMidi thread drops the running
+    // status of the previous recording.
+    std::atomic<unsigned int> session;
+    unsigned int parser_session; // RtMidi thread only
+    midi_stream_parser parser; // RtMidi thread only
+};
+
+// a standard midi file if the filename ends by .mid, a lilyplayer file otherwise.
+void save_recording(const bin_song_t& song, const std::string& filename);
+
+#endif /* MIDI_RECORDER_HH */
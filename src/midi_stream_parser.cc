@@ -0,0 +1,107 @@
+#include "midi_stream_parser.hh"
+
+static uint8_t get_nb_data_bytes(const uint8_t status)
+{
+  switch (status & 0xF0)
+  {
+    case 0xC0: // program change
+    case 0xD0: // channel pressure
+      return 1;
+
+    case 0xF0: // system common messages
+      switch (status)
+      {
+	case 0xF1: // midi time code quarter frame
+	case 0xF3: // song select
+	  return 1;
+
+	case 0xF2: // song position pointer
+	  return 2;
+
+	default: // tune request and undefined ones
+	  return 0;
+      }
+
+    default:
+      return 2;
+  }
+}
+
+static midi_event to_midi_event(const uint8_t status, const uint8_t data1, const uint8_t data2)
+{
+  const auto channel = static_cast<uint8_t>(status & 0x0F);
+  const auto kind = [=] () {
+    switch (status & 0xF0)
+    {
+      case 0x80: return midi_event_kind::note_off;
+      case 0x90: return (data2 == 0) ? midi_event_kind::note_off : midi_event_kind::note_on;
+      case 0xA0: return midi_event_kind::key_pressure;
+      case 0xB0: return (data1 == 64) ? midi_event_kind::sustain : midi_event_kind::control_change;
+      case 0xC0: return midi_event_kind::program_change;
+      case 0xD0: return midi_event_kind::channel_pressure;
+      default:   return midi_event_kind::pitch_bend;
+    }
+  }();
+
+  return midi_event{ kind, channel, data1, data2 };
+}
+
+midi_stream_parser::result
+midi_stream_parser::parse(const uint8_t* const bytes, const std::size_t size,
+			  midi_event* const events, const std::size_t max_events)
+{
+  std::size_t nb_events = 0;
+  std::size_t i = 0;
+
+  for (; (i < size) and (nb_events < max_events); ++i)
+  {
+    const auto byte = bytes[i];
+
+    if (byte >= 0xF8)
+    {
+      // real time messages can appear anywhere, even in the middle of
+      // another message, and don't change the running status.
+      continue;
+    }
+
+    if ((byte & 0x80) != 0)
+    {
+      // any status byte ends a sysex
+      is_in_sysex = (byte == 0xF0);
+      nb_data = 0;
+
+      // system messages without data (including sysex start and end) have
+      // nothing more to receive, and they cancel the running status.
+      status = ((byte >= 0xF0) and (get_nb_data_bytes(byte) == 0)) ? 0 : byte;
+      continue;
+    }
+
+    if (is_in_sysex or (status == 0))
+    {
+      // sysex content, or data without any status (e.g. after a tune request)
+      continue;
+    }
+
+    data[nb_data] = byte;
+    ++nb_data;
+
+    const auto nb_data_bytes = get_nb_data_bytes(status);
+    if (nb_data < nb_data_bytes)
+    {
+      continue;
+    }
+
+    nb_data = 0;
+    if (status >= 0xF0)
+    {
+      // system common messages are complete, and aren't reported.
+      status = 0;
+      continue;
+    }
+
+    events[nb_events] = to_midi_event(status, data[0], (nb_data_bytes == 2) ? data[1] : 0);
+    ++nb_events;
+  }
+
+  return result{ i, nb_events };
+}
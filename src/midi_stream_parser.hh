@@ -0,0 +1,68 @@
+#ifndef MIDI_STREAM_PARSER_HH
+#define MIDI_STREAM_PARSER_HH
+
+#include <cstddef>
+#include <cstdint>
+
+enum class midi_event_kind : uint8_t
+{
+  note_on,
+  note_off,         // also produced by a note on with a velocity of 0
+  key_pressure,
+  sustain,          // control change 64. value >= 64 means the pedal is down
+  control_change,   // any other controller
+  program_change,
+  channel_pressure,
+  pitch_bend,
+};
+
+struct midi_event
+{
+    midi_event_kind kind;
+    uint8_t channel;
+    uint8_t data1; // pitch, controller number, program or pitch bend lsb
+    uint8_t data2; // velocity, controller value, pressure or pitch bend msb
+};
+
+// Incremental parser of a raw midi byte stream (i.e. as sent on a wire, not
+// as stored in a midi file). The stream can be split anywhere between calls:
+// running status, partially received messages and sysex are kept in the
+// parser. Never allocates.
+class midi_stream_parser
+{
+  public:
+    midi_stream_parser()
+      : status(0)
+      , nb_data(0)
+      , data()
+      , is_in_sysex(false)
+    {
+    }
+
+    struct result
+    {
+	std::size_t nb_bytes_read;
+	std::size_t nb_events;
+    };
+
+    // Parses bytes until the end of the input, or until max_events events have
+    // been written into events. The bytes not read yet must be given again
+    // in the next call.
+    result parse(const uint8_t* bytes, std::size_t size, midi_event* events, std::size_t max_events);
+
+    // forget any running status or partially received message
+    void reset()
+    {
+      status = 0;
+      nb_data = 0;
+      is_in_sysex = false;
+    }
+
+  private:
+    uint8_t status; // status of the message being received, 0 if none
+    uint8_t nb_data; // data bytes already received for this message
+    uint8_t data[2];
+    bool is_in_sysex;
+};
+
+#endif /* MIDI_STREAM_PARSER_HH */
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cmath>
+
+#include "midi_transform.hh"
+
+constexpr const uint8_t midi_transform::NO_NOTE;
+
+// an event has at most 255 keys, each one released and pressed again, and doubled.
+static constexpr const std::size_t PREALLOCATED_MESSAGES = 255 * 4;
+
+midi_transform::midi_transform()
+  : transposition(0)
+  , octave_doubling(0)
+  , velocity_scale(1.0)
+  , curve(velocity_curve::linear)
+  , velocities()
+  , channel_of_staff()
+  , muted_staffs()
+  , solo_staffs()
+  , sounding_notes()
+  , messages()
+{
+  messages.reserve(PREALLOCATED_MESSAGES);
+  set_velocity(1.0, velocity_curve::linear);
+  for (auto& note : sounding_notes)
+  {
+    note = sounding_note{ 0, NO_NOTE, NO_NOTE };
+  }
+}
+
+midi_transform::midi_transform(const midi_transform& other)
+  : transposition(0)
+  , octave_doubling(0)
+  , velocity_scale(1.0)
+  , curve(velocity_curve::linear)
+  , velocities()
+  , channel_of_staff()
+  , muted_staffs()
+  , solo_staffs()
+  , sounding_notes()
+  , messages()
+{
+  messages.reserve(PREALLOCATED_MESSAGES);
+  copy_settings(other);
+}
+
+midi_transform& midi_transform::operator=(const midi_transform& other)
+{
+  // the messages are kept, with their capacity: they are only valid until
+  // the next call anyway.
+  copy_settings(other);
+  messages.clear();
+  return *this;
+}
+
+void midi_transform::copy_settings(const midi_transform& other)
+{
+  transposition = other.transposition;
+  octave_doubling = other.octave_doubling;
+  velocity_scale = other.velocity_scale;
+  curve = other.curve;
+  std::copy(std::begin(other.velocities), std::end(other.velocities), std::begin(velocities));
+  std::copy(std::begin(other.channel_of_staff), std::end(other.channel_of_staff), std::begin(channel_of_staff));
+  muted_staffs = other.muted_staffs;
+  solo_staffs = other.solo_staffs;
+  std::copy(std::begin(other.sounding_notes), std::end(other.sounding_notes), std::begin(sounding_notes));
+}
+
+void midi_transform::set_transposition(const int semitones)
+{
+  transposition = std::max(std::min(semitones, 127), -127);
+}
+
+void midi_transform::set_velocity(const double scale, const velocity_curve new_curve)
+{
+  velocity_scale = std::max(scale, 0.0);
+  curve = new_curve;
+
+  // computed once here, so that a note only costs a lookup
+  for (unsigned int i = 0; i < 128; ++i)
+  {
+    const auto scaled = std::min(static_cast<double>(i) * velocity_scale / 127.0, 1.0);
+    const auto curved = (curve == velocity_curve::soft) ? std::sqrt(scaled) :
+			(curve == velocity_curve::hard) ? scaled * scaled :
+			scaled;
+
+    // a note on with a velocity of 0 is a note off
+    const auto velocity = static_cast<uint8_t>(std::lround(curved * 127.0));
+    velocities[i] = std::max(velocity, static_cast<uint8_t>((i == 0) ? 0 : 1));
+  }
+}
+
+void midi_transform::set_channel(const uint8_t staff_num, const uint8_t channel)
+{
+  channel_of_staff[staff_num] = static_cast<uint8_t>(channel & 0x0F);
+}
+
+void midi_transform::set_channel(const uint8_t channel)
+{
+  std::fill(std::begin(channel_of_staff), std::end(channel_of_staff), static_cast<uint8_t>(channel & 0x0F));
+}
+
+void midi_transform::set_octave_doubling(const int octaves)
+{
+  octave_doubling = std::max(std::min(octaves, 1), -1);
+}
+
+static uint8_t get_pitch(const int pitch)
+{
+  return ((pitch >= 0) and (pitch < 128)) ? static_cast<uint8_t>(pitch) : uint8_t{0xFF};
+}
+
+void midi_transform::press(const key_down& key)
+{
+  const auto pitch = static_cast<uint8_t>(key.pitch & 0x7F);
+
+  // pressed again without being released
+  release(pitch);
+
+  if (not is_audible(key.staff_num))
+  {
+    return;
+  }
+
+  const auto channel = channel_of_staff[key.staff_num];
+  const auto velocity = velocities[key.velocity & 0x7F];
+  auto& note = sounding_notes[pitch];
+  note.channel = channel;
+  note.pitch = get_pitch(pitch + transposition);
+  note.doubled_pitch = (octave_doubling == 0) ? NO_NOTE : get_pitch(pitch + transposition + 12 * octave_doubling);
+
+  for (const auto sent_pitch : { note.pitch, note.doubled_pitch })
+  {
+    if (sent_pitch != NO_NOTE)
+    {
+      messages.push_back(short_midi_message{ { static_cast<uint8_t>(0x90 | channel), sent_pitch, velocity } });
+    }
+  }
+}
+
+void midi_transform::release(const uint8_t pitch)
+{
+  auto& note = sounding_notes[pitch & 0x7F];
+  for (const auto sent_pitch : { note.pitch, note.doubled_pitch })
+  {
+    if (sent_pitch != NO_NOTE)
+    {
+      messages.push_back(short_midi_message{ { static_cast<uint8_t>(0x80 | note.channel), sent_pitch, 0 } });
+    }
+  }
+
+  note.pitch = NO_NOTE;
+  note.doubled_pitch = NO_NOTE;
+}
+
+const std::vector<short_midi_message>& midi_transform::apply(const std::vector<key_down>& keys_down,
+							     const std::vector<key_up>& keys_up)
+{
+  messages.clear();
+
+  for (const auto& key : keys_up)
+  {
+    release(key.pitch);
+  }
+
+  for (const auto& key : keys_down)
+  {
+    press(key);
+  }
+
+  return messages;
+}
+
+const std::vector<short_midi_message>& midi_transform::release_all()
+{
+  messages.clear();
+  for (uint8_t pitch = 0; pitch < 128; ++pitch)
+  {
+    release(pitch);
+  }
+
+  return messages;
+}
@@ -0,0 +1,103 @@
+#ifndef MIDI_TRANSFORM_HH
+#define MIDI_TRANSFORM_HH
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "utils.hh"
+
+enum class velocity_curve : uint8_t
+{
+  linear,
+  soft, // quiet notes get louder
+  hard, // quiet notes get quieter
+};
+
+// a channel message as sent to the midi output
+struct short_midi_message
+{
+    uint8_t bytes[3];
+};
+
+// Turns the keys of the song's events into the midi messages sent to the
+// output, with a transposition, per staff mute and solo, a velocity scale
+// and curve, a channel per staff and an octave doubling. The settings can
+// change at any time, even while notes are sounding: a key is always
+// released with the notes it started. Never allocates once constructed.
+class midi_transform
+{
+  public:
+    midi_transform();
+
+    // a copy has its own preallocated messages, and the notes sounding
+    midi_transform(const midi_transform& other);
+    midi_transform& operator=(const midi_transform& other);
+
+    // the notes going out of the midi range are dropped
+    void set_transposition(int semitones);
+    int get_transposition() const { return transposition; }
+
+    // applied to the velocity of each key, the scale before the curve. 1.0
+    // and a linear curve keep the velocities as is.
+    void set_velocity(double scale, velocity_curve curve);
+    double get_velocity_scale() const { return velocity_scale; }
+    velocity_curve get_velocity_curve() const { return curve; }
+
+    void set_channel(uint8_t staff_num, uint8_t channel);
+    void set_channel(uint8_t channel); // of all the staffs
+    uint8_t get_channel(uint8_t staff_num) const { return channel_of_staff[staff_num]; }
+
+    // -1 doubles each note an octave lower, 1 an octave higher, 0 not at all
+    void set_octave_doubling(int octaves);
+    int get_octave_doubling() const { return octave_doubling; }
+
+    // once a staff is solo, only the solo staffs are played
+    void set_muted(uint8_t staff_num, bool is_muted) { muted_staffs.set(staff_num, is_muted); }
+    void set_solo(uint8_t staff_num, bool is_solo) { solo_staffs.set(staff_num, is_solo); }
+    bool is_muted(uint8_t staff_num) const { return muted_staffs.test(staff_num); }
+    bool is_solo(uint8_t staff_num) const { return solo_staffs.test(staff_num); }
+
+    // the messages to send for an event. The keys released come first, so
+    // that a key released and pressed again in the same event is heard
+    // again. Valid until the next call.
+    const std::vector<short_midi_message>& apply(const std::vector<key_down>& keys_down,
+						 const std::vector<key_up>& keys_up);
+
+    // releases all the notes still sounding, e.g. when pausing
+    const std::vector<short_midi_message>& release_all();
+
+  private:
+    static constexpr const uint8_t NO_NOTE = 0xFF;
+
+    // what was sent when a key was pressed
+    struct sounding_note
+    {
+	uint8_t channel;
+	uint8_t pitch; // NO_NOTE if the key isn't sounding
+	uint8_t doubled_pitch; // NO_NOTE if not doubled
+    };
+
+    bool is_audible(uint8_t staff_num) const
+    {
+      return (not muted_staffs.test(staff_num)) and (solo_staffs.none() or solo_staffs.test(staff_num));
+    }
+
+    void copy_settings(const midi_transform& other); // and the notes sounding
+    void press(const key_down& key);
+    void release(uint8_t pitch);
+
+    int transposition;
+    int octave_doubling;
+    double velocity_scale;
+    velocity_curve curve;
+    uint8_t velocities[128]; // the velocity sent for each velocity of the song
+    uint8_t channel_of_staff[256];
+    std::bitset<256> muted_staffs;
+    std::bitset<256> solo_staffs;
+    sounding_note sounding_notes[128]; // indexed by the pitch of the song's key
+    std::vector<short_midi_message> messages;
+};
+
+#endif /* MIDI_TRANSFORM_HH */
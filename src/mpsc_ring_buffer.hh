@@ -0,0 +1,129 @@
+#ifndef MPSC_RING_BUFFER_HH
+#define MPSC_RING_BUFFER_HH
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Lock-free queue between any number of producer threads and one consumer
+// thread. Each slot carries a sequence number telling whether it is free,
+// being written, or ready to be consumed, so that producers only contend on
+// the write position. All the memory is allocated at construction, pushing
+// and consuming never allocate nor block.
+template <typename T>
+class mpsc_ring_buffer
+{
+  public:
+    // the capacity is rounded up to the next power of two
+    explicit mpsc_ring_buffer(const std::size_t min_capacity)
+      : slots(round_up_to_power_of_two(min_capacity))
+      , mask(slots.size() - 1)
+      , write_pos(0)
+      , read_pos(0)
+    {
+      for (std::size_t i = 0; i < slots.size(); ++i)
+      {
+	slots[i].sequence.store(i, std::memory_order_relaxed);
+      }
+    }
+
+    mpsc_ring_buffer(const mpsc_ring_buffer&) = delete;
+    mpsc_ring_buffer& operator=(const mpsc_ring_buffer&) = delete;
+
+    // producer side, from any thread. Returns false, and drops elt, if the
+    // buffer is full.
+    bool push(const T& elt)
+    {
+      auto pos = write_pos.load(std::memory_order_relaxed);
+      for (;;)
+      {
+	auto& slot = slots[pos & mask];
+	const auto sequence = slot.sequence.load(std::memory_order_acquire);
+	if (sequence == pos)
+	{
+	  // the slot is free, claim it. On failure pos is the new write position.
+	  if (write_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+	  {
+	    slot.elt = elt;
+	    slot.sequence.store(pos + 1, std::memory_order_release);
+	    return true;
+	  }
+	}
+	else if (sequence < pos)
+	{
+	  // still holding the element pushed one lap before
+	  return false;
+	}
+	else
+	{
+	  // another producer claimed it in the meantime
+	  pos = write_pos.load(std::memory_order_relaxed);
+	}
+      }
+    }
+
+    // consumer side. Calls func on every element available, oldest first.
+    // Stops at the first slot still being written. Returns the number of
+    // elements consumed.
+    template <typename Func>
+    std::size_t consume_all(Func&& func)
+    {
+      const auto begin = read_pos.load(std::memory_order_relaxed);
+      auto pos = begin;
+      for (;;)
+      {
+	auto& slot = slots[pos & mask];
+	if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+	{
+	  break;
+	}
+
+	func(static_cast<const T&>(slot.elt));
+
+	// free for the producers of the next lap
+	slot.sequence.store(pos + mask + 1, std::memory_order_release);
+	++pos;
+      }
+
+      read_pos.store(pos, std::memory_order_relaxed);
+      return pos - begin;
+    }
+
+    // consumer side.
+    bool empty() const
+    {
+      const auto pos = read_pos.load(std::memory_order_relaxed);
+      return slots[pos & mask].sequence.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    std::size_t capacity() const
+    {
+      return slots.size();
+    }
+
+  private:
+    struct slot_t
+    {
+	std::atomic<std::size_t> sequence;
+	T elt;
+    };
+
+    static std::size_t round_up_to_power_of_two(const std::size_t value)
+    {
+      std::size_t res = 1;
+      while (res < value)
+      {
+	res <<= 1;
+      }
+      return res;
+    }
+
+    std::vector<slot_t> slots;
+    const std::size_t mask;
+
+    // on separate cache lines so producers and consumer don't slow each other down
+    alignas(64) std::atomic<std::size_t> write_pos;
+    alignas(64) std::atomic<std::size_t> read_pos;
+};
+
+#endif /* MPSC_RING_BUFFER_HH */
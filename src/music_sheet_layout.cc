@@ -0,0 +1,12 @@
+#include <algorithm>
+
+#include "music_sheet_layout.hh"
+
+QRectF get_cursor_view_area(const QRectF& page_viewbox, const QRectF& cursor_box)
+{
+  const auto half_cursor_box_height = cursor_box.height() / 2;
+  return QRectF{page_viewbox.left(),
+		std::max(cursor_box.top() - half_cursor_box_height, 0.0),
+		page_viewbox.width(),
+		3 * half_cursor_box_height};
+}
@@ -0,0 +1,17 @@
+#ifndef MUSIC_SHEET_LAYOUT_HH
+#define MUSIC_SHEET_LAYOUT_HH
+
+#include <QRectF>
+
+// Where the music sheet and its cursor are drawn, shared by the main window
+// and the video frames so that both show the same thing.
+
+// height of the music sheet view of the window at its default size, and of
+// the music sheet in the videos.
+static constexpr const int MUSIC_SHEET_VIEW_HEIGHT = 600;
+
+// the part of the page centered in the view, in page coordinates: the line
+// of the cursor, with half a line above it.
+QRectF get_cursor_view_area(const QRectF& page_viewbox, const QRectF& cursor_box) __attribute__((pure));
+
+#endif /* MUSIC_SHEET_LAYOUT_HH */
@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <cmath>
+#include <QPainter>
+
+#include "page_raster_cache.hh"
+#include "page_store.hh"
+#include "trace_events.hh"
+
+// widths are rounded to this number of pixels, so that resizing the window
+// by a few pixels doesn't render all the pages again.
+static constexpr const int WIDTH_STEP = 16;
+
+static int round_width(const int width)
+{
+  return ((width + WIDTH_STEP - 1) / WIDTH_STEP) * WIDTH_STEP;
+}
+
+static std::size_t get_image_size(const QImage& image)
+{
+  return static_cast<std::size_t>(image.bytesPerLine()) * static_cast<std::size_t>(image.height());
+}
+
+page_raster_cache::page_raster_cache(std::function<void()> on_page_rendered_callback)
+  : on_page_rendered(std::move(on_page_rendered_callback))
+  , mutex()
+  , has_jobs()
+  , pages()
+  , images()
+  , nb_uses(0)
+  , memory_budget(page_store::DEFAULT_MEMORY_BUDGET)
+  , memory_usage(0)
+  , current_page(page_store::NO_PAGE)
+  , next_page(page_store::NO_PAGE)
+  , jobs()
+  , generation(0)
+  , is_stopping(false)
+  , last_width(0)
+  , nb_hits(0)
+  , nb_misses(0)
+  , nb_prefetches(0)
+  , nb_repaints(0)
+  , total_repaint_time(0)
+  , sheet_rendering()
+  , worker([this] () { worker_loop(); })
+{
+}
+
+page_raster_cache::~page_raster_cache()
+{
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+    is_stopping = true;
+  }
+
+  has_jobs.notify_one();
+  worker.join();
+}
+
+void page_raster_cache::set_pages(std::vector<QByteArray> new_pages)
+{
+  std::lock_guard<std::mutex> lock (mutex);
+  pages = std::move(new_pages);
+  images.clear();
+  memory_usage = 0;
+  jobs.clear();
+  ++generation;
+}
+
+void page_raster_cache::set_memory_budget(const std::size_t budget)
+{
+  std::lock_guard<std::mutex> lock (mutex);
+  memory_budget = budget;
+  evict();
+}
+
+void page_raster_cache::set_working_set(const unsigned int current, const unsigned int next)
+{
+  std::lock_guard<std::mutex> lock (mutex);
+  current_page = current;
+  next_page = next;
+}
+
+void page_raster_cache::evict()
+{
+  while (memory_usage > memory_budget)
+  {
+    auto oldest = images.end();
+    for (auto it = images.begin(); it != images.end(); ++it)
+    {
+      const auto is_in_working_set = (it->first.page == current_page) or (it->first.page == next_page);
+      if ((not is_in_working_set) and ((oldest == images.end()) or (it->second.last_use < oldest->second.last_use)))
+      {
+	oldest = it;
+      }
+    }
+
+    if (oldest == images.end())
+    {
+      return;
+    }
+
+    memory_usage -= get_image_size(oldest->second.image);
+    images.erase(oldest);
+  }
+}
+
+void page_raster_cache::queue(const key& page_key)
+{
+  if ((page_key.page < pages.size()) and (page_key.width > 0) and
+      (images.find(page_key) == images.end()) and
+      (std::find(jobs.begin(), jobs.end(), page_key) == jobs.end()))
+  {
+    jobs.push_back(page_key);
+    has_jobs.notify_one();
+  }
+}
+
+QImage page_raster_cache::get(const unsigned int page, const int width)
+{
+  const auto rounded_width = round_width(width);
+
+  std::lock_guard<std::mutex> lock (mutex);
+  last_width = rounded_width;
+
+  const auto image = images.find(key{page, rounded_width});
+  if (image != images.end())
+  {
+    ++nb_hits;
+    image->second.last_use = ++nb_uses;
+    return image->second.image;
+  }
+
+  ++nb_misses;
+  queue(key{page, rounded_width});
+  return QImage{};
+}
+
+void page_raster_cache::prefetch(const unsigned int page)
+{
+  std::lock_guard<std::mutex> lock (mutex);
+  ++nb_prefetches;
+  queue(key{page, last_width});
+}
+
+int page_raster_cache::get_last_width()
+{
+  std::lock_guard<std::mutex> lock (mutex);
+  return last_width;
+}
+
+void page_raster_cache::add_image(const unsigned int page, QImage image)
+{
+  std::lock_guard<std::mutex> lock (mutex);
+  const key page_key { page, image.width() };
+  if ((page < pages.size()) and (images.find(page_key) == images.end()))
+  {
+    memory_usage += get_image_size(image);
+    images.emplace(page_key, cached_image{ std::move(image), ++nb_uses });
+    evict();
+  }
+}
+
+QImage page_raster_cache::render_page(const QByteArray& compressed_svg, const int width)
+{
+  QSvgRenderer renderer;
+  QImage image;
+  if (renderer.load(qUncompress(compressed_svg)))
+  {
+    const auto rounded_width = round_width(width);
+    const auto viewbox = renderer.viewBoxF();
+    const auto height = static_cast<int>(std::ceil(rounded_width * viewbox.height() / viewbox.width()));
+    image = QImage(rounded_width, height, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QPainter painter (&image);
+    painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform);
+    renderer.render(&painter);
+  }
+
+  return image;
+}
+
+void page_raster_cache::worker_loop()
+{
+  set_trace_thread_name("page rasteriser");
+
+  std::unique_lock<std::mutex> lock (mutex);
+  while (true)
+  {
+    has_jobs.wait(lock, [this] () { return is_stopping or not jobs.empty(); });
+    if (is_stopping)
+    {
+      return;
+    }
+
+    const auto page_key = jobs.front();
+    jobs.pop_front();
+    const auto page_generation = generation;
+    const auto svg = pages[page_key.page]; // shared copy, doesn't copy the content
+
+    // rendering can take a while, let the gui thread use the cache meanwhile.
+    lock.unlock();
+
+    const auto start = std::chrono::steady_clock::now();
+    QImage image;
+    {
+      trace_span span ("render_page");
+      span.set_arg("page", page_key.page);
+      image = render_page(svg, page_key.width);
+    }
+    const std::chrono::nanoseconds render_time = std::chrono::steady_clock::now() - start;
+
+    lock.lock();
+    ++sheet_rendering.nb_renders;
+    sheet_rendering.max_render_time = std::max(sheet_rendering.max_render_time, render_time);
+    if ((page_generation == generation) and not image.isNull())
+    {
+      memory_usage += get_image_size(image);
+      images.emplace(page_key, cached_image{ std::move(image), ++nb_uses });
+      evict();
+      lock.unlock();
+      on_page_rendered();
+      lock.lock();
+    }
+  }
+}
+
+void page_raster_cache::add_repaint_time(const std::chrono::nanoseconds duration)
+{
+  std::lock_guard<std::mutex> lock (mutex);
+  ++nb_repaints;
+  total_repaint_time += duration;
+  ++sheet_rendering.nb_repaints;
+  sheet_rendering.max_repaint_time = std::max(sheet_rendering.max_repaint_time, duration);
+}
+
+std::size_t page_raster_cache::get_memory_usage()
+{
+  std::lock_guard<std::mutex> lock (mutex);
+  return memory_usage;
+}
+
+playback_stats::sheet_rendering page_raster_cache::take_sheet_rendering()
+{
+  std::lock_guard<std::mutex> lock (mutex);
+  const auto res = sheet_rendering;
+  sheet_rendering = playback_stats::sheet_rendering{};
+  return res;
+}
+
+void page_raster_cache::report(std::ostream& out)
+{
+  std::lock_guard<std::mutex> lock (mutex);
+  if (nb_repaints != 0)
+  {
+    const auto nb_lookups = nb_hits + nb_misses;
+    out << "Music sheet: " << nb_repaints << " repaints, "
+	<< (std::chrono::duration<double, std::micro>(total_repaint_time).count() / static_cast<double>(nb_repaints))
+	<< " us on average, cache hit rate "
+	<< (nb_lookups == 0 ? 0.0 : (100.0 * static_cast<double>(nb_hits) / static_cast<double>(nb_lookups)))
+	<< "%, " << nb_prefetches << " pages prefetched\n";
+  }
+
+  nb_hits = 0;
+  nb_misses = 0;
+  nb_prefetches = 0;
+  nb_repaints = 0;
+  total_repaint_time = std::chrono::nanoseconds{0};
+}
+
+
+cached_page_item::cached_page_item(page_raster_cache& page_cache, page_store& store, const unsigned int page_num)
+  : QGraphicsItem()
+  , cache(page_cache)
+  , pages(store)
+  , page(page_num)
+{
+}
+
+QRectF cached_page_item::boundingRect() const
+{
+  // same as QGraphicsSvgItem, so the cursor keeps the same coordinates
+  return QRectF(QPointF(0, 0), pages.get_default_size(page));
+}
+
+void cached_page_item::paint(QPainter* painter, const QStyleOptionGraphicsItem* /* option */, QWidget* /* widget */)
+{
+  trace_span span ("paint_page");
+  span.set_arg("page", page);
+  const auto start = std::chrono::steady_clock::now();
+
+  const auto bounding_rect = boundingRect();
+  const auto level_of_detail = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+  const auto width = static_cast<int>(std::ceil(bounding_rect.width() * level_of_detail));
+
+  const auto image = cache.get(page, width);
+  if (image.isNull())
+  {
+    pages.get_renderer(page).render(painter, bounding_rect);
+  }
+  else
+  {
+    painter->drawImage(bounding_rect, image);
+  }
+
+  cache.add_repaint_time(std::chrono::steady_clock::now() - start);
+}
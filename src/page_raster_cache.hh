@@ -0,0 +1,148 @@
+#ifndef PAGE_RASTER_CACHE_HH
+#define PAGE_RASTER_CACHE_HH
+
+#include <chrono>
+#include <cstddef>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include <QByteArray>
+#include <QGraphicsItem>
+#include <QImage>
+#include <QStyleOptionGraphicsItem>
+#include <QSvgRenderer>
+
+#include "playback_stats.hh"
+
+// Music sheet pages rasterised by a worker thread, keyed by page and zoom
+// level (the width in pixels of the page on screen). Painting a page which is
+// in the cache is a blit instead of rendering the whole svg again.
+class page_raster_cache
+{
+  public:
+    // on_page_rendered is called from the worker thread each time a page is added.
+    explicit page_raster_cache(std::function<void()> on_page_rendered);
+    ~page_raster_cache();
+
+    page_raster_cache(const page_raster_cache&) = delete;
+    page_raster_cache& operator=(const page_raster_cache&) = delete;
+
+    // svg content of each page of the song, compressed with qCompress.
+    // Drops all the rendered pages.
+    void set_pages(std::vector<QByteArray> new_pages);
+
+    // the least recently used images are dropped above this size in bytes,
+    // except for the ones of the working set.
+    void set_memory_budget(std::size_t budget);
+    void set_working_set(unsigned int current_page, unsigned int next_page);
+
+    // returns a null image if the page isn't rendered yet at this width, and
+    // queues its rendering.
+    QImage get(unsigned int page, int width);
+
+    // queues the rendering of the page at the last width requested to get.
+    void prefetch(unsigned int page);
+
+    // width in pixels of the pages on screen, 0 before the first paint.
+    int get_last_width();
+
+    // adds a page rendered elsewhere, e.g. while the song was preloaded.
+    void add_image(unsigned int page, QImage image);
+
+    // renders the page the same way the worker thread does. Can be called
+    // from any thread. Returns a null image if the svg is invalid.
+    static QImage render_page(const QByteArray& compressed_svg, int width);
+
+    void add_repaint_time(std::chrono::nanoseconds duration);
+
+    // size in bytes of the rasterised pages
+    std::size_t get_memory_usage();
+
+    // pages rendered and repaints since the last call, for the statistics overlay.
+    playback_stats::sheet_rendering take_sheet_rendering();
+
+    // prints the repaint time and the hit rate since the last report, then resets them.
+    void report(std::ostream& out);
+
+  private:
+    struct key
+    {
+	unsigned int page;
+	int width;
+
+	bool operator<(const key& other) const
+	{
+	  return (page < other.page) or ((page == other.page) and (width < other.width));
+	}
+
+	bool operator==(const key& other) const
+	{
+	  return (page == other.page) and (width == other.width);
+	}
+    };
+
+    struct cached_image
+    {
+	QImage image;
+	uint64_t last_use;
+    };
+
+    void queue(const key& page_key); // mutex must be held
+    void evict(); // mutex must be held
+    void worker_loop();
+
+    const std::function<void()> on_page_rendered;
+
+    std::mutex mutex;
+    std::condition_variable has_jobs;
+    std::vector<QByteArray> pages;
+    std::map<key, cached_image> images;
+    uint64_t nb_uses;
+    std::size_t memory_budget;
+    std::size_t memory_usage;
+    unsigned int current_page;
+    unsigned int next_page;
+    std::deque<key> jobs;
+    uint64_t generation; // incremented on each set_pages, to drop pages rendered for a previous song
+    bool is_stopping;
+    int last_width;
+
+    uint64_t nb_hits;
+    uint64_t nb_misses;
+    uint64_t nb_prefetches;
+    uint64_t nb_repaints;
+    std::chrono::nanoseconds total_repaint_time;
+    playback_stats::sheet_rendering sheet_rendering; // since the last take_sheet_rendering
+
+    std::thread worker; // last, as it uses all the other fields
+};
+
+class page_store;
+
+// A music sheet page, painted from the cache when it has it, or from its svg
+// renderer while the cache is being filled.
+class cached_page_item final : public QGraphicsItem
+{
+  public:
+    cached_page_item(page_raster_cache& cache, page_store& pages, unsigned int page);
+
+    cached_page_item(const cached_page_item&) = delete;
+    cached_page_item& operator=(const cached_page_item&) = delete;
+
+    QRectF boundingRect() const override;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+  private:
+    page_raster_cache& cache;
+    page_store& pages;
+    const unsigned int page;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include <stdexcept>
+
+#include "page_store.hh"
+#include "utils.hh"
+#include "trace_events.hh"
+
+page_store::page_store()
+  : pages()
+  , lru()
+  , memory_budget(DEFAULT_MEMORY_BUDGET)
+  , memory_usage(0)
+  , compressed_size(0)
+  , current_page(NO_PAGE)
+  , next_page(NO_PAGE)
+{
+}
+
+void page_store::set_memory_budget(const std::size_t budget)
+{
+  memory_budget = budget;
+  evict();
+}
+
+void page_store::clear()
+{
+  lru.clear();
+  pages.clear();
+  memory_usage = 0;
+  compressed_size = 0;
+  current_page = NO_PAGE;
+  next_page = NO_PAGE;
+}
+
+void page_store::set_pages(std::vector<svg_data> svg_files)
+{
+  clear();
+  pages.reserve(svg_files.size());
+
+  for (auto& svg_file : svg_files)
+  {
+    trace_span span ("parse_page");
+    span.set_arg("page", static_cast<int64_t>(pages.size()));
+    const char* const svg = static_cast<const char*>(static_cast<const void*>(svg_file.data.data()));
+    const QByteArray music_sheet (svg, static_cast<int>(svg_file.data.size()));
+
+    auto renderer = std::make_unique<QSvgRenderer>();
+    if (not renderer->load(music_sheet))
+    {
+      clear();
+      throw std::runtime_error("Invalid file format: failed to parse a music sheet page.");
+    }
+
+    pages.emplace_back(page{ qCompress(music_sheet),
+			     svg_file.data.size(),
+			     ::get_first_svg_line(svg_file.data),
+			     renderer->defaultSize(),
+			     renderer->viewBoxF(),
+			     nullptr,
+			     lru.end() });
+    compressed_size += static_cast<std::size_t>(pages.back().compressed_svg.size());
+    memory_usage += static_cast<std::size_t>(pages.back().compressed_svg.size());
+
+    // the raw svg is not needed anymore
+    svg_file.data = std::vector<uint8_t>();
+
+    // keep the renderer if there is room for it, the first pages are the first needed.
+    if (memory_usage + pages.back().svg_size <= memory_budget)
+    {
+      pages.back().renderer = std::move(renderer);
+      lru.push_back(static_cast<unsigned int>(pages.size() - 1));
+      pages.back().lru_pos = std::prev(lru.end());
+      memory_usage += pages.back().svg_size;
+    }
+  }
+}
+
+std::vector<QByteArray> page_store::get_compressed_pages() const
+{
+  std::vector<QByteArray> res;
+  res.reserve(pages.size());
+  for (const auto& sheet : pages)
+  {
+    res.emplace_back(sheet.compressed_svg);
+  }
+
+  return res;
+}
+
+const std::string& page_store::get_first_svg_line(const unsigned int page_num) const
+{
+  return pages.at(page_num).svg_first_line;
+}
+
+QSize page_store::get_default_size(const unsigned int page_num) const
+{
+  return pages.at(page_num).default_size;
+}
+
+QRectF page_store::get_viewbox(const unsigned int page_num) const
+{
+  return pages.at(page_num).viewbox;
+}
+
+QSvgRenderer& page_store::get_renderer(const unsigned int page_num)
+{
+  auto& sheet = pages.at(page_num);
+  if (sheet.renderer == nullptr)
+  {
+    trace_span span ("parse_page");
+    span.set_arg("page", page_num);
+    sheet.renderer = std::make_unique<QSvgRenderer>();
+    sheet.renderer->load(qUncompress(sheet.compressed_svg));
+    lru.push_front(page_num);
+    memory_usage += sheet.svg_size;
+  }
+  else
+  {
+    lru.splice(lru.begin(), lru, sheet.lru_pos);
+  }
+
+  sheet.lru_pos = lru.begin();
+  evict();
+
+  return *sheet.renderer;
+}
+
+void page_store::set_working_set(const unsigned int current, const unsigned int next)
+{
+  current_page = current;
+  next_page = next;
+}
+
+void page_store::evict()
+{
+  // the most recently used page is never evicted, it is the one being used.
+  auto pos = lru.end();
+  while ((memory_usage > memory_budget) and (pos != lru.begin()) and (std::prev(pos) != lru.begin()))
+  {
+    --pos;
+    const auto page_num = *pos;
+    if ((page_num == current_page) or (page_num == next_page))
+    {
+      continue;
+    }
+
+    auto& sheet = pages[page_num];
+    sheet.renderer.reset();
+    memory_usage -= sheet.svg_size;
+    pos = lru.erase(pos);
+  }
+}
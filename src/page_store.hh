@@ -0,0 +1,85 @@
+#ifndef PAGE_STORE_HH
+#define PAGE_STORE_HH
+
+#include <cstddef>
+#include <limits>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QByteArray>
+#include <QRectF>
+#include <QSize>
+#include <QSvgRenderer>
+
+#include "bin_file_reader.hh"
+
+// The music sheet pages of a song, kept compressed in memory. Their svg
+// renderers are parsed on demand and the least recently used ones are
+// evicted when they exceed the memory budget, except for the current and
+// next pages which stay resident.
+class page_store
+{
+  public:
+    static constexpr const std::size_t DEFAULT_MEMORY_BUDGET = 64 * 1024 * 1024;
+    static constexpr const unsigned int NO_PAGE = std::numeric_limits<unsigned int>::max();
+
+    page_store();
+
+    page_store(const page_store&) = delete;
+    page_store& operator=(const page_store&) = delete;
+    page_store(page_store&&) = default;
+    page_store& operator=(page_store&&) = default;
+
+    // budget of the parsed pages, estimated from the size of their svg
+    void set_memory_budget(std::size_t budget);
+
+    // parses each page once to check it and get its geometry. Throws an
+    // exception if a page is invalid.
+    void set_pages(std::vector<svg_data> svg_files);
+    void clear();
+
+    std::size_t size() const { return pages.size(); }
+
+    // compressed with qCompress, to be shared with other threads
+    std::vector<QByteArray> get_compressed_pages() const;
+
+    const std::string& get_first_svg_line(unsigned int page) const;
+    QSize get_default_size(unsigned int page) const;
+    QRectF get_viewbox(unsigned int page) const;
+
+    // the renderer may be evicted by the next call.
+    QSvgRenderer& get_renderer(unsigned int page);
+
+    // pages which must not be evicted. NO_PAGE for none.
+    void set_working_set(unsigned int current_page, unsigned int next_page);
+
+    std::size_t get_memory_usage() const { return memory_usage; }
+    std::size_t get_compressed_size() const { return compressed_size; }
+    std::size_t get_parsed_size() const { return memory_usage - compressed_size; } // estimation
+
+  private:
+    struct page
+    {
+	QByteArray compressed_svg;
+	std::size_t svg_size;
+	std::string svg_first_line;
+	QSize default_size;
+	QRectF viewbox;
+	std::unique_ptr<QSvgRenderer> renderer;
+	std::list<unsigned int>::iterator lru_pos;
+    };
+
+    void evict();
+
+    std::vector<page> pages;
+    std::list<unsigned int> lru; // parsed pages, most recently used first
+    std::size_t memory_budget;
+    std::size_t memory_usage; // compressed pages and estimation of the parsed ones
+    std::size_t compressed_size;
+    unsigned int current_page;
+    unsigned int next_page;
+};
+
+#endif
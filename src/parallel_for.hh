@@ -0,0 +1,47 @@
+#ifndef PARALLEL_FOR_HH
+#define PARALLEL_FOR_HH
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Calls func(i) for each i in [0, nb_items[ using all the available cores.
+// Items are handed out one at a time, so slow items don't leave other cores idle.
+// func is called concurrently and must not throw.
+template <typename Func>
+void parallel_for(const std::size_t nb_items, const Func& func)
+{
+  std::atomic<std::size_t> next_item {0};
+  const auto worker = [&] () {
+    for (auto i = next_item++; i < nb_items; i = next_item++)
+    {
+      func(i);
+    }
+  };
+
+  const auto nb_cores = std::max(std::thread::hardware_concurrency(), 1u);
+  const auto nb_threads = std::min(std::size_t{nb_cores}, nb_items);
+  if (nb_threads <= 1)
+  {
+    worker();
+    return;
+  }
+
+  std::vector<std::thread> threads;
+  threads.reserve(nb_threads - 1);
+  for (auto i = decltype(nb_threads){1}; i < nb_threads; ++i)
+  {
+    threads.emplace_back(worker);
+  }
+
+  worker();
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+}
+
+#endif /* PARALLEL_FOR_HH */
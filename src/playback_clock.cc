@@ -0,0 +1,21 @@
+#include <algorithm>
+
+#include "playback_clock.hh"
+
+playback_clock::~playback_clock() = default;
+
+std::chrono::nanoseconds steady_playback_clock::now() const
+{
+  return std::chrono::steady_clock::now().time_since_epoch();
+}
+
+virtual_clock::virtual_clock()
+  : playback_clock()
+  , time(0)
+{
+}
+
+void virtual_clock::advance_to(const std::chrono::nanoseconds new_time)
+{
+  time = std::max(time, new_time);
+}
@@ -0,0 +1,36 @@
+#ifndef PLAYBACK_CLOCK_HH
+#define PLAYBACK_CLOCK_HH
+
+#include <chrono>
+
+// Time source of the playback, in ns since an arbitrary origin.
+class playback_clock
+{
+  public:
+    virtual ~playback_clock();
+    virtual std::chrono::nanoseconds now() const = 0;
+};
+
+class steady_playback_clock final : public playback_clock
+{
+  public:
+    std::chrono::nanoseconds now() const override;
+};
+
+// Only moves forward when told to, so that a whole song can be played faster
+// than real time, with the exact times the messages would be sent at.
+class virtual_clock final : public playback_clock
+{
+  public:
+    virtual_clock();
+
+    std::chrono::nanoseconds now() const override { return time; }
+
+    // does nothing if time is in the past
+    void advance_to(std::chrono::nanoseconds new_time);
+
+  private:
+    std::chrono::nanoseconds time;
+};
+
+#endif /* PLAYBACK_CLOCK_HH */
@@ -0,0 +1,62 @@
+#include "playback_stats.hh"
+
+playback_stats::playback_stats()
+  : event_lateness()
+  , event_processing_times()
+  , page_turn_times()
+  , nb_frames(0)
+  , nb_midi_in(0)
+  , nb_midi_out(0)
+  , window_start(std::chrono::steady_clock::now())
+{
+}
+
+void playback_stats::clear()
+{
+  event_lateness.clear();
+  event_processing_times.clear();
+  page_turn_times.clear();
+  nb_frames = 0;
+  nb_midi_in = 0;
+  nb_midi_out = 0;
+  window_start = std::chrono::steady_clock::now();
+}
+
+static double to_ms(const std::chrono::nanoseconds duration)
+{
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+static void print_durations(std::ostream& out, const char* const name, const latency_histogram& durations)
+{
+  out << name << ": ";
+  if (durations.size() == 0)
+  {
+    out << "-\n";
+    return;
+  }
+
+  out << "p50 " << to_ms(durations.get_percentile(50)) << " ms, "
+      << "p99 " << to_ms(durations.get_percentile(99)) << " ms, "
+      << "max " << to_ms(durations.get_max()) << " ms\n";
+}
+
+void playback_stats::print(std::ostream& out, const sheet_rendering& rendering, const memory_footprint& memory)
+{
+  const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - window_start).count();
+  const auto per_second = [elapsed] (const uint64_t nb) {
+    return (elapsed <= 0.0) ? 0.0 : (static_cast<double>(nb) / elapsed);
+  };
+
+  print_durations(out, "event lateness", event_lateness);
+  print_durations(out, "event processing", event_processing_times);
+  print_durations(out, "page turn", page_turn_times);
+  out << "page rendering: " << per_second(rendering.nb_renders) << "/s, max " << to_ms(rendering.max_render_time) << " ms\n"
+      << "music sheet repaints: " << per_second(rendering.nb_repaints) << "/s, max " << to_ms(rendering.max_repaint_time) << " ms\n"
+      << "frames: " << per_second(nb_frames) << "/s\n"
+      << "midi messages: " << per_second(nb_midi_in) << "/s in, " << per_second(nb_midi_out) << "/s out\n"
+      << "\nmemory\n";
+  print_memory_footprint(memory, out);
+
+  clear();
+}
@@ -0,0 +1,54 @@
+#ifndef PLAYBACK_STATS_HH
+#define PLAYBACK_STATS_HH
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#include "latency_histogram.hh"
+#include "memory_footprint.hh"
+
+// Live counters of the playback, shown in the statistics overlay. Updating
+// them costs a couple of additions, so that they can stay in release builds.
+// They are summed up over the time elapsed between two calls to print.
+class playback_stats
+{
+  public:
+    // pages rendered by the worker thread and music sheet repaints
+    struct sheet_rendering
+    {
+	uint64_t nb_renders;
+	std::chrono::nanoseconds max_render_time;
+	uint64_t nb_repaints;
+	std::chrono::nanoseconds max_repaint_time;
+    };
+
+    playback_stats();
+
+    // time between when an event should have been played and when it was
+    void add_event_lateness(std::chrono::nanoseconds lateness) { event_lateness.add(lateness); }
+    void add_event_processing_time(std::chrono::nanoseconds duration) { event_processing_times.add(duration); }
+    // time to replace the displayed page by the next one
+    void add_page_turn_time(std::chrono::nanoseconds duration) { page_turn_times.add(duration); }
+    void add_frame() { ++nb_frames; }
+    void add_midi_in(const uint64_t nb_messages) { nb_midi_in += nb_messages; }
+    void add_midi_out(const uint64_t nb_messages) { nb_midi_out += nb_messages; }
+
+    // restarts the counters. The first print afterwards covers the time since then.
+    void clear();
+
+    // prints the counters since the previous call, then resets them.
+    void print(std::ostream& out, const sheet_rendering& rendering, const memory_footprint& memory);
+
+  private:
+    latency_histogram event_lateness;
+    latency_histogram event_processing_times;
+    latency_histogram page_turn_times;
+    uint64_t nb_frames;
+    uint64_t nb_midi_in;
+    uint64_t nb_midi_out;
+    std::chrono::steady_clock::time_point window_start;
+};
+
+#endif /* PLAYBACK_STATS_HH */
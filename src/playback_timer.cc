@@ -0,0 +1,28 @@
+#include "playback_timer.hh"
+
+playback_timer::playback_timer()
+  : on_timeout()
+{
+}
+
+playback_timer::~playback_timer() = default;
+
+manual_playback_timer::manual_playback_timer(const playback_clock& playback_time)
+  : playback_timer()
+  , clock(playback_time)
+  , deadline(0)
+  , is_running(false)
+{
+}
+
+void manual_playback_timer::start(const std::chrono::milliseconds delay)
+{
+  deadline = clock.now() + delay;
+  is_running = true;
+}
+
+void manual_playback_timer::expire()
+{
+  is_running = false;
+  timeout();
+}
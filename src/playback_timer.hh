@@ -0,0 +1,63 @@
+#ifndef PLAYBACK_TIMER_HH
+#define PLAYBACK_TIMER_HH
+
+#include <chrono>
+#include <functional>
+
+#include "playback_clock.hh"
+
+// Wakes the player up once, after a delay, on the thread playing the song.
+class playback_timer
+{
+  public:
+    playback_timer();
+    virtual ~playback_timer();
+
+    playback_timer(const playback_timer&) = delete;
+    playback_timer& operator=(const playback_timer&) = delete;
+
+    // called each time the timer expires
+    void set_timeout_handler(std::function<void()> handler) { on_timeout = std::move(handler); }
+
+    // replaces the pending wake up, if any
+    virtual void start(std::chrono::milliseconds delay) = 0;
+    virtual void stop() = 0;
+    virtual bool is_active() const = 0;
+
+  protected:
+    void timeout() const
+    {
+      if (on_timeout)
+      {
+	on_timeout();
+      }
+    }
+
+  private:
+    std::function<void()> on_timeout;
+};
+
+// Only expires when told to. Along with a virtual_clock, a song can then be
+// played as fast as possible, at the exact times it would be played at.
+class manual_playback_timer final : public playback_timer
+{
+  public:
+    explicit manual_playback_timer(const playback_clock& clock);
+
+    void start(std::chrono::milliseconds delay) override;
+    void stop() override { is_running = false; }
+    bool is_active() const override { return is_running; }
+
+    // when the pending wake up is due
+    std::chrono::nanoseconds get_deadline() const { return deadline; }
+
+    // stops the timer and calls the handler, as if the delay had elapsed
+    void expire();
+
+  private:
+    const playback_clock& clock;
+    std::chrono::nanoseconds deadline;
+    bool is_running;
+};
+
+#endif /* PLAYBACK_TIMER_HH */
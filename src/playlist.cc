@@ -0,0 +1,58 @@
+#include <utility>
+
+#include "playlist.hh"
+#include "page_raster_cache.hh"
+#include "utils.hh"
+#include "trace_events.hh"
+#include "memory_footprint.hh"
+
+prepared_song prepare_song(const std::string& filename, const int page_width, const std::size_t memory_budget)
+{
+  trace_span span ("prepare_song");
+  prepared_song res { filename, get_song_within_budget(filename, memory_budget), 0, page_store(), QImage() };
+
+  res.last_measure = find_last_measure(res.song.events);
+  to_waiting_times(res.song.events);
+
+  // the pages are only checked here. The ones displayed get parsed again by
+  // the gui thread, which uses them.
+  res.pages.set_memory_budget(0);
+  res.pages.set_pages(std::move(res.song.svg_files));
+  res.song.svg_files.clear();
+
+  if ((page_width > 0) and (res.pages.size() != 0))
+  {
+    trace_span render_span ("prepare_song/render_first_page");
+    res.first_page = page_raster_cache::render_page(res.pages.get_compressed_pages().front(), page_width);
+  }
+
+  return res;
+}
+
+playlist::playlist()
+  : files()
+  , next_song()
+{
+}
+
+void playlist::add(const std::string& filename)
+{
+  files.push_back(filename);
+}
+
+void playlist::preload_next(const int page_width, const std::size_t memory_budget)
+{
+  if ((not files.empty()) and (not next_song.valid()))
+  {
+    next_song = std::async(std::launch::async, prepare_song, files.front(), page_width, memory_budget);
+  }
+}
+
+prepared_song playlist::take_next(const int page_width, const std::size_t memory_budget)
+{
+  preload_next(page_width, memory_budget);
+  files.pop_front();
+
+  // get invalidates next_song, so that the following file gets preloaded.
+  return next_song.get();
+}
@@ -0,0 +1,58 @@
+#ifndef PLAYLIST_HH
+#define PLAYLIST_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <string>
+
+#include <QImage>
+
+#include "bin_file_reader.hh"
+#include "page_store.hh"
+
+// A song ready to be swapped in: decoded, with waiting times computed, its
+// music sheet pages checked and compressed, and its first page rasterised.
+struct prepared_song
+{
+    std::string filename;
+    bin_song_t song;
+    uint16_t last_measure;
+    page_store pages; // without any parsed page, renderers belong to the gui thread
+    QImage first_page; // null if the page width was unknown
+};
+
+// Can be called from any thread. Throws an exception if the file can't be
+// played. The first page is rasterised at page_width, if positive. Songs
+// whose music sheet doesn't fit in memory_budget are prepared without it.
+prepared_song prepare_song(const std::string& filename, int page_width, std::size_t memory_budget);
+
+// The files to play after the current song. The first one is prepared on a
+// background thread while the current song plays, so that swapping to it
+// doesn't wait for the file to be read and its music sheet to be parsed.
+class playlist
+{
+  public:
+    playlist();
+
+    playlist(const playlist&) = delete;
+    playlist& operator=(const playlist&) = delete;
+
+    void add(const std::string& filename);
+    bool empty() const { return files.empty(); }
+    const std::deque<std::string>& get_files() const { return files; }
+
+    // starts preparing the first file, unless it is already.
+    void preload_next(int page_width, std::size_t memory_budget);
+
+    // removes the first file from the playlist and returns it, waiting for it
+    // to be prepared if needed. Rethrows the error if it failed to load.
+    prepared_song take_next(int page_width, std::size_t memory_budget);
+
+  private:
+    std::deque<std::string> files;
+    std::future<prepared_song> next_song; // preparation of files.front()
+};
+
+#endif
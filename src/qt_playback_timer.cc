@@ -0,0 +1,17 @@
+#include "qt_playback_timer.hh"
+
+qt_playback_timer::qt_playback_timer()
+  : playback_timer()
+  , timer()
+{
+  timer.setSingleShot(true);
+  timer.setTimerType(Qt::PreciseTimer);
+  QObject::connect(&timer, &QTimer::timeout, [this] () {
+      timeout();
+    });
+}
+
+void qt_playback_timer::start(const std::chrono::milliseconds delay)
+{
+  timer.start(static_cast<int>(delay.count()));
+}
@@ -0,0 +1,22 @@
+#ifndef QT_PLAYBACK_TIMER_HH
+#define QT_PLAYBACK_TIMER_HH
+
+#include <QTimer>
+
+#include "playback_timer.hh"
+
+// Single shot QTimer, expiring in the Qt event loop of the gui thread.
+class qt_playback_timer final : public playback_timer
+{
+  public:
+    qt_playback_timer();
+
+    void start(std::chrono::milliseconds delay) override;
+    void stop() override { timer.stop(); }
+    bool is_active() const override { return timer.isActive(); }
+
+  private:
+    QTimer timer;
+};
+
+#endif /* QT_PLAYBACK_TIMER_HH */
@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio> // for std::rename
+#include <cstdlib> // for std::getenv, realpath and free
+#include <cstring> // for std::strlen
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <sys/stat.h>
+
+#include "score_library.hh"
+#include "bin_file_reader.hh"
+#include "parallel_for.hh"
+#include "utils.hh"
+
+// first line of the index file, to be changed along with its format. The
+// other lines are one file each, with its fields separated by tabs. The
+// instrument names come last as there can be any number of them.
+static const std::string INDEX_HEADER = "lilyplayer library index 1";
+
+static bool get_file_stamp(const std::string& path, int64_t& mtime, uint64_t& size)
+{
+  struct stat file_stat;
+  if (stat(path.c_str(), &file_stat) != 0)
+  {
+    return false;
+  }
+
+  mtime = int64_t{file_stat.st_mtim.tv_sec} * 1'000'000'000 + file_stat.st_mtim.tv_nsec;
+  size = static_cast<uint64_t>(file_stat.st_size);
+  return true;
+}
+
+static std::string get_canonical_path(const std::string& path)
+{
+  const auto canonical_path = realpath(path.c_str(), nullptr);
+  if (canonical_path == nullptr)
+  {
+    throw std::runtime_error(std::string{"Error: can't find ["} + path + "]");
+  }
+
+  const std::string res { canonical_path };
+  free(canonical_path);
+  return res;
+}
+
+static bool is_in_dir(const std::string& path, const std::string& dir)
+{
+  return (path == dir) or begins_by(path, (dir + "/").c_str());
+}
+
+static bool has_separator(const std::string& str)
+{
+  return str.find_first_of("\t\n") != std::string::npos;
+}
+
+static void make_parent_directories(const std::string& path)
+{
+  for (auto pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1))
+  {
+    const auto dir = path.substr(0, pos);
+    if ((mkdir(dir.c_str(), 0755) != 0) and (errno != EEXIST))
+    {
+      throw std::runtime_error(std::string{"Error: failed to create directory ["} + dir + "]");
+    }
+  }
+}
+
+// the lilyplayer files and the standard midi files
+static std::vector<std::string> find_song_files(const std::string& dir)
+{
+  return find_files(dir, { ".bin", ".mid", ".midi" });
+}
+
+// the header and the events only, the music sheet pages are skipped over.
+static score_info read_score_info(const std::string& path, const int64_t mtime, const uint64_t size)
+{
+  const auto song = get_song(path, music_sheet_loading::skip);
+
+  const auto name_pos = path.rfind('/');
+  auto title = path.substr((name_pos == std::string::npos) ? 0 : name_pos + 1);
+  for (const auto extension : { ".bin", ".mid", ".midi" })
+  {
+    if (ends_by(title, extension))
+    {
+      title.resize(title.size() - std::strlen(extension));
+    }
+  }
+
+  // get_song fails on songs without events. Times are still in ns since the beginning.
+  return score_info{ path, mtime, size, std::move(title), song.instr_names,
+		     song.events.back().time / 1'000'000,
+		     find_last_measure(song.events),
+		     song.nb_pages };
+}
+
+static std::vector<std::string> split(const std::string& line, const char separator)
+{
+  std::vector<std::string> res;
+  std::string::size_type begin = 0;
+  for (auto end = line.find(separator); end != std::string::npos; end = line.find(separator, begin))
+  {
+    res.emplace_back(line.substr(begin, end - begin));
+    begin = end + 1;
+  }
+
+  res.emplace_back(line.substr(begin));
+  return res;
+}
+
+// returns false if the line is invalid
+static bool parse_index_entry(const std::string& line, score_info& res)
+{
+  constexpr const std::size_t nb_fixed_fields = 7;
+  auto fields = split(line, '\t');
+  if (fields.size() < nb_fixed_fields)
+  {
+    return false;
+  }
+
+  try
+  {
+    const auto nb_measures = std::stoul(fields[5]);
+    const auto nb_pages = std::stoul(fields[6]);
+    if ((nb_measures > 0xFFFF) or (nb_pages > 0xFFFF))
+    {
+      return false;
+    }
+
+    res.path = std::move(fields[0]);
+    res.mtime = std::stoll(fields[1]);
+    res.size = std::stoull(fields[2]);
+    res.title = std::move(fields[3]);
+    res.duration_ms = std::stoull(fields[4]);
+    res.nb_measures = static_cast<uint16_t>(nb_measures);
+    res.nb_pages = static_cast<uint16_t>(nb_pages);
+    res.instr_names.assign(std::make_move_iterator(fields.begin() + nb_fixed_fields),
+			   std::make_move_iterator(fields.end()));
+  }
+  catch (std::exception&)
+  {
+    return false;
+  }
+
+  return true;
+}
+
+score_library::score_library(std::string index_file_path)
+  : index_path(std::move(index_file_path))
+  , scores()
+  , is_loaded(false)
+{
+}
+
+void score_library::load()
+{
+  is_loaded = true;
+  scores.clear();
+
+  // the index is only a cache, the files get read again if it is unusable.
+  std::ifstream in (index_path);
+  std::string line;
+  if ((not std::getline(in, line)) or (line != INDEX_HEADER))
+  {
+    return;
+  }
+
+  while (std::getline(in, line))
+  {
+    score_info score {};
+    if (parse_index_entry(line, score))
+    {
+      scores.emplace_back(std::move(score));
+    }
+  }
+
+  std::sort(scores.begin(), scores.end(), [] (const auto& a, const auto& b) {
+      return a.path < b.path;
+    });
+}
+
+void score_library::save() const
+{
+  make_parent_directories(index_path);
+
+  // written next to it then renamed, so that the index is never half written.
+  const auto tmp_path = index_path + ".tmp";
+  std::ofstream out (tmp_path);
+  out << INDEX_HEADER << "\n";
+  for (const auto& score : scores)
+  {
+    const auto is_storable = not (has_separator(score.path) or has_separator(score.title) or
+				  std::any_of(score.instr_names.cbegin(), score.instr_names.cend(), has_separator));
+    if (not is_storable)
+    {
+      continue; // will be read again on the next scan
+    }
+
+    out << score.path << '\t' << score.mtime << '\t' << score.size << '\t'
+	<< score.title << '\t' << score.duration_ms << '\t'
+	<< score.nb_measures << '\t' << score.nb_pages;
+    for (const auto& instr_name : score.instr_names)
+    {
+      out << '\t' << instr_name;
+    }
+    out << '\n';
+  }
+
+  out.close();
+  if ((not out) or (std::rename(tmp_path.c_str(), index_path.c_str()) != 0))
+  {
+    throw std::runtime_error(std::string{"Error: failed to write the library index ["} + index_path + "]");
+  }
+}
+
+score_library::scan_result score_library::scan(const std::string& dir)
+{
+  if (not is_loaded)
+  {
+    load();
+  }
+
+  scan_result res { 0, 0, 0, {} };
+  const auto canonical_dir = get_canonical_path(dir);
+  const auto filenames = find_song_files(canonical_dir);
+
+  // the scores of other directories are kept as is
+  std::vector<score_info> new_scores;
+  new_scores.reserve(scores.size() + filenames.size());
+  for (const auto& score : scores)
+  {
+    if (not is_in_dir(score.path, canonical_dir))
+    {
+      new_scores.push_back(score);
+    }
+  }
+
+  // the files which didn't change since the last scan are not read again
+  std::vector<score_info> to_read;
+  std::size_t nb_found_in_index = 0;
+  for (const auto& filename : filenames)
+  {
+    score_info stamp {};
+    stamp.path = filename;
+    if (not get_file_stamp(filename, stamp.mtime, stamp.size))
+    {
+      res.errors.emplace_back(filename + ": can't get its modification time");
+      continue;
+    }
+
+    const auto indexed = std::lower_bound(scores.cbegin(), scores.cend(), filename, [] (const auto& score, const auto& path) {
+	return score.path < path;
+      });
+
+    const auto is_indexed = (indexed != scores.cend()) and (indexed->path == filename);
+    nb_found_in_index += is_indexed ? 1 : 0;
+    if (is_indexed and (indexed->mtime == stamp.mtime) and (indexed->size == stamp.size))
+    {
+      new_scores.push_back(*indexed);
+      ++res.nb_unchanged;
+    }
+    else
+    {
+      to_read.emplace_back(std::move(stamp));
+    }
+  }
+
+  // each thread only writes its own slot, errors are reported afterwards in order.
+  const auto nb_to_read = to_read.size();
+  std::vector<std::string> errors (nb_to_read);
+  parallel_for(nb_to_read, [&] (const std::size_t i) {
+      try
+      {
+	to_read[i] = read_score_info(to_read[i].path, to_read[i].mtime, to_read[i].size);
+      }
+      catch (std::exception& e)
+      {
+	errors[i] = e.what();
+      }
+    });
+
+  for (auto i = decltype(nb_to_read){0}; i < nb_to_read; ++i)
+  {
+    if (errors[i].empty())
+    {
+      new_scores.emplace_back(std::move(to_read[i]));
+      ++res.nb_read;
+    }
+    else
+    {
+      res.errors.emplace_back(to_read[i].path + ": " + errors[i]);
+    }
+  }
+
+  const auto nb_previously_indexed = static_cast<std::size_t>(std::count_if(scores.cbegin(), scores.cend(), [&] (const auto& score) {
+	return is_in_dir(score.path, canonical_dir);
+      }));
+  res.nb_removed = nb_previously_indexed - nb_found_in_index;
+
+  std::sort(new_scores.begin(), new_scores.end(), [] (const auto& a, const auto& b) {
+      return a.path < b.path;
+    });
+  scores = std::move(new_scores);
+
+  return res;
+}
+
+std::vector<score_info> score_library::get_scores(const std::string& dir) const
+{
+  const auto canonical_dir = get_canonical_path(dir);
+
+  std::vector<score_info> res;
+  std::copy_if(scores.cbegin(), scores.cend(), std::back_inserter(res), [&] (const auto& score) {
+      return is_in_dir(score.path, canonical_dir);
+    });
+  return res;
+}
+
+std::string get_default_library_index_path()
+{
+  const auto cache_home = std::getenv("XDG_CACHE_HOME");
+  if ((cache_home != nullptr) and (cache_home[0] != '\0'))
+  {
+    return std::string{cache_home} + "/lilyplayer/library.index";
+  }
+
+  const auto home = std::getenv("HOME");
+  return std::string{(home != nullptr) ? home : "."} + "/.cache/lilyplayer/library.index";
+}
+
+void print_scan_result(const score_library::scan_result& result, std::ostream& out)
+{
+  out << "Library: " << result.nb_read << " files read, "
+      << result.nb_unchanged << " unchanged, "
+      << result.nb_removed << " removed, "
+      << result.errors.size() << " failed\n";
+
+  for (const auto& error : result.errors)
+  {
+    out << error << "\n";
+  }
+}
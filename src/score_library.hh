@@ -0,0 +1,63 @@
+#ifndef SCORE_LIBRARY_HH
+#define SCORE_LIBRARY_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// What the library view shows about a .bin file, read without its music sheet.
+struct score_info
+{
+    std::string path;
+    int64_t mtime; // in ns, to find out if the file changed since it was indexed
+    uint64_t size;
+
+    std::string title; // the file name, the format has no title
+    std::vector<std::string> instr_names;
+    uint64_t duration_ms;
+    uint16_t nb_measures;
+    uint16_t nb_pages;
+};
+
+// The .bin files found in some directories, indexed in a file so that
+// browsing them again only reads the new and modified ones.
+class score_library
+{
+  public:
+    struct scan_result
+    {
+	std::size_t nb_read;
+	std::size_t nb_unchanged;
+	std::size_t nb_removed;
+	std::vector<std::string> errors; // one per file which couldn't be read
+    };
+
+    explicit score_library(std::string index_path);
+
+    // Reads the files of the directory which aren't indexed yet or changed
+    // since, in parallel, and forgets about the ones removed from it.
+    // Loads the index file first if it wasn't already.
+    scan_result scan(const std::string& dir);
+
+    // writes the index file atomically. Throws an exception on failure.
+    void save() const;
+
+    // sorted by path
+    std::vector<score_info> get_scores(const std::string& dir) const;
+
+  private:
+    void load(); // a missing or invalid index file is an empty one
+
+    const std::string index_path;
+    std::vector<score_info> scores; // sorted by path
+    bool is_loaded;
+};
+
+// $XDG_CACHE_HOME/lilyplayer/library.index, or ~/.cache/lilyplayer/library.index
+std::string get_default_library_index_path();
+
+void print_scan_result(const score_library::scan_result& result, std::ostream& out);
+
+#endif /* SCORE_LIBRARY_HH */
@@ -1,20 +1,16 @@
 #include <signal.h>
-#include <cstring> // for memset
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstring> // for strerror
 #include <cerrno>
 #include <stdexcept>
 #include <string>
 
 #include "signals_handler.hh"
 
-extern volatile sig_atomic_t pause_requested;
-extern volatile sig_atomic_t continue_requested;
-extern volatile sig_atomic_t exit_requested;
-extern volatile sig_atomic_t new_signal_received;
-
-volatile sig_atomic_t pause_requested = 0;
-volatile sig_atomic_t continue_requested = 0;
-volatile sig_atomic_t exit_requested = 0;
-volatile sig_atomic_t new_signal_received = 0;
+// readable when one of the handled signals is pending
+static int signal_fd = -1;
 
 static
 const char* signum_to_str(int signum)
@@ -58,25 +54,22 @@ const char* signum_to_str(int signum)
   }
 }
 
-static void signal_handler(int signum)
+static void add_request(const uint32_t signum, struct signal_requests& requests)
 {
   switch (signum)
   {
     case SIGTSTP:
-      new_signal_received = 1;
-      pause_requested = 1;
+      requests.pause = true;
       break;
 
     case SIGCONT: // Continue if stopped
-      new_signal_received = 1;
-      continue_requested = 1;
+      requests.resume = true;
       break;
 
     case SIGQUIT: // stop program
     case SIGTERM:
     case SIGINT:  // Interrupt from keyboard
-      new_signal_received = 1;
-      exit_requested = 1;
+      requests.exit = true;
       break;
 
     case SIGUSR1: // User-defined signal 1
@@ -86,27 +79,37 @@ static void signal_handler(int signum)
   }
 }
 
+struct signal_requests read_signal_requests()
+{
+  struct signal_requests res { false, false, false };
+
+  struct signalfd_siginfo infos[8];
+  while (true)
+  {
+    const auto nb_read = read(signal_fd, infos, sizeof(infos));
+    if (nb_read <= 0)
+    {
+      // EAGAIN: no more pending signals
+      return res;
+    }
 
-#if defined(__clang__)
-  // clang will complain that sa_handler is a recursive macro.
-  // It issue this warning even when explictly disabling warnings from system headers
-  // using -Wno-system-headers Below is the error it produces.
-  //
-  // signals_handler.cc:102:6: error: disabled expansion of recursive macro
-  //       [-Werror,-Wdisabled-macro-expansion]
-  //   sa.sa_handler = &signal_handler;
-  //      ^
-  // /usr/include/i386-linux-gnu/bits/sigaction.h:36:41: note: expanded from macro 'sa_handler'
-  // # define sa_handler     __sigaction_handler.sa_handler
-  #pragma clang diagnostic push
-  #pragma clang diagnostic ignored "-Wdisabled-macro-expansion"
-#endif
+    const auto nb_infos = static_cast<std::size_t>(nb_read) / sizeof(infos[0]);
+    for (std::size_t i = 0; i < nb_infos; ++i)
+    {
+      add_request(infos[i].ssi_signo, res);
+    }
+  }
+}
+
+int get_signal_fd()
+{
+  return signal_fd;
+}
 
 void set_signal_handler()
 {
-  struct sigaction sa;
-  std::memset(&sa, 0, sizeof(struct sigaction));
-  sa.sa_handler = &signal_handler;
+  sigset_t signals;
+  sigemptyset(&signals);
 
   for (const auto signum : { SIGINT, // Interrupt from keyboard
 			     SIGCONT, // Continue if stopped
@@ -117,15 +120,23 @@ void set_signal_handler()
 			     SIGUSR2 // User-defined signal 2
 			   })
   {
-    if (sigaction(signum, &sa, nullptr) == -1)
+    if (sigaddset(&signals, signum) == -1)
     {
-
       throw std::runtime_error(std::string{"Error while setting the interrupt hangler for signal "} + signum_to_str(signum) +
 			       " (" + std::strerror(errno) + ")");
     }
   }
 
+  // blocked signals are not delivered anymore, they stay pending until read
+  // from the signalfd. Threads started later inherit this mask.
+  if (sigprocmask(SIG_BLOCK, &signals, nullptr) == -1)
+  {
+    throw std::runtime_error(std::string{"Error while blocking the handled signals ("} + std::strerror(errno) + ")");
+  }
+
+  signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (signal_fd == -1)
+  {
+    throw std::runtime_error(std::string{"Error while creating the signal file descriptor ("} + std::strerror(errno) + ")");
+  }
 }
-#if defined(__clang__)
-  #pragma clang diagnostic pop
-#endif
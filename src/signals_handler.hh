@@ -1,6 +1,22 @@
 #ifndef SIGNALS_HANDLER_HH_
 #define SIGNALS_HANDLER_HH_
 
+// Blocks the signals handled by lilyplayer and makes them readable from a
+// signalfd instead. Must be called before starting any thread, so they all
+// inherit the signal mask.
 void set_signal_handler();
 
+// becomes readable when a handled signal is received
+int get_signal_fd() __attribute__((pure));
+
+struct signal_requests
+{
+    bool pause;  // SIGTSTP
+    bool resume; // SIGCONT
+    bool exit;   // SIGINT, SIGQUIT or SIGTERM
+};
+
+// reads all the pending signals, without blocking
+struct signal_requests read_signal_requests();
+
 #endif /* SIGNALS_HANDLER_HH_ */
@@ -0,0 +1,124 @@
+#include "song_player.hh"
+#include "trace_events.hh"
+
+song_player::song_player(const playback_clock& playback_time, song_scheduler& song_events, playback_timer& wake_up_timer)
+  : clock(playback_time)
+  , scheduler(song_events)
+  , timer(wake_up_timer)
+  , on_event()
+  , on_end()
+  , is_ready()
+{
+  timer.set_timeout_handler([this] () {
+      play_due_event();
+    });
+}
+
+void song_player::resume()
+{
+  scheduler.resume();
+
+  // the pending event is played right away. If the timer is already running,
+  // the song is already being played.
+  if (not timer.is_active())
+  {
+    scheduler.restart_from_now();
+    timer.start(std::chrono::milliseconds{0});
+  }
+}
+
+void song_player::pause()
+{
+  scheduler.pause();
+  timer.stop();
+}
+
+void song_player::play_due_event()
+{
+  // nothing to play: sleep until resume is called.
+  if (scheduler.is_paused() or (not scheduler.has_song()))
+  {
+    return;
+  }
+
+  // woken up too early, e.g. by the player in practice mode
+  if (scheduler.get_time_to_next_due() > std::chrono::nanoseconds{0})
+  {
+    wait_for_next_event();
+    return;
+  }
+
+  if (scheduler.is_over())
+  {
+    if (on_end)
+    {
+      on_end();
+    }
+    return;
+  }
+
+  if (is_ready and (not is_ready(scheduler.get_pos())))
+  {
+    return;
+  }
+
+  trace_span span ("song_event_loop");
+  span.set_arg("event", scheduler.get_pos());
+
+  const auto lateness = clock.now() - scheduler.get_next_due();
+  const auto event_pos = scheduler.take_due_event();
+  if (on_event)
+  {
+    on_event(event_pos, lateness);
+  }
+
+  // the handler may have paused the song
+  if (not scheduler.is_paused())
+  {
+    wait_for_next_event();
+  }
+}
+
+void song_player::wait_for_next_event()
+{
+  // timers only count in ms: round up so that the event is never taken too early
+  timer.start(std::chrono::ceil<std::chrono::milliseconds>(scheduler.get_time_to_next_due()));
+}
+
+
+std::vector<timed_midi_message> simulate_playback(const std::vector<music_sheet_event>& events,
+						  const unsigned int start, const unsigned int stop,
+						  midi_transform& transform)
+{
+  virtual_clock clock;
+  manual_playback_timer timer (clock);
+  song_scheduler scheduler (clock);
+  song_player player (clock, scheduler, timer);
+  midi_recording_sink sink (clock);
+
+  const auto send = [&sink] (const std::vector<short_midi_message>& messages) {
+    for (const auto& message : messages)
+    {
+      sink.send(message.bytes, sizeof(message.bytes));
+    }
+  };
+
+  player.set_event_handler([&] (const unsigned int event_pos, std::chrono::nanoseconds) {
+      const auto& event = events[event_pos];
+      send(transform.apply(event.keys_down, event.keys_up));
+    });
+
+  scheduler.set_song(events);
+  scheduler.set_range(start, stop);
+  player.resume();
+
+  // the timer is left stopped once the song is over
+  while (timer.is_active())
+  {
+    clock.advance_to(timer.get_deadline());
+    timer.expire();
+  }
+
+  send(transform.release_all());
+  return sink.get_messages();
+}
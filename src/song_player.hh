@@ -0,0 +1,64 @@
+#ifndef SONG_PLAYER_HH
+#define SONG_PLAYER_HH
+
+#include <chrono>
+#include <functional>
+
+#include "playback_clock.hh"
+#include "playback_timer.hh"
+#include "song_scheduler.hh"
+
+// The playback loop of the window: plays each event of the scheduler once it
+// is due, and sleeps on the timer in between. The timer doesn't run while
+// paused, waiting for the player, or once the song is over. What playing an
+// event means is left to the handlers, so that the same loop can be run on a
+// virtual clock and a manual timer.
+class song_player
+{
+  public:
+    // lateness is how long after it was due the event is played
+    using event_handler = std::function<void(unsigned int event_pos, std::chrono::nanoseconds lateness)>;
+
+    // takes over the timeout handler of timer
+    song_player(const playback_clock& clock, song_scheduler& scheduler, playback_timer& timer);
+
+    song_player(const song_player&) = delete;
+    song_player& operator=(const song_player&) = delete;
+
+    void set_event_handler(event_handler handler) { on_event = std::move(handler); }
+
+    // called once the timer expires after the last event, e.g. to go on with
+    // the next song of a playlist.
+    void set_end_handler(std::function<void()> handler) { on_end = std::move(handler); }
+
+    // an event isn't played until is_ready returns true for it, e.g. until
+    // the player played its chord. play_due_event must then be called.
+    void set_ready_check(std::function<bool(unsigned int event_pos)> check) { is_ready = std::move(check); }
+
+    // the pending event is played right away, unless the song is already playing
+    void resume();
+    void pause();
+
+    // plays the next event if it is due, then waits until the following one
+    void play_due_event();
+
+  private:
+    void wait_for_next_event();
+
+    const playback_clock& clock;
+    song_scheduler& scheduler;
+    playback_timer& timer;
+    event_handler on_event;
+    std::function<void()> on_end;
+    std::function<bool(unsigned int event_pos)> is_ready;
+};
+
+// plays the events in [start, stop) with a song_player, on a virtual clock
+// starting at 0 and a manual timer, as fast as possible, and returns the messages sent with the time they would
+// have been sent at. The times of the events must be waiting times. The
+// notes still sounding at the end are released.
+std::vector<timed_midi_message> simulate_playback(const std::vector<music_sheet_event>& events,
+						  unsigned int start, unsigned int stop,
+						  midi_transform& transform);
+
+#endif /* SONG_PLAYER_HH */
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "song_scheduler.hh"
+
+constexpr const unsigned int song_scheduler::NO_EVENT;
+
+song_scheduler::song_scheduler(const playback_clock& playback_time)
+  : clock(playback_time)
+  , waiting_times()
+  , start_pos(NO_EVENT)
+  , stop_pos(NO_EVENT)
+  , pos(NO_EVENT)
+  , paused(true)
+  , next_due(0)
+{
+}
+
+void song_scheduler::set_song(const std::vector<music_sheet_event>& events)
+{
+  waiting_times.clear();
+  waiting_times.reserve(events.size());
+  for (const auto& event : events)
+  {
+    waiting_times.push_back(event.time);
+  }
+
+  paused = true;
+  set_range(0, static_cast<unsigned int>(waiting_times.size()));
+}
+
+void song_scheduler::clear()
+{
+  waiting_times.clear();
+  start_pos = NO_EVENT;
+  stop_pos = NO_EVENT;
+  pos = NO_EVENT;
+  paused = true;
+}
+
+void song_scheduler::set_range(const unsigned int start, const unsigned int stop)
+{
+  if ((start > stop) or (stop > waiting_times.size()))
+  {
+    throw std::out_of_range("Error: the events to play are not in the song");
+  }
+
+  start_pos = start;
+  stop_pos = stop;
+  pos = start;
+  next_due = clock.now();
+}
+
+void song_scheduler::pause()
+{
+  paused = true;
+}
+
+void song_scheduler::resume()
+{
+  if (paused)
+  {
+    paused = false;
+    restart_from_now();
+  }
+}
+
+void song_scheduler::restart_from_now()
+{
+  next_due = clock.now();
+}
+
+std::chrono::nanoseconds song_scheduler::get_time_to_next_due() const
+{
+  if (paused or not has_song())
+  {
+    return std::chrono::nanoseconds{0};
+  }
+
+  return std::max(next_due - clock.now(), std::chrono::nanoseconds{0});
+}
+
+unsigned int song_scheduler::take_due_event()
+{
+  if (paused or is_over() or (not has_song()) or (clock.now() < next_due))
+  {
+    return NO_EVENT;
+  }
+
+  const auto res = pos;
+  next_due += std::chrono::milliseconds{static_cast<int64_t>(waiting_times[pos])};
+  ++pos;
+  return res;
+}
+
+
+midi_recording_sink::midi_recording_sink(const playback_clock& playback_time)
+  : clock(playback_time)
+  , messages()
+{
+}
+
+void midi_recording_sink::send(const uint8_t* const bytes, const std::size_t size)
+{
+  messages.emplace_back(timed_midi_message{ clock.now(), midi_message_t(bytes, bytes + size) });
+}
+
@@ -0,0 +1,96 @@
+#ifndef SONG_SCHEDULER_HH
+#define SONG_SCHEDULER_HH
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "bin_file_reader.hh"
+#include "midi_transform.hh"
+#include "playback_clock.hh"
+
+// When to play each event of a song, with pause, resume and sub-sequences.
+// It only reads the time from its clock, and doesn't wait by itself: the
+// player asks when the next event is due, waits however it wants, and then
+// takes the events which are due.
+class song_scheduler
+{
+  public:
+    static constexpr const unsigned int NO_EVENT = std::numeric_limits<unsigned int>::max();
+
+    explicit song_scheduler(const playback_clock& clock);
+
+    song_scheduler(const song_scheduler&) = delete;
+    song_scheduler& operator=(const song_scheduler&) = delete;
+
+    // the times of the events must be waiting times (see to_waiting_times).
+    // The whole song is then to be played, once resumed.
+    void set_song(const std::vector<music_sheet_event>& events);
+    void clear(); // no song anymore
+
+    // plays the events in [start, stop) once resumed. Throws an exception if
+    // the range doesn't fit in the song.
+    void set_range(unsigned int start, unsigned int stop);
+
+    void pause();
+    void resume(); // the pending event is due right away if it was paused
+    void restart_from_now(); // the pending event is due right away, e.g. after waiting for the player
+
+    bool is_paused() const { return paused; }
+    bool has_song() const { return pos != NO_EVENT; }
+    bool is_over() const { return has_song() and (pos >= stop_pos); }
+    bool is_whole_song() const { return (start_pos == 0) and (stop_pos == waiting_times.size()); }
+
+    unsigned int get_pos() const { return pos; } // next event to play, NO_EVENT without song
+    unsigned int get_start_pos() const { return start_pos; }
+    unsigned int get_stop_pos() const { return stop_pos; }
+
+    // when the next event is due. Once the song is over, when the waiting
+    // time of its last event is.
+    std::chrono::nanoseconds get_next_due() const { return next_due; }
+
+    // zero if the next event is due, or if there is nothing to wait for.
+    std::chrono::nanoseconds get_time_to_next_due() const;
+
+    // the position of the next event if it is due, and moves on to the
+    // following one. NO_EVENT if paused, over or too early. The following
+    // event is due after the waiting time counted from when this one was
+    // due, so that playing an event late doesn't delay the rest of the song.
+    unsigned int take_due_event();
+
+  private:
+    const playback_clock& clock;
+    std::vector<uint64_t> waiting_times; // in ms, one per event
+    unsigned int start_pos;
+    unsigned int stop_pos;
+    unsigned int pos;
+    bool paused;
+    std::chrono::nanoseconds next_due;
+};
+
+struct timed_midi_message
+{
+    std::chrono::nanoseconds time;
+    midi_message_t message;
+};
+
+// midi output keeping the messages with the time they were sent at
+class midi_recording_sink
+{
+  public:
+    explicit midi_recording_sink(const playback_clock& clock);
+
+    midi_recording_sink(const midi_recording_sink&) = delete;
+    midi_recording_sink& operator=(const midi_recording_sink&) = delete;
+
+    void send(const uint8_t* bytes, std::size_t size);
+
+    const std::vector<timed_midi_message>& get_messages() const { return messages; }
+
+  private:
+    const playback_clock& clock;
+    std::vector<timed_midi_message> messages;
+};
+
+#endif /* SONG_SCHEDULER_HH */
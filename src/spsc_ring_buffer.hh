@@ -0,0 +1,87 @@
+#ifndef SPSC_RING_BUFFER_HH
+#define SPSC_RING_BUFFER_HH
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Wait-free queue between exactly one producer thread and one consumer
+// thread. All the memory is allocated at construction, pushing and
+// consuming never allocate nor block.
+template <typename T>
+class spsc_ring_buffer
+{
+  public:
+    // the capacity is rounded up to the next power of two
+    explicit spsc_ring_buffer(const std::size_t min_capacity)
+      : buffer(round_up_to_power_of_two(min_capacity))
+      , mask(buffer.size() - 1)
+      , write_pos(0)
+      , read_pos(0)
+    {
+    }
+
+    spsc_ring_buffer(const spsc_ring_buffer&) = delete;
+    spsc_ring_buffer& operator=(const spsc_ring_buffer&) = delete;
+
+    // producer side. Returns false, and drops elt, if the buffer is full.
+    bool push(const T& elt)
+    {
+      const auto pos = write_pos.load(std::memory_order_relaxed);
+      if (pos - read_pos.load(std::memory_order_acquire) > mask)
+      {
+	return false;
+      }
+
+      buffer[pos & mask] = elt;
+      write_pos.store(pos + 1, std::memory_order_release);
+      return true;
+    }
+
+    // consumer side. Calls func on every element available, oldest first.
+    // Returns the number of elements consumed.
+    template <typename Func>
+    std::size_t consume_all(Func&& func)
+    {
+      const auto begin = read_pos.load(std::memory_order_relaxed);
+      const auto end = write_pos.load(std::memory_order_acquire);
+      for (auto pos = begin; pos != end; ++pos)
+      {
+	func(static_cast<const T&>(buffer[pos & mask]));
+      }
+
+      read_pos.store(end, std::memory_order_release);
+      return end - begin;
+    }
+
+    // consumer side.
+    bool empty() const
+    {
+      return read_pos.load(std::memory_order_relaxed) == write_pos.load(std::memory_order_acquire);
+    }
+
+    std::size_t capacity() const
+    {
+      return buffer.size();
+    }
+
+  private:
+    static std::size_t round_up_to_power_of_two(const std::size_t value)
+    {
+      std::size_t res = 1;
+      while (res < value)
+      {
+	res <<= 1;
+      }
+      return res;
+    }
+
+    std::vector<T> buffer;
+    const std::size_t mask;
+
+    // on separate cache lines so producer and consumer don't slow each other down
+    alignas(64) std::atomic<std::size_t> write_pos;
+    alignas(64) std::atomic<std::size_t> read_pos;
+};
+
+#endif /* SPSC_RING_BUFFER_HH */
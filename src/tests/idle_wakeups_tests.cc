@@ -0,0 +1,221 @@
+#include <dirent.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <thread>
+
+#include "test_utils.hh"
+#include "tests.hh"
+#include "../headless_player.hh"
+#include "../signals_handler.hh"
+#include "../song_player.hh"
+
+using namespace std::chrono_literals;
+
+// long enough for a periodic wake up to show, short enough for make check
+static constexpr const std::chrono::milliseconds IDLE_DURATION { 1000 };
+
+// number of times the thread was scheduled out, i.e. went to sleep and was
+// woken up again (or preempted).
+static uint64_t get_nb_context_switches(const long tid)
+{
+  std::ifstream status ("/proc/self/task/" + std::to_string(tid) + "/status");
+  uint64_t res = 0;
+  std::string line;
+  while (std::getline(status, line))
+  {
+    for (const char* const field : { "voluntary_ctxt_switches:", "nonvoluntary_ctxt_switches:" })
+    {
+      if (line.compare(0, std::strlen(field), field) == 0)
+      {
+	res += std::stoull(line.substr(std::strlen(field)));
+      }
+    }
+  }
+
+  return res;
+}
+
+// the context switches of each thread of the process, but the calling one
+static std::map<long, uint64_t> get_threads_context_switches()
+{
+  const auto self_tid = syscall(SYS_gettid);
+  std::map<long, uint64_t> res;
+  const auto dir = opendir("/proc/self/task");
+  if (dir == nullptr)
+  {
+    return res;
+  }
+
+  for (auto entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+  {
+    const std::string name = entry->d_name;
+    if ((name == ".") or (name == ".."))
+    {
+      continue;
+    }
+
+    const auto tid = std::stol(name);
+    if (tid != self_tid)
+    {
+      res[tid] = get_nb_context_switches(tid);
+    }
+  }
+
+  closedir(dir);
+  return res;
+}
+
+// the threads started in between count since their start, the ones which
+// exited in between aren't counted.
+static uint64_t get_nb_wakeups_since(const std::map<long, uint64_t>& before)
+{
+  uint64_t res = 0;
+  for (const auto& thread : get_threads_context_switches())
+  {
+    const auto previous = before.find(thread.first);
+    res += thread.second - ((previous == before.end()) ? 0 : previous->second);
+  }
+
+  return res;
+}
+
+// events far apart, so that the song is still playing once paused
+static bin_song_t make_long_song()
+{
+  bin_song_t song;
+  song.events.resize(3);
+  for (std::size_t i = 0; i < song.events.size(); ++i)
+  {
+    song.events[i].time = i * 60'000'000'000; // in ns
+    song.events[i].keys_down.emplace_back(static_cast<uint8_t>(60 + i), 0);
+  }
+  song.nb_events = song.events.size();
+  return song;
+}
+
+// a paused player, like a kiosk left alone, only wakes up on a signal
+static void test_paused_headless_player()
+{
+  // before starting the player's thread, which reads them from a signalfd
+  set_signal_handler();
+
+  std::atomic<long> player_tid {0};
+  std::thread player ([&] () {
+      player_tid = syscall(SYS_gettid);
+      play_headless(make_long_song(), midi_transform(), [] (const uint8_t*, std::size_t) noexcept {
+	});
+    });
+
+  while (player_tid == 0)
+  {
+    std::this_thread::yield();
+  }
+
+  kill(getpid(), SIGTSTP);
+  std::this_thread::sleep_for(100ms);
+
+  const auto nb_switches_before = get_nb_context_switches(player_tid);
+  const auto threads_switches_before = get_threads_context_switches();
+  std::this_thread::sleep_for(IDLE_DURATION);
+  CHECK_EQUAL(get_nb_context_switches(player_tid) - nb_switches_before, 0u);
+
+  // the other threads of the process too, e.g. the log writer
+  CHECK_EQUAL(get_nb_wakeups_since(threads_switches_before), 0u);
+
+  kill(getpid(), SIGINT);
+  player.join();
+}
+
+// the playback loop of the window: once there is nothing to play, the timer
+// isn't armed again until the song is resumed.
+static void test_idle_song_player()
+{
+  virtual_clock clock;
+  manual_playback_timer timer (clock);
+  song_scheduler scheduler (clock);
+  song_player player (clock, scheduler, timer);
+
+  const auto expire = [&] () {
+    clock.advance_to(timer.get_deadline());
+    timer.expire();
+  };
+
+  // without song, it is only woken up once by resume
+  player.resume();
+  CHECK(timer.is_active());
+  expire();
+  CHECK(not timer.is_active());
+
+  // nor by a stray wake up
+  player.play_due_event();
+  CHECK(not timer.is_active());
+
+  std::vector<music_sheet_event> events (3);
+  for (auto& event : events)
+  {
+    event.time = 100;
+  }
+  scheduler.set_song(events);
+
+  // not resumed yet
+  player.play_due_event();
+  CHECK(not timer.is_active());
+
+  // paused while playing
+  player.resume();
+  expire();
+  CHECK(timer.is_active());
+  player.pause();
+  CHECK(not timer.is_active());
+  player.play_due_event();
+  CHECK(not timer.is_active());
+
+  // stopped at the end of the song, as the window does
+  unsigned int nb_ends = 0;
+  player.set_end_handler([&] () {
+      ++nb_ends;
+      player.pause();
+    });
+  player.resume();
+  for (unsigned int i = 0; (i < 10) and timer.is_active(); ++i)
+  {
+    expire();
+  }
+  CHECK_EQUAL(nb_ends, 1u);
+  CHECK(not timer.is_active());
+  player.play_due_event();
+  CHECK(not timer.is_active());
+
+  // over without being stopped, as in simulate_playback
+  player.set_end_handler([&] () noexcept {
+      ++nb_ends;
+    });
+  scheduler.set_range(0, 3);
+  player.resume();
+  for (unsigned int i = 0; (i < 10) and timer.is_active(); ++i)
+  {
+    expire();
+  }
+  CHECK_EQUAL(nb_ends, 2u);
+  CHECK(not timer.is_active());
+
+  // the song is closed
+  player.pause();
+  scheduler.clear();
+  player.resume();
+  expire();
+  CHECK(not timer.is_active());
+}
+
+void run_idle_wakeups_tests()
+{
+  test_paused_headless_player();
+  test_idle_song_player();
+}
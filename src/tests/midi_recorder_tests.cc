@@ -0,0 +1,128 @@
+#include <thread>
+
+#include "test_utils.hh"
+#include "tests.hh"
+#include "../midi_recorder.hh"
+
+static void add(midi_recorder& recorder, const int64_t time, std::initializer_list<uint8_t> bytes)
+{
+  recorder.add(time, bytes.begin(), bytes.size());
+}
+
+static void test_keys_are_grouped_by_time()
+{
+  midi_recorder recorder;
+  CHECK(not recorder.is_active());
+
+  // not recording yet
+  add(recorder, 500, { 0x90, 60, 100 });
+
+  recorder.start();
+  add(recorder, 1000, { 0x90, 60, 100 });
+  add(recorder, 1000, { 64, 90 }); // running status
+  add(recorder, 1000, { 0xB0, 64, 127 }); // sustain, not a key
+  add(recorder, 3000, { 0x90, 60, 0 }); // a note on with a velocity of 0 is a release
+  add(recorder, 4000, { 0x80, 64, 0 });
+  recorder.stop();
+  add(recorder, 5000, { 0x90, 67, 100 });
+
+  CHECK_EQUAL(recorder.size(), 4u);
+  CHECK_EQUAL(recorder.get_nb_dropped(), 0u);
+
+  const auto song = recorder.get_song();
+  CHECK_EQUAL(song.nb_events, 3u);
+  if (song.nb_events != 3)
+  {
+    return;
+  }
+
+  CHECK_EQUAL(song.events[0].time, 0u);
+  CHECK_EQUAL(song.events[0].keys_down.size(), 2u);
+  CHECK_EQUAL(song.events[0].keys_down[0].pitch, 60);
+  CHECK_EQUAL(song.events[0].keys_down[0].velocity, 100);
+  CHECK_EQUAL(song.events[0].keys_down[1].pitch, 64);
+  CHECK_EQUAL(song.events[0].keys_down[1].velocity, 90);
+  CHECK(song.events[0].has_bar_number_change());
+  CHECK_EQUAL(song.events[1].time, 2000u);
+  CHECK_EQUAL(song.events[1].keys_up.size(), 1u);
+  CHECK_EQUAL(song.events[1].keys_up[0].pitch, 60);
+  CHECK_EQUAL(song.events[2].time, 3000u);
+  CHECK_EQUAL(song.events[2].keys_up[0].pitch, 64);
+}
+
+static void test_keys_past_the_capacity_are_counted()
+{
+  midi_recorder recorder (4);
+  recorder.start();
+  for (uint8_t i = 0; i < 10; ++i)
+  {
+    add(recorder, 1000 * i, { 0x90, static_cast<uint8_t>(60 + i), 100 });
+  }
+  recorder.stop();
+
+  CHECK_EQUAL(recorder.size(), 4u);
+  CHECK_EQUAL(recorder.capacity(), 4u);
+  CHECK_EQUAL(recorder.get_nb_dropped(), 6u);
+
+  // the first keys are kept
+  const auto song = recorder.get_song();
+  CHECK_EQUAL(song.nb_events, 4u);
+  CHECK_EQUAL(song.events.back().keys_down[0].pitch, 63);
+}
+
+static void test_start_drops_the_previous_recording()
+{
+  midi_recorder recorder (16);
+  recorder.start();
+  add(recorder, 1000, { 0x90, 60, 100 });
+  add(recorder, 1000, { 0x90 }); // a status byte alone, its data would follow
+
+  recorder.start();
+  CHECK(recorder.is_active());
+  CHECK(recorder.empty());
+
+  // the running status of the previous recording is forgotten
+  add(recorder, 2000, { 62, 100 });
+  CHECK(recorder.empty());
+  add(recorder, 2000, { 0x90, 62, 100 });
+  CHECK_EQUAL(recorder.size(), 1u);
+}
+
+// the keys are added by the RtMidi thread while the gui thread reads them
+static void test_recording_from_another_thread()
+{
+  constexpr const unsigned int nb_keys = 100'000;
+  midi_recorder recorder (nb_keys);
+  recorder.start();
+
+  std::thread midi_thread ([&] () {
+      for (unsigned int i = 0; i < nb_keys; ++i)
+      {
+	add(recorder, i, { static_cast<uint8_t>((i % 2 == 0) ? 0x90 : 0x80), static_cast<uint8_t>(i % 128), 100 });
+      }
+    });
+
+  auto last_size = std::size_t{0};
+  auto is_growing = true;
+  while (last_size != nb_keys)
+  {
+    const auto size = recorder.size();
+    is_growing = is_growing and (size >= last_size);
+    last_size = size;
+  }
+  midi_thread.join();
+  CHECK(is_growing);
+  recorder.stop();
+
+  const auto song = recorder.get_song();
+  CHECK_EQUAL(song.nb_events, std::size_t{nb_keys});
+  CHECK_EQUAL(song.events.back().time, uint64_t{nb_keys - 1});
+}
+
+void run_midi_recorder_tests()
+{
+  test_keys_are_grouped_by_time();
+  test_keys_past_the_capacity_are_counted();
+  test_start_drops_the_previous_recording();
+  test_recording_from_another_thread();
+}
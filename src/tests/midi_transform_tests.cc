@@ -0,0 +1,198 @@
+#include <chrono>
+#include <vector>
+
+#include "test_utils.hh"
+#include "tests.hh"
+#include "../midi_transform.hh"
+#include "../song_player.hh"
+
+using namespace std::chrono_literals;
+
+static void check_messages(const std::vector<short_midi_message>& messages,
+			   const std::vector<midi_message_t>& expected)
+{
+  CHECK_EQUAL(messages.size(), expected.size());
+  for (std::size_t i = 0; (i < messages.size()) and (i < expected.size()); ++i)
+  {
+    CHECK_EQUAL(expected[i].size(), 3u);
+    for (std::size_t j = 0; (j < 3) and (j < expected[i].size()); ++j)
+    {
+      CHECK_EQUAL(messages[i].bytes[j], expected[i][j]);
+    }
+  }
+}
+
+static void test_default_settings()
+{
+  midi_transform transform;
+  check_messages(transform.apply({ key_down(60, 0), key_down(64, 1) }, {}),
+		 { { 0x90, 60, 100 }, { 0x90, 64, 100 } });
+  check_messages(transform.apply({}, { key_up(60) }), { { 0x80, 60, 0 } });
+  check_messages(transform.release_all(), { { 0x80, 64, 0 } });
+  check_messages(transform.release_all(), {});
+}
+
+static void test_transposition()
+{
+  midi_transform transform;
+  transform.set_transposition(-2);
+  check_messages(transform.apply({ key_down(60, 0), key_down(1, 0) }, {}), { { 0x90, 58, 100 } });
+  check_messages(transform.apply({}, { key_up(60), key_up(1) }), { { 0x80, 58, 0 } });
+}
+
+static void test_mute_and_solo()
+{
+  midi_transform transform;
+  transform.set_muted(1, true);
+  check_messages(transform.apply({ key_down(60, 0), key_down(62, 1), key_down(64, 2) }, {}),
+		 { { 0x90, 60, 100 }, { 0x90, 64, 100 } });
+
+  // the keys not pressed aren't released
+  check_messages(transform.apply({}, { key_up(60), key_up(62), key_up(64) }),
+		 { { 0x80, 60, 0 }, { 0x80, 64, 0 } });
+
+  transform.set_solo(2, true);
+  check_messages(transform.apply({ key_down(60, 0), key_down(62, 1), key_down(64, 2) }, {}),
+		 { { 0x90, 64, 100 } });
+}
+
+static void test_channels()
+{
+  midi_transform transform;
+  transform.set_channel(9);
+  transform.set_channel(1, 3);
+  check_messages(transform.apply({ key_down(60, 0), key_down(62, 1) }, {}),
+		 { { 0x99, 60, 100 }, { 0x93, 62, 100 } });
+  check_messages(transform.release_all(), { { 0x89, 60, 0 }, { 0x83, 62, 0 } });
+}
+
+static void test_octave_doubling()
+{
+  midi_transform transform;
+  transform.set_octave_doubling(1);
+  check_messages(transform.apply({ key_down(60, 0), key_down(120, 0) }, {}),
+		 { { 0x90, 60, 100 }, { 0x90, 72, 100 }, { 0x90, 120, 100 } });
+  check_messages(transform.apply({}, { key_up(60), key_up(120) }),
+		 { { 0x80, 60, 0 }, { 0x80, 72, 0 }, { 0x80, 120, 0 } });
+}
+
+// the keys of lilyplayer files all have the default velocity
+static void test_velocity()
+{
+  midi_transform transform;
+  check_messages(transform.apply({ key_down(60, 0), key_down(62, 0, 40) }, {}),
+		 { { 0x90, 60, 100 }, { 0x90, 62, 40 } });
+
+  transform.set_velocity(0.5, velocity_curve::linear);
+  check_messages(transform.apply({ key_down(64, 0), key_down(65, 0, 40), key_down(67, 0, 1) }, {}),
+		 { { 0x90, 64, 50 }, { 0x90, 65, 20 }, { 0x90, 67, 1 } });
+
+  // the curves reshape the velocity of each key
+  transform.set_velocity(1.0, velocity_curve::soft);
+  check_messages(transform.apply({ key_down(69, 0, 40), key_down(71, 0, 127) }, {}),
+		 { { 0x90, 69, 71 }, { 0x90, 71, 127 } });
+  transform.set_velocity(1.0, velocity_curve::hard);
+  check_messages(transform.apply({ key_down(72, 0, 40), key_down(74, 0, 127) }, {}),
+		 { { 0x90, 72, 13 }, { 0x90, 74, 127 } });
+}
+
+// a key is released with the notes it started, whatever the settings now
+static void test_settings_changed_while_sounding()
+{
+  midi_transform transform;
+  transform.set_transposition(2);
+  transform.set_octave_doubling(-1);
+  check_messages(transform.apply({ key_down(60, 0), key_down(64, 1) }, {}),
+		 { { 0x90, 62, 100 }, { 0x90, 50, 100 }, { 0x90, 66, 100 }, { 0x90, 54, 100 } });
+
+  transform.set_transposition(0);
+  transform.set_octave_doubling(0);
+  transform.set_channel(5);
+  transform.set_muted(1, true);
+  check_messages(transform.apply({}, { key_up(60) }), { { 0x80, 62, 0 }, { 0x80, 50, 0 } });
+
+  // pressed again without being released: the previous notes stop first
+  check_messages(transform.apply({ key_down(64, 0) }, {}),
+		 { { 0x80, 66, 0 }, { 0x80, 54, 0 }, { 0x95, 64, 100 } });
+  check_messages(transform.release_all(), { { 0x85, 64, 0 } });
+}
+
+static void test_copy()
+{
+  midi_transform transform;
+  transform.set_transposition(12);
+  transform.apply({ key_down(60, 0) }, {});
+
+  // the copy has its own preallocated messages, as the copied transform:
+  // at least 255 keys released, pressed again and doubled per event.
+  midi_transform copied (transform);
+  check_messages(copied.release_all(), { { 0x80, 72, 0 } });
+  CHECK(copied.release_all().capacity() >= 255 * 4);
+
+  midi_transform assigned;
+  assigned = transform;
+  check_messages(assigned.apply({ key_down(62, 0) }, {}), { { 0x90, 74, 100 } });
+  check_messages(assigned.release_all(), { { 0x80, 72, 0 }, { 0x80, 74, 0 } });
+
+  // the copies are independent of each other
+  check_messages(transform.release_all(), { { 0x80, 72, 0 } });
+}
+
+// the bytes sent along a song played through a transform, with their times
+static void test_simulate_playback()
+{
+  std::vector<music_sheet_event> events (3);
+  events[0].time = 100;
+  events[0].keys_down = { key_down(60, 0), key_down(48, 1) };
+  events[1].time = 200;
+  events[1].keys_up = { key_up(60), key_up(48) };
+  events[1].keys_down = { key_down(62, 0), key_down(50, 1) };
+  events[2].time = 50;
+  events[2].keys_up = { key_up(62) };
+
+  midi_transform transform;
+  transform.set_transposition(1);
+  transform.set_channel(0, 2);
+  transform.set_muted(1, true);
+  transform.set_octave_doubling(1);
+
+  const auto messages = simulate_playback(events, 0, 3, transform);
+  const std::vector<timed_midi_message> expected {
+    { 0ms, { 0x92, 61, 100 } },
+    { 0ms, { 0x92, 73, 100 } },
+    { 100ms, { 0x82, 61, 0 } },
+    { 100ms, { 0x82, 73, 0 } },
+    { 100ms, { 0x92, 63, 100 } },
+    { 100ms, { 0x92, 75, 100 } },
+    { 300ms, { 0x82, 63, 0 } },
+    { 300ms, { 0x82, 75, 0 } },
+  };
+  CHECK_EQUAL(messages.size(), expected.size());
+  for (std::size_t i = 0; (i < messages.size()) and (i < expected.size()); ++i)
+  {
+    CHECK_EQUAL(messages[i].time.count(), expected[i].time.count());
+    CHECK(messages[i].message == expected[i].message);
+  }
+
+  // the notes still sounding are released once the song is over
+  const auto stopped_early = simulate_playback(events, 0, 1, transform);
+  CHECK_EQUAL(stopped_early.size(), 4u);
+  if (stopped_early.size() == 4)
+  {
+    CHECK_EQUAL(stopped_early[3].time.count(), std::chrono::nanoseconds{100ms}.count());
+    CHECK(stopped_early[3].message == (midi_message_t{ 0x82, 73, 0 }));
+  }
+}
+
+void run_midi_transform_tests()
+{
+  test_default_settings();
+  test_transposition();
+  test_mute_and_solo();
+  test_channels();
+  test_octave_doubling();
+  test_velocity();
+  test_settings_changed_while_sounding();
+  test_copy();
+  test_simulate_playback();
+}
@@ -0,0 +1,200 @@
+#include <chrono>
+#include <vector>
+
+#include "test_utils.hh"
+#include "tests.hh"
+#include "../song_player.hh"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+  struct played_event
+  {
+      unsigned int pos;
+      std::chrono::nanoseconds time;
+      std::chrono::nanoseconds lateness;
+  };
+
+  // a song player on a virtual clock, recording when each event is played
+  struct test_player
+  {
+      test_player()
+	: clock()
+	, timer(clock)
+	, scheduler(clock)
+	, player(clock, scheduler, timer)
+	, played()
+	, end_times()
+      {
+	player.set_event_handler([this] (const unsigned int event_pos, const std::chrono::nanoseconds lateness) {
+	    played.push_back(played_event{ event_pos, clock.now(), lateness });
+	  });
+	player.set_end_handler([this] () {
+	    end_times.push_back(clock.now());
+	  });
+      }
+
+      // lets the time go by until the timer expires, plus delay
+      void expire(const std::chrono::nanoseconds delay = 0ns)
+      {
+	clock.advance_to(timer.get_deadline() + delay);
+	timer.expire();
+      }
+
+      void play_until_idle()
+      {
+	while (timer.is_active())
+	{
+	  expire();
+	}
+      }
+
+      virtual_clock clock;
+      manual_playback_timer timer;
+      song_scheduler scheduler;
+      song_player player;
+      std::vector<played_event> played;
+      std::vector<std::chrono::nanoseconds> end_times;
+  };
+}
+
+// the waiting times are in ms, the time after each event until the next one
+static std::vector<music_sheet_event> make_song(const std::vector<uint64_t>& waiting_times)
+{
+  std::vector<music_sheet_event> events (waiting_times.size());
+  for (std::size_t i = 0; i < events.size(); ++i)
+  {
+    events[i].time = waiting_times[i];
+  }
+  return events;
+}
+
+static void check_played(const std::vector<played_event>& played,
+			 const std::vector<std::pair<unsigned int, std::chrono::milliseconds>>& expected)
+{
+  CHECK_EQUAL(played.size(), expected.size());
+  for (std::size_t i = 0; (i < played.size()) and (i < expected.size()); ++i)
+  {
+    CHECK_EQUAL(played[i].pos, expected[i].first);
+    CHECK_EQUAL(played[i].time.count(), std::chrono::nanoseconds{expected[i].second}.count());
+  }
+}
+
+static void test_whole_song()
+{
+  test_player test;
+  test.scheduler.set_song(make_song({ 100, 250, 50, 200 }));
+
+  // nothing is played until resumed
+  test.player.play_due_event();
+  CHECK(not test.timer.is_active());
+
+  test.player.resume();
+  test.play_until_idle();
+
+  check_played(test.played, { { 0, 0ms }, { 1, 100ms }, { 2, 350ms }, { 3, 400ms } });
+  for (const auto& event : test.played)
+  {
+    CHECK_EQUAL(event.lateness.count(), 0);
+  }
+
+  // the song ends once the waiting time of its last event is over
+  CHECK_EQUAL(test.end_times.size(), 1u);
+  CHECK(test.end_times == std::vector<std::chrono::nanoseconds>{ 600ms });
+}
+
+static void test_sub_sequence()
+{
+  test_player test;
+  test.scheduler.set_song(make_song({ 100, 250, 50, 200 }));
+
+  test.clock.advance_to(1s);
+  test.scheduler.set_range(1, 3);
+  test.player.resume();
+  test.play_until_idle();
+
+  check_played(test.played, { { 1, 1000ms }, { 2, 1250ms } });
+  CHECK(test.end_times == std::vector<std::chrono::nanoseconds>{ 1300ms });
+}
+
+static void test_pause_and_resume()
+{
+  test_player test;
+  test.scheduler.set_song(make_song({ 100, 250, 50, 200 }));
+
+  test.player.resume();
+  test.expire();
+  test.expire();
+  check_played(test.played, { { 0, 0ms }, { 1, 100ms } });
+
+  // a paused player doesn't wake up
+  test.clock.advance_to(200ms);
+  test.player.pause();
+  CHECK(not test.timer.is_active());
+  test.player.play_due_event();
+  CHECK_EQUAL(test.played.size(), 2u);
+
+  // the pending event is played as soon as resumed, the rest follows from there
+  test.clock.advance_to(1s);
+  test.player.resume();
+  CHECK_EQUAL(test.timer.get_deadline().count(), std::chrono::nanoseconds{1s}.count());
+
+  // resuming a song being played changes nothing
+  test.player.resume();
+  CHECK_EQUAL(test.timer.get_deadline().count(), std::chrono::nanoseconds{1s}.count());
+
+  test.play_until_idle();
+  check_played(test.played, { { 0, 0ms }, { 1, 100ms }, { 2, 1000ms }, { 3, 1050ms } });
+  CHECK(test.end_times == std::vector<std::chrono::nanoseconds>{ 1250ms });
+}
+
+// an event played late doesn't delay the rest of the song
+static void test_late_wake_up()
+{
+  test_player test;
+  test.scheduler.set_song(make_song({ 100, 250, 50, 200 }));
+
+  test.player.resume();
+  test.expire();
+  test.expire(30ms);
+  test.play_until_idle();
+
+  check_played(test.played, { { 0, 0ms }, { 1, 130ms }, { 2, 350ms }, { 3, 400ms } });
+  CHECK_EQUAL(test.played[1].lateness.count(), std::chrono::nanoseconds{30ms}.count());
+}
+
+// in practice mode, an event is held until the player is ready for it
+static void test_waiting_for_the_player()
+{
+  test_player test;
+  test.scheduler.set_song(make_song({ 100, 250, 50, 200 }));
+
+  auto is_player_ready = false;
+  test.player.set_ready_check([&is_player_ready] (const unsigned int event_pos) noexcept {
+      return (event_pos != 1) or is_player_ready;
+    });
+
+  test.player.resume();
+  test.play_until_idle();
+  check_played(test.played, { { 0, 0ms } });
+
+  // the player plays the chord of the event long after it was due
+  test.clock.advance_to(2s);
+  is_player_ready = true;
+  test.scheduler.restart_from_now();
+  test.player.play_due_event();
+  test.play_until_idle();
+
+  check_played(test.played, { { 0, 0ms }, { 1, 2000ms }, { 2, 2250ms }, { 3, 2300ms } });
+  CHECK(test.end_times == std::vector<std::chrono::nanoseconds>{ 2500ms });
+}
+
+void run_song_player_tests()
+{
+  test_whole_song();
+  test_sub_sequence();
+  test_pause_and_resume();
+  test_late_wake_up();
+  test_waiting_for_the_player();
+}
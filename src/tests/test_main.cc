@@ -0,0 +1,18 @@
+#include <iostream>
+
+#include "test_utils.hh"
+#include "tests.hh"
+
+// usage: lilyplayer-tests. Returns 1 if any check failed.
+int main()
+{
+  // first, as the signals must be blocked before any other thread starts
+  run_idle_wakeups_tests();
+  run_midi_recorder_tests();
+  run_midi_transform_tests();
+  run_song_player_tests();
+  run_utils_tests();
+
+  std::cout << nb_checks << " checks, " << nb_failed_checks << " failed\n";
+  return (nb_failed_checks == 0) ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+#ifndef TEST_UTILS_HH
+#define TEST_UTILS_HH
+
+#include <iostream>
+
+// Tests are plain functions checking the behaviour of a module. A failed
+// check prints where it failed, with the values compared, and the test goes
+// on so that all the failures are seen at once. The run fails if any did.
+#define CHECK(condition) check_true((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQUAL(actual, expected) check_equal((actual), (expected), #actual, __FILE__, __LINE__)
+
+inline unsigned int nb_failed_checks = 0;
+inline unsigned int nb_checks = 0;
+
+inline void check_true(const bool condition, const char* const text, const char* const file, const int line)
+{
+  ++nb_checks;
+  if (not condition)
+  {
+    ++nb_failed_checks;
+    std::cerr << file << ":" << line << ": check failed: " << text << "\n";
+  }
+}
+
+template <typename T, typename U>
+void check_equal(const T& actual, const U& expected, const char* const text, const char* const file, const int line)
+{
+  ++nb_checks;
+  if (not (actual == expected))
+  {
+    ++nb_failed_checks;
+    std::cerr << file << ":" << line << ": check failed: " << text << " is " << +actual
+	      << ", expected " << +expected << "\n";
+  }
+}
+
+#endif /* TEST_UTILS_HH */
@@ -0,0 +1,11 @@
+#ifndef TESTS_HH
+#define TESTS_HH
+
+// one function per tested module, each one checking its behaviour with CHECK.
+void run_idle_wakeups_tests();
+void run_midi_recorder_tests();
+void run_midi_transform_tests();
+void run_song_player_tests();
+void run_utils_tests();
+
+#endif /* TESTS_HH */
@@ -0,0 +1,82 @@
+#include <cstdlib> // for mkdtemp and system
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "test_utils.hh"
+#include "tests.hh"
+#include "../utils.hh"
+
+static std::string make_temp_dir()
+{
+  char path[] = "/tmp/lilyplayer-tests-XXXXXX";
+  return (mkdtemp(path) == nullptr) ? std::string{} : std::string{path};
+}
+
+static void create_file(const std::string& path)
+{
+  std::ofstream file (path);
+}
+
+static void remove_dir(const std::string& dir)
+{
+  CHECK_EQUAL(std::system(("rm -rf " + dir).c_str()), 0);
+}
+
+static void test_find_files()
+{
+  const auto dir = make_temp_dir();
+  CHECK(not dir.empty());
+  if (dir.empty())
+  {
+    return;
+  }
+
+  mkdir((dir + "/sub").c_str(), 0755);
+  create_file(dir + "/b.bin");
+  create_file(dir + "/a.mid");
+  create_file(dir + "/sub/c.bin");
+
+  const auto files = find_files(dir, ".bin");
+  CHECK(files == (std::vector<std::string>{ dir + "/b.bin", dir + "/sub/c.bin" }));
+
+  // in a single walk
+  const auto song_files = find_files(dir, { ".bin", ".mid" });
+  CHECK(song_files == (std::vector<std::string>{ dir + "/a.mid", dir + "/b.bin", dir + "/sub/c.bin" }));
+
+  // a file is returned as is
+  CHECK(find_files(dir + "/a.mid", ".bin") == std::vector<std::string>{ dir + "/a.mid" });
+
+  remove_dir(dir);
+}
+
+// links to a parent directory would make the walk endless
+static void test_find_files_through_symbolic_links()
+{
+  const auto dir = make_temp_dir();
+  CHECK(not dir.empty());
+  if (dir.empty())
+  {
+    return;
+  }
+
+  mkdir((dir + "/sub").c_str(), 0755);
+  create_file(dir + "/a.bin");
+  create_file(dir + "/sub/b.bin");
+  CHECK_EQUAL(symlink(".", (dir + "/loop").c_str()), 0);
+  CHECK_EQUAL(symlink("..", (dir + "/sub/parent").c_str()), 0);
+  CHECK_EQUAL(symlink("a.bin", (dir + "/link.bin").c_str()), 0);
+
+  // the links to files are kept, as for the files themselves
+  const auto files = find_files(dir, ".bin");
+  CHECK(files == (std::vector<std::string>{ dir + "/a.bin", dir + "/link.bin", dir + "/sub/b.bin" }));
+
+  remove_dir(dir);
+}
+
+void run_utils_tests()
+{
+  test_find_files();
+  test_find_files_through_symbolic_links();
+}
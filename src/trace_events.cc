@@ -0,0 +1,246 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "trace_events.hh"
+#include "log.hh"
+
+struct trace_event
+{
+    const char* name;
+    const char* arg_name; // nullptr if there is no argument
+    int64_t arg;
+    int64_t start; // steady clock time in ns
+    int64_t duration; // in ns, negative for instant events
+};
+
+struct thread_buffer
+{
+    explicit thread_buffer(const unsigned int thread_id)
+      : events()
+      , nb_dropped(0)
+      , thread_name(nullptr)
+      , tid(thread_id)
+    {
+    }
+
+    thread_buffer(const thread_buffer&) = delete;
+    thread_buffer& operator=(const thread_buffer&) = delete;
+
+    std::vector<trace_event> events; // never grows past its reserved capacity
+    uint64_t nb_dropped;
+    const char* thread_name;
+    const unsigned int tid;
+};
+
+struct trace_state
+{
+    trace_state()
+      : mutex()
+      , buffers()
+      , filename()
+      , origin(0)
+      , events_per_named_thread(DEFAULT_TRACE_EVENTS)
+    {
+    }
+
+    std::mutex mutex; // only taken when a thread records its first event, and at exit
+    std::vector<std::unique_ptr<thread_buffer>> buffers;
+    std::string filename;
+    int64_t origin; // steady clock time in ns at which tracing started
+    std::size_t events_per_named_thread;
+};
+
+// The short lived workers, e.g. of the library scan or of the exports, only
+// record a few spans each. At 40 bytes per event.
+static constexpr const std::size_t EVENTS_PER_WORKER_THREAD = 1 << 12;
+
+static std::atomic<bool> is_enabled { false };
+static thread_local thread_buffer* this_thread_buffer = nullptr;
+
+static trace_state& get_trace_state()
+{
+  static trace_state state;
+  return state;
+}
+
+static int64_t get_time_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static thread_buffer& get_thread_buffer()
+{
+  if (this_thread_buffer == nullptr)
+  {
+    auto& state = get_trace_state();
+    std::lock_guard<std::mutex> lock (state.mutex);
+    state.buffers.emplace_back(std::make_unique<thread_buffer>(static_cast<unsigned int>(state.buffers.size() + 1)));
+    this_thread_buffer = state.buffers.back().get();
+    this_thread_buffer->events.reserve(EVENTS_PER_WORKER_THREAD);
+  }
+
+  return *this_thread_buffer;
+}
+
+static void record(const trace_event& event)
+{
+  auto& buffer = get_thread_buffer();
+  if (buffer.events.size() == buffer.events.capacity())
+  {
+    ++buffer.nb_dropped;
+    return;
+  }
+
+  buffer.events.push_back(event);
+}
+
+static void write_event(std::ostream& out, const trace_event& event, const unsigned int tid, const int64_t origin)
+{
+  const auto to_us = [] (const int64_t ns) {
+    return static_cast<double>(ns) / 1000.0;
+  };
+
+  out << "{\"name\": \"" << event.name << "\", \"pid\": 1, \"tid\": " << tid
+      << ", \"ts\": " << to_us(event.start - origin);
+
+  if (event.duration >= 0)
+  {
+    out << ", \"ph\": \"X\", \"dur\": " << to_us(event.duration);
+  }
+  else
+  {
+    out << ", \"ph\": \"i\", \"s\": \"t\"";
+  }
+
+  if (event.arg_name != nullptr)
+  {
+    out << ", \"args\": {\"" << event.arg_name << "\": " << event.arg << "}";
+  }
+
+  out << "}";
+}
+
+// called at exit, once all the threads recording events are over
+static void write_trace()
+{
+  // one per thread at most
+  static log_site trace_warning_log (log_level::warning, 64);
+
+  is_enabled = false;
+
+  auto& state = get_trace_state();
+  std::lock_guard<std::mutex> lock (state.mutex);
+
+  std::ofstream out (state.filename);
+  out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+  auto is_first = true;
+  const auto separate = [&] () {
+    out << (is_first ? "" : ",\n");
+    is_first = false;
+  };
+
+  for (const auto& buffer : state.buffers)
+  {
+    if (buffer->thread_name != nullptr)
+    {
+      separate();
+      out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->tid
+	  << ", \"args\": {\"name\": \"" << buffer->thread_name << "\"}}";
+    }
+
+    for (const auto& event : buffer->events)
+    {
+      separate();
+      write_event(out, event, buffer->tid, state.origin);
+    }
+
+    if (buffer->nb_dropped != 0)
+    {
+      log_line(trace_warning_log) << "Warning: " << buffer->nb_dropped << " trace events of thread " << buffer->tid
+				  << " were dropped, its buffer was full";
+    }
+  }
+
+  out << "\n]}\n";
+  out.close();
+  if (not out)
+  {
+    static log_site trace_error_log (log_level::error);
+    log_line(trace_error_log) << "Error: failed to write the trace in " << state.filename;
+  }
+}
+
+void start_tracing(const std::string& filename, const std::size_t events_per_named_thread)
+{
+  if (is_enabled)
+  {
+    throw std::logic_error("Error: tracing has already been started");
+  }
+
+  // fail now rather than losing the whole session at exit
+  if (not std::ofstream(filename))
+  {
+    throw std::runtime_error("Error: unable to create the trace file " + filename);
+  }
+
+  auto& state = get_trace_state();
+  state.filename = filename;
+  state.origin = get_time_ns();
+  state.events_per_named_thread = events_per_named_thread;
+
+  // the state was constructed before, so it is destroyed after write_trace runs
+  if (std::atexit(write_trace) != 0)
+  {
+    throw std::runtime_error("Error: unable to write the trace at exit");
+  }
+
+  is_enabled = true;
+}
+
+bool is_tracing()
+{
+  return is_enabled.load(std::memory_order_relaxed);
+}
+
+void set_trace_thread_name(const char* const name)
+{
+  if (is_tracing())
+  {
+    // before the thread records anything, so that it doesn't allocate later
+    auto& buffer = get_thread_buffer();
+    buffer.thread_name = name;
+    buffer.events.reserve(get_trace_state().events_per_named_thread);
+  }
+}
+
+void trace_instant(const char* const name, const char* const arg_name, const int64_t arg)
+{
+  if (is_tracing())
+  {
+    record(trace_event{ name, arg_name, arg, get_time_ns(), -1 });
+  }
+}
+
+trace_span::trace_span(const char* const span_name)
+  : name(span_name)
+  , start(is_tracing() ? get_time_ns() : 0)
+  , arg_name(nullptr)
+  , arg(0)
+{
+}
+
+trace_span::~trace_span()
+{
+  if ((start != 0) and is_tracing())
+  {
+    record(trace_event{ name, arg_name, arg, start, get_time_ns() - start });
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef TRACE_EVENTS_HH
+#define TRACE_EVENTS_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Spans and instant events written as Chrome trace-event JSON, which can be
+// opened in chrome://tracing or ui.perfetto.dev. Nothing is recorded unless
+// start_tracing was called. Then each thread records its events in a buffer
+// allocated once, and the file is written at exit. The threads named with
+// set_trace_thread_name get the big buffers, the other ones a small buffer
+// for a few thousand events. Events past the end of a buffer are dropped.
+//
+// Names must be string literals: only their address is recorded.
+
+// 1 << 18 events are about 20 minutes of playing on the gui thread, which
+// records a few spans per frame at 60 frames per second, and 10 MiB.
+static constexpr const std::size_t DEFAULT_TRACE_EVENTS = 1 << 18;
+
+// throws an exception if the file can't be created
+void start_tracing(const std::string& filename, std::size_t events_per_named_thread = DEFAULT_TRACE_EVENTS);
+
+bool is_tracing();
+
+// name of the calling thread in the trace viewer, called when the thread
+// starts. The thread can then record events_per_named_thread events.
+void set_trace_thread_name(const char* name);
+
+void trace_instant(const char* name, const char* arg_name = nullptr, int64_t arg = 0);
+
+// records the time between its construction and its destruction
+class trace_span
+{
+  public:
+    explicit trace_span(const char* name);
+    ~trace_span();
+
+    trace_span(const trace_span&) = delete;
+    trace_span& operator=(const trace_span&) = delete;
+
+    // shown in the trace viewer when the span is selected
+    void set_arg(const char* argument_name, int64_t value)
+    {
+      arg_name = argument_name;
+      arg = value;
+    }
+
+  private:
+    const char* const name;
+    const int64_t start; // 0 if not tracing
+    const char* arg_name;
+    int64_t arg;
+};
+
+#endif /* TRACE_EVENTS_HH */
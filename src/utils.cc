@@ -1,10 +1,20 @@
 #include <algorithm>
+#include <memory>
+#include <set>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <cstddef> // for std::size_t
+#include <cstring> // for std::strlen
+#include <dirent.h>
+#include <sys/stat.h>
 #include <rtmidi/RtMidi.h>
 #include "utils.hh"
 #include "bin_file_reader.hh"
+#include "midi_stream_parser.hh"
+#include "log.hh"
+
+constexpr const uint8_t key_down::DEFAULT_VELOCITY;
 
 bool is_key_down_event(const std::vector<uint8_t>& data)
 {
@@ -21,222 +31,38 @@ bool is_key_release_event(const std::vector<uint8_t>& data)
 
 
 
-static
-std::size_t get_variable_data_length(const std::vector<uint8_t>& message_stream, std::size_t start_pos)
-{
-  const auto max_res = message_stream.size() - start_pos;
-  const auto end = message_stream.end();
-  const auto begin = message_stream.begin();
-  auto array_size = decltype(max_res){0};
-  auto nb_read = decltype(array_size){0};
-
-  for (auto it = std::next(begin, static_cast<int>(start_pos)); it != end; ++it)
-  {
-    nb_read++;
-    array_size = (array_size << 7) + ((*it) & 0x7F);
-    if (((*it) & 0x80) == 0)
-    {
-      return std::min(max_res, array_size + nb_read);
-    }
-  }
-
-  // at this point input is invalid
-  return max_res;
-}
-
-static std::size_t get_next_event_size(const std::vector<uint8_t>& message_stream, std::size_t start_pos)
-{
-  const auto stream_size = message_stream.size() - start_pos;
-  const auto stream = std::next(message_stream.begin(), static_cast<int>(start_pos));
-
-  if (stream_size < 2)
-  {
-    // minimal possible length (midi channel event 0xC0 and 0xD0
-    return stream_size;
-  }
-
-  std::size_t res = 1; // the first byte which the event type (channel, meta, sysex)
-  const auto ev_type = stream[0];
-  if (ev_type == 0xFF)
-  {
-    // META event has one byte more than sysex
-    res += 1;
-  }
-
-  if ((ev_type == 0xFF) or (ev_type == 0xF0) or (ev_type == 0xF7))
-  {
-    // end of META or sysex
-    res += get_variable_data_length(message_stream, res + start_pos);
-
-    // sanity check: in case of wrong input, simply discard data
-    return std::min(res, stream_size);
-  }
-
-  if (((ev_type & 0xF0) >= 0x80) and (ev_type & 0xF0) != 0xF0)
-  {
-    if (((ev_type & 0xF0) == 0xC0)     /* Program Change Event */
-	or ((ev_type & 0xF0) == 0xD0)) /* or Channel Aftertouch Event */
-    {
-      // one more byte
-      res += 1;
-    }
-    else
-    {
-      // this is a MIDI channel event (more two bytes)
-      res += 2;
-    }
-    return std::min(res, stream_size);
-  }
-
-  // at this point there is an error, discard data
-  return stream_size;
-}
-
 key_events
 midi_to_key_events(const std::vector<uint8_t>& message_stream)
 {
   key_events res;
 
+  midi_stream_parser parser;
+  midi_event events[64];
   const auto size = message_stream.size();
   auto nb_read = decltype(size){0};
-  const auto stream_begin = message_stream.begin();
 
   while (nb_read < size)
   {
-    const auto this_event_size = get_next_event_size(message_stream, nb_read);
+    const auto parsed = parser.parse(message_stream.data() + nb_read, size - nb_read,
+				     events, sizeof(events) / sizeof(events[0]));
+    nb_read += parsed.nb_bytes_read;
 
-    if (this_event_size == 0)
+    for (auto i = decltype(parsed.nb_events){0}; i < parsed.nb_events; ++i)
     {
-      // this is an error. return what we have found so far to avoid
-      // an infinite loop. This can happen with variable length array.
-      // If the computation of the size overflow and falls to 0, then
-      // ...
-      return res;
-    }
-
-    if (this_event_size == 3) // can it be a midi key press or key release event?
-    {
-      const auto tmp = std::vector<uint8_t>(std::next(stream_begin, static_cast<int>(nb_read)),
-					    std::next(stream_begin, static_cast<int>(nb_read + 3)));
-      if (is_key_release_event(tmp))
+      if (events[i].kind == midi_event_kind::note_on)
       {
-	res.keys_up.emplace_back(tmp[1] /* pitch */);
+	res.keys_down.emplace_back(/* pitch */ events[i].data1, /* staff_num */ 0, /* velocity */ events[i].data2);
       }
-      else if (is_key_down_event(tmp))
+      else if (events[i].kind == midi_event_kind::note_off)
       {
-	res.keys_down.emplace_back(/* pitch */ tmp[1], /* staff_num */ 0);
+	res.keys_up.emplace_back(events[i].data1 /* pitch */);
       }
     }
-
-    nb_read += this_event_size;
   }
 
   return res;
 }
 
-std::vector<midi_message_t>
-get_midi_from_keys_events(const std::vector<key_down>& keys_down,
-			  const std::vector<key_up>& keys_up)
-{
-  std::vector<midi_message_t> res;
-  res.reserve(keys_down.size() + keys_up.size());
-
-  for (const auto& key : keys_down)
-  {
-    res.emplace_back(std::vector<uint8_t>{ { 0x90 /* down event */,
-					     key.pitch,
-					     100 /* volume */ } });
-  }
-
-  for (const auto& key : keys_up)
-  {
-    res.emplace_back( std::vector<uint8_t>{ { 0x80, // up event,
-	                                      key.pitch,
-				 	      0 /* volume */ } } );
-  }
-
-  return res;
-}
-
-template <typename T>
-static
-void list_midi_ports(std::ostream& out, T& player, const char* direction)
-{
-
-  const auto nb_ports = player.getPortCount();
-  if (nb_ports == 0)
-  {
-    out << "Sorry: no " << direction << " midi port found\n";
-  }
-  else
-  {
-    if (nb_ports == 1)
-    {
-      out << "1 " << direction << " port found:\n";
-    }
-    else
-    {
-      out << nb_ports << " " << direction << " ports found:\n";
-    }
-
-    for (auto i = decltype(nb_ports){0}; i < nb_ports; ++i)
-    {
-      out << "  " << i << " -> " << player.getPortName(i) << "\n";
-    }
-  }
-
-}
-
-void list_midi_ports(std::ostream& out)
-{
-  RtMidiOut out_player;
-  list_midi_ports(out, out_player, "output");
-
-  out << "\n";
-
-  RtMidiIn in_player;
-  list_midi_ports(out, in_player, "input");
-
-}
-
-static unsigned int get_nb_output_ports()
-{
-  RtMidiOut player;
-  return player.getPortCount();
-}
-
-unsigned int get_port(const std::string& s)
-{
-  const auto nb_outputs = get_nb_output_ports();
-
-  try
-  {
-    const auto res = std::stoi(s);
-    if ((res < 0) or (static_cast<unsigned int>(res) >= nb_outputs))
-    {
-      std::cerr << "Warning: invalid port\n";
-      return 0;
-    }
-    return static_cast<unsigned int>(res);
-  }
-  catch (std::invalid_argument&)
-  {
-    // argument is not a number, let's see if it matches the name of one of the output
-    for (auto i = decltype(nb_outputs){0}; i < nb_outputs; ++i)
-    {
-      RtMidiOut player;
-      if (s == player.getPortName(i))
-      {
-	return i;
-      }
-    }
-
-    std::cerr << "Warning: invalid port\n";
-    return 0;
-  }
-}
-
-
 std::string get_first_svg_line(const std::vector<uint8_t>& data)
 {
   const char* const sheet_data = static_cast<const char*>(static_cast<const void*>(data.data()));
@@ -291,6 +117,20 @@ uint16_t find_music_sheet_pos(const std::vector<music_sheet_event>& events, unsi
 }
 
 
+void to_waiting_times(std::vector<music_sheet_event>& events)
+{
+  const auto nb_events = events.size();
+  for (auto i = decltype(nb_events){0}; i + 1 < nb_events; ++i)
+  {
+    events[i].time = ((events[i + 1].time - events[i].time) / 1'000'000);
+  }
+
+  if (nb_events > 0)
+  {
+    events[nb_events - 1].time = 3000; // to wait 3 seconds after last event
+  }
+}
+
 
 #if defined(__clang__)
   // clang will complain in a switch that the default case is useless
@@ -325,51 +165,104 @@ const char* rt_error_type_as_str(RtMidiError::Type value)
 #endif
 
 
-template <typename T>
-static std::vector<std::string> get_midi_ports_name(T& midi)
+bool begins_by(const std::string& haystack, const char* const needle)
 {
-  std::vector<std::string> res;
+  return haystack.find(needle) == 0;
+}
+
+bool ends_by(const std::string& haystack, const char* const needle)
+{
+  const auto needle_size = std::strlen(needle);
+  return (haystack.size() >= needle_size) and
+    (haystack.compare(haystack.size() - needle_size, needle_size, needle) == 0);
+}
 
-  const auto nb_ports = midi.getPortCount();
+std::vector<std::string> filter_out(const std::vector<std::string>& list, const char* const pattern_to_filter_out)
+{
+  std::vector<std::string> res;
 
-  for (auto i = decltype(nb_ports){0}; i < nb_ports; ++i)
+  for (const auto& str : list)
   {
-    const auto port_name = midi.getPortName(i);
-    res.emplace_back(std::move(port_name));
+    if (not begins_by(str, pattern_to_filter_out))
+    {
+      res.push_back(str);
+    }
   }
 
   return res;
 }
 
+// a directory by device and inode, the same whatever the path reaching it
+using dir_id = std::pair<dev_t, ino_t>;
 
-std::vector<std::string> get_input_midi_ports_name(RtMidiIn& midi_listener)
+// false if path isn't a directory, or a symbolic link to one
+static bool get_dir_id(const std::string& path, dir_id& id)
 {
-  return get_midi_ports_name(midi_listener);
-}
+  struct stat path_stat;
+  if ((stat(path.c_str(), &path_stat) != 0) or (not S_ISDIR(path_stat.st_mode)))
+  {
+    return false;
+  }
 
+  id = dir_id{ path_stat.st_dev, path_stat.st_ino };
+  return true;
+}
 
-std::vector<std::string> get_output_midi_ports_name(RtMidiOut& midi_player)
+// the directories reached again through a symbolic link, e.g. to one of
+// their parents, are only walked once.
+static void find_files(const std::string& dir_path, const std::initializer_list<const char*> extensions,
+		       std::set<dir_id>& visited_dirs, std::vector<std::string>& res)
 {
-  return get_midi_ports_name(midi_player);
-}
+  const std::unique_ptr<DIR, int (*)(DIR*)> dir (opendir(dir_path.c_str()), &closedir);
+  if (dir == nullptr)
+  {
+    static log_site unreadable_dir_log (log_level::warning);
+    log_line(unreadable_dir_log) << "Warning: unable to open directory " << dir_path;
+    return;
+  }
 
+  for (auto entry = readdir(dir.get()); entry != nullptr; entry = readdir(dir.get()))
+  {
+    const std::string name = entry->d_name;
+    if ((name == ".") or (name == ".."))
+    {
+      continue;
+    }
 
-bool begins_by(const std::string& haystack, const char* const needle)
-{
-  return haystack.find(needle) == 0;
+    const auto path = dir_path + "/" + name;
+    dir_id id;
+    if (get_dir_id(path, id))
+    {
+      if (visited_dirs.insert(id).second)
+      {
+	find_files(path, extensions, visited_dirs, res);
+      }
+    }
+    else if (std::any_of(extensions.begin(), extensions.end(), [&name] (const char* const extension) {
+	  return ends_by(name, extension);
+	}))
+    {
+      res.push_back(path);
+    }
+  }
 }
 
-std::vector<std::string> filter_out(const std::vector<std::string>& list, const char* const pattern_to_filter_out)
+std::vector<std::string> find_files(const std::string& path, const char* const extension)
 {
-  std::vector<std::string> res;
+  return find_files(path, { extension });
+}
 
-  for (const auto& str : list)
+std::vector<std::string> find_files(const std::string& path, const std::initializer_list<const char*> extensions)
+{
+  dir_id id;
+  if (not get_dir_id(path, id))
   {
-    if (not begins_by(str, pattern_to_filter_out))
-    {
-      res.push_back(str);
-    }
+    return std::vector<std::string>{ path };
   }
 
+  std::set<dir_id> visited_dirs { id };
+  std::vector<std::string> res;
+  find_files(path, extensions, visited_dirs, res);
+  std::sort(res.begin(), res.end());
   return res;
 }
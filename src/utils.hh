@@ -1,22 +1,31 @@
 #ifndef UTILS_HH_
 #define UTILS_HH_
 
+#include <initializer_list>
 #include <vector>
 #include <limits>
 #include <fstream>
 #include <string>
 #include <rtmidi/RtMidi.h>
 
+static constexpr const char * const LILYPLAYER_VIRTUAL_MIDI_INPUT = "Lilyplayer listener";
+static constexpr const char * const LILYPLAYER_VIRTUAL_MIDI_OUTPUT = "Lilyplayer sound player";
+
 struct key_down
 {
-    key_down(uint8_t _pitch, uint8_t _staff_num)
+    // the lilyplayer files don't store the velocity of the keys
+    static constexpr const uint8_t DEFAULT_VELOCITY = 100;
+
+    key_down(uint8_t _pitch, uint8_t _staff_num, uint8_t _velocity = DEFAULT_VELOCITY)
       : pitch(_pitch)
       , staff_num(_staff_num)
+      , velocity(_velocity)
     {
     }
 
     uint8_t pitch;
     uint8_t staff_num;
+    uint8_t velocity; // 1 to 127
 };
 
 struct key_up
@@ -67,6 +76,19 @@ enum note_kind : uint8_t
 
 using midi_message_t = std::vector<uint8_t>;
 
+// a midi message received from an input port. Stored inline so that it can
+// be handed over from the RtMidi thread without allocating.
+struct input_midi_message
+{
+    double timestamp; // as given by RtMidi: seconds since the previous message
+    int64_t received_at; // steady clock time, in ns
+    uint8_t size;
+    uint8_t bytes[15];
+};
+
+// number of input messages that can wait for the gui thread before being dropped
+static constexpr const std::size_t INPUT_MIDI_QUEUE_CAPACITY = 4096;
+
 bool is_key_down_event(const std::vector<uint8_t>& data) __attribute__((pure));
 bool is_key_release_event(const std::vector<uint8_t>& data) __attribute__((pure));
 
@@ -85,13 +107,7 @@ struct key_events
 key_events
 midi_to_key_events(const std::vector<uint8_t>& message_stream) __attribute__((pure));
 
-std::vector<midi_message_t>
-get_midi_from_keys_events(const std::vector<key_down>& keys_down,
-			  const std::vector<key_up>& keys_up);
-
 
-void list_midi_ports(std::ostream& out);
-unsigned int get_port(const std::string& s);
 
 std::string get_first_svg_line(const std::vector<uint8_t>& data);
 
@@ -99,13 +115,23 @@ struct music_sheet_event;
 uint16_t find_last_measure(const std::vector<music_sheet_event>& events);
 uint16_t find_music_sheet_pos(const std::vector<music_sheet_event>& events, unsigned int event_pos);
 
+// replaces the occuring time of each event (in ns since the beginning of
+// the song) by the time to wait after it before processing the next one (in ms).
+void to_waiting_times(std::vector<music_sheet_event>& events);
+
 
 const char* rt_error_type_as_str(RtMidiError::Type value);
 
-std::vector<std::string> get_input_midi_ports_name(RtMidiIn& midi_listener);
-std::vector<std::string> get_output_midi_ports_name(RtMidiOut& midi_player);
 
 bool begins_by(const std::string& haystack, const char* const needle);
+bool ends_by(const std::string& haystack, const char* const needle);
 std::vector<std::string> filter_out(const std::vector<std::string>& list, const char* const pattern_to_filter_out);
 
+// if path is a directory, returns all the files ending by extension found in
+// it and its subdirectories (sorted by name). Otherwise returns path itself.
+// The directories reached again through symbolic links are only walked once.
+std::vector<std::string> find_files(const std::string& path, const char* const extension);
+// the same with the files ending by any of the extensions, in a single walk
+std::vector<std::string> find_files(const std::string& path, std::initializer_list<const char*> extensions);
+
 #endif /* UTILS_HH_ */
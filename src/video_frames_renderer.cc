@@ -0,0 +1,307 @@
+#include <sys/stat.h>
+#include <cerrno>
+#include <cmath>
+#include <cstring> // for std::strerror
+#include <cstdio>  // for std::snprintf
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include <QBuffer>
+#include <QImage>
+#include <QPainter>
+#include <QSvgRenderer>
+
+#include "video_frames_renderer.hh"
+#include "keyboard.hh"
+#include "music_sheet_layout.hh"
+#include "parallel_for.hh"
+
+// same layout as the main window: the music sheet view, then the keyboard.
+static constexpr const int FRAME_WIDTH = static_cast<int>(KEYBOARD_WIDTH);
+static constexpr const int SHEET_HEIGHT = MUSIC_SHEET_VIEW_HEIGHT;
+static constexpr const int KEYBOARD_HEIGHT = static_cast<int>(WHITE_KEY_HEIGHT);
+static constexpr const int FRAME_HEIGHT = SHEET_HEIGHT + KEYBOARD_HEIGHT;
+
+static const QColor window_background_color {0x30, 0x2F, 0x2F}; // from the qdarkstyle stylesheet
+
+// consecutive frames rendered by the same thread, so that a page is rasterised
+// once per chunk instead of once per frame.
+static constexpr const std::size_t FRAMES_PER_CHUNK = 128;
+
+static constexpr const auto NO_CURSOR = std::numeric_limits<std::size_t>::max();
+
+struct frame_state
+{
+    frame_state()
+      : page(0)
+      , cursor_event_pos(NO_CURSOR)
+      , keyboard()
+    {
+      keyboard.fill(0);
+    }
+
+    bool operator==(const frame_state& other) const
+    {
+      return (page == other.page) and
+	(cursor_event_pos == other.cursor_event_pos) and
+	(keyboard == other.keyboard);
+    }
+
+    uint16_t page;
+    std::size_t cursor_event_pos; // event which set the cursor box displayed
+    keyboard_state keyboard;
+};
+
+static std::vector<frame_state> get_frame_states(const bin_song_t& song, const unsigned int fps)
+{
+  std::vector<frame_state> res;
+  if (song.events.empty())
+  {
+    return res;
+  }
+
+  // the player processes the first event as soon as the song starts, and
+  // waits 3 seconds after the last one.
+  const auto start_time = song.events.front().time;
+  const auto song_duration = song.events.back().time - start_time + uint64_t{3'000'000'000};
+  const auto nb_frames = song_duration * fps / 1'000'000'000 + 1;
+  res.reserve(static_cast<std::size_t>(nb_frames));
+
+  frame_state state;
+  std::size_t event_pos = 0;
+  for (auto frame = decltype(nb_frames){0}; frame < nb_frames; ++frame)
+  {
+    const auto frame_time = start_time + frame * 1'000'000'000 / fps;
+    while ((event_pos < song.nb_events) and (song.events[event_pos].time <= frame_time))
+    {
+      const auto& event = song.events[event_pos];
+      update_keyboard_state(event.keys_down, event.keys_up, state.keyboard);
+
+      if (event.has_svg_file_change())
+      {
+	// a new page starts with an empty cursor
+	state.page = event.new_svg_file;
+	state.cursor_event_pos = NO_CURSOR;
+      }
+
+      if (event.has_cursor_pos_change())
+      {
+	state.cursor_event_pos = event_pos;
+      }
+
+      ++event_pos;
+    }
+
+    res.push_back(state);
+  }
+
+  return res;
+}
+
+// rasterised music sheet page, scaled to the width of the frame.
+struct rendered_page
+{
+    rendered_page()
+      : page(std::numeric_limits<uint16_t>::max())
+      , viewbox()
+      , scale(1)
+      , image()
+    {
+    }
+
+    void render(const bin_song_t& song, const uint16_t page_to_render)
+    {
+      const auto& svg_file = song.svg_files[page_to_render].data;
+      QSvgRenderer renderer;
+      if (not renderer.load(QByteArray::fromRawData(static_cast<const char*>(static_cast<const void*>(svg_file.data())),
+						    static_cast<int>(svg_file.size()))))
+      {
+	throw std::runtime_error("Error: failed to parse a music sheet page.");
+      }
+
+      viewbox = renderer.viewBoxF();
+      scale = qreal{FRAME_WIDTH} / viewbox.width();
+      const auto height = static_cast<int>(std::ceil(viewbox.height() * scale));
+
+      image = QImage(FRAME_WIDTH, height, QImage::Format_ARGB32_Premultiplied);
+      image.fill(Qt::white);
+      QPainter painter(&image);
+      painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform);
+      renderer.render(&painter, QRectF{0, 0, qreal{FRAME_WIDTH}, qreal(height)});
+      painter.end();
+
+      page = page_to_render;
+    }
+
+    uint16_t page;
+    QRectF viewbox;
+    qreal scale; // page coordinates to pixels
+    QImage image;
+};
+
+// the cursor of the event, as drawn by the window: the event's svg document,
+// with the viewbox of its page, rendered over the whole page.
+struct rendered_cursor
+{
+    rendered_cursor()
+      : event_pos(NO_CURSOR)
+      , renderer()
+    {
+    }
+
+    rendered_cursor(const rendered_cursor&) = delete;
+    rendered_cursor& operator=(const rendered_cursor&) = delete;
+
+    void load(const bin_song_t& song, const std::size_t cursor_event_pos)
+    {
+      if ((cursor_event_pos == event_pos) or (cursor_event_pos == NO_CURSOR))
+      {
+	return;
+      }
+
+      if (not renderer.load(song.events[cursor_event_pos].new_cursor_box))
+      {
+	throw std::runtime_error("Error: failed to parse the cursor of a music sheet page.");
+      }
+      event_pos = cursor_event_pos;
+    }
+
+    std::size_t event_pos;
+    QSvgRenderer renderer;
+};
+
+static void paint_frame(QPainter& painter, const bin_song_t& song, const frame_state& state,
+			const rendered_page& page, rendered_cursor& cursor)
+{
+  painter.fillRect(QRectF{0, 0, qreal{FRAME_WIDTH}, qreal{FRAME_HEIGHT}}, window_background_color);
+
+  // the music sheet view is centered on the cursor and the line around it,
+  // like MainWindow::display_cursor does.
+  const auto sheet_area = QRectF{0, 0, qreal{FRAME_WIDTH}, qreal{SHEET_HEIGHT}};
+  const auto center_y = [&] () {
+    if (state.cursor_event_pos == NO_CURSOR)
+    {
+      return qreal{SHEET_HEIGHT} / 2;
+    }
+
+    const auto view_area = get_cursor_view_area(page.viewbox, song.events[state.cursor_event_pos].cursor_box_coord);
+    return (view_area.top() + view_area.height() / 2) * page.scale;
+  }();
+  const auto page_top = center_y - qreal{SHEET_HEIGHT} / 2;
+
+  painter.save();
+  painter.setClipRect(sheet_area);
+  painter.fillRect(sheet_area, Qt::white);
+  painter.drawImage(QPointF{0, -page_top}, page.image);
+  if (state.cursor_event_pos != NO_CURSOR)
+  {
+    cursor.load(song, state.cursor_event_pos);
+    cursor.renderer.render(&painter, QRectF{0, -page_top, qreal{FRAME_WIDTH}, page.viewbox.height() * page.scale});
+  }
+  painter.restore();
+
+  painter.save();
+  painter.translate(0, qreal{SHEET_HEIGHT});
+  paint_keyboard(painter, state.keyboard);
+  painter.restore();
+}
+
+static std::string get_frame_filename(const std::string& output_dir, const std::size_t frame)
+{
+  char name[32];
+  std::snprintf(name, sizeof(name), "/frame_%06zu.png", frame);
+  return output_dir + name;
+}
+
+static void write_file(const std::string& filename, const QByteArray& content)
+{
+  std::ofstream out(filename, std::ios::binary | std::ios::out | std::ios::trunc);
+  out.write(content.constData(), content.size());
+  out.close();
+
+  if (not out)
+  {
+    throw std::runtime_error(std::string{"Error: failed to write file ["} + filename + "]");
+  }
+}
+
+static void render_chunk(const bin_song_t& song, const std::vector<frame_state>& states,
+			 const std::size_t first_frame, const std::size_t last_frame,
+			 const std::string& output_dir)
+{
+  rendered_page page;
+  rendered_cursor cursor;
+  QImage frame(FRAME_WIDTH, FRAME_HEIGHT, QImage::Format_RGB32);
+  QByteArray png;
+
+  for (auto i = first_frame; i < last_frame; ++i)
+  {
+    // many consecutive frames are identical (e.g. during long notes), they
+    // only need to be encoded once.
+    const auto is_same_as_previous = (i != first_frame) and (states[i] == states[i - 1]);
+    if (not is_same_as_previous)
+    {
+      if ((page.page != states[i].page) and (not song.svg_files.empty()))
+      {
+	page.render(song, states[i].page);
+      }
+
+      {
+	QPainter painter(&frame);
+	painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform);
+	paint_frame(painter, song, states[i], page, cursor);
+      }
+
+      png.clear();
+      QBuffer buffer(&png);
+      buffer.open(QIODevice::WriteOnly);
+      if (not frame.save(&buffer, "PNG"))
+      {
+	throw std::runtime_error("Error: failed to encode a frame.");
+      }
+    }
+
+    write_file(get_frame_filename(output_dir, i), png);
+  }
+}
+
+void render_video_frames(const bin_song_t& song, const unsigned int fps, const std::string& output_dir)
+{
+  if (fps == 0)
+  {
+    throw std::invalid_argument("Error: the number of frames per second must be positive");
+  }
+
+  if ((mkdir(output_dir.c_str(), 0755) == -1) and (errno != EEXIST))
+  {
+    throw std::runtime_error(std::string{"Error: unable to create directory ["} + output_dir + "] ("
+			     + std::strerror(errno) + ")");
+  }
+
+  const auto states = get_frame_states(song, fps);
+  const auto nb_frames = states.size();
+  const auto nb_chunks = (nb_frames + FRAMES_PER_CHUNK - 1) / FRAMES_PER_CHUNK;
+
+  // each thread only writes its own slot, errors are reported afterwards.
+  std::vector<std::string> errors(nb_chunks);
+  parallel_for(nb_chunks, [&] (const std::size_t chunk) {
+      try
+      {
+	render_chunk(song, states, chunk * FRAMES_PER_CHUNK,
+		     std::min(nb_frames, (chunk + 1) * FRAMES_PER_CHUNK), output_dir);
+      }
+      catch (std::exception& e)
+      {
+	errors[chunk] = e.what();
+      }
+    });
+
+  for (const auto& error : errors)
+  {
+    if (not error.empty())
+    {
+      throw std::runtime_error(error);
+    }
+  }
+}
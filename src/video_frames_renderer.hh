@@ -0,0 +1,16 @@
+#ifndef VIDEO_FRAMES_RENDERER_HH
+#define VIDEO_FRAMES_RENDERER_HH
+
+#include <string>
+
+#include "bin_file_reader.hh"
+
+// Renders what the main window shows while playing the song (music sheet
+// centered on the cursor, and the keyboard below it) as a sequence of PNG
+// images, one per frame, named frame_000000.png, frame_000001.png, ... in
+// output_dir. The event times of the song must still be in ns since the
+// beginning of the song (i.e. as returned by get_song).
+// Frames are rendered in parallel. A QGuiApplication must exist.
+void render_video_frames(const bin_song_t& song, unsigned int fps, const std::string& output_dir);
+
+#endif /* VIDEO_FRAMES_RENDERER_HH */